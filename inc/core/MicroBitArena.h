@@ -0,0 +1,194 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simple bump pointer arena allocator, used to reduce heap churn caused by short lived
+  * ManagedString, MicroBitImage and PacketBuffer instances.
+  *
+  * An arena is a single block of memory allocated from the heap. Once activated (typically for
+  * the duration of an event handler), any reference counted data created by the calling fiber is
+  * carved out of the arena by simply advancing a pointer. Individual releases are very cheap, and
+  * once the last object held in the arena is released, the whole arena is reset in one step.
+  *
+  * If an arena runs out of space, allocations silently fall back to the general heap.
+  *
+  * Objects that outlive the handler that created them are safe - they simply pin the arena
+  * until they are released. Long lived data should therefore be created outside of an active arena.
+  */
+
+#ifndef MICROBIT_ARENA_H
+#define MICROBIT_ARENA_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+class MicroBitArena
+{
+    uint8_t         *buffer;            // The block of memory from which allocations are made.
+    uint16_t        size;               // The size of the buffer, in bytes.
+    uint16_t        offset;             // The position of the next free byte in the buffer.
+    uint16_t        live;               // The number of allocations made from this arena that have not yet been released.
+
+    public:
+
+    MicroBitArena   *next;              // The next arena in the list of all arenas.
+
+    /**
+      * Constructor.
+      *
+      * Create a new arena, and allocate its storage from the heap.
+      *
+      * @param size The amount of memory to reserve for the arena, in bytes. Defaults to MICROBIT_ARENA_DEFAULT_SIZE.
+      *
+      * @code
+      * MicroBitArena arena(256);
+      * @endcode
+      */
+    MicroBitArena(int size = MICROBIT_ARENA_DEFAULT_SIZE);
+
+    /**
+      * Destructor.
+      *
+      * Releases the storage held by this arena.
+      *
+      * @note It is an error to destroy an arena that still holds live allocations.
+      */
+    ~MicroBitArena();
+
+    /**
+      * Attempt to allocate a given amount of memory from this arena.
+      *
+      * @param size The amount of memory, in bytes, to allocate.
+      *
+      * @return A word aligned pointer to the allocated memory, or NULL if the arena has insufficient space.
+      */
+    void *alloc(size_t size);
+
+    /**
+      * Release a block of memory previously allocated from this arena.
+      *
+      * When the last outstanding allocation is released, the whole arena is made available for reuse.
+      *
+      * @param mem The memory to release.
+      */
+    void release(void *mem);
+
+    /**
+      * Determines if the given memory was allocated from this arena.
+      *
+      * @param mem The memory to test.
+      *
+      * @return true if mem lies within this arena, false otherwise.
+      */
+    bool contains(void *mem);
+
+    /**
+      * Determines the amount of space remaining in this arena.
+      *
+      * @return The number of bytes available for allocation.
+      */
+    int getFree();
+
+    /**
+      * Determines the number of allocations from this arena that are still in use.
+      *
+      * @return The number of outstanding allocations.
+      */
+    int getLive();
+};
+
+/**
+  * Activates the given arena for the calling fiber. All subsequent reference counted
+  * allocations made by the fiber will be attempted from the arena first.
+  *
+  * @param arena The arena to activate, or NULL to revert to the general heap.
+  *
+  * @return The arena that was previously active, or NULL if there was none.
+  */
+MicroBitArena *microbit_arena_activate(MicroBitArena *arena);
+
+/**
+  * Determines the arena currently active for the calling fiber.
+  *
+  * @return The active arena, or NULL if allocations are being made from the general heap.
+  */
+MicroBitArena *microbit_arena_current();
+
+/**
+  * Attempt to allocate a given amount of memory from the active arena, falling
+  * back to the general heap if no arena is active or the active arena is full.
+  *
+  * Allocations made in interrupt context are always made from the general heap.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+void *microbit_arena_malloc(size_t size);
+
+/**
+  * Release memory allocated by microbit_arena_malloc().
+  *
+  * @param mem The memory to release. This may have been allocated either from an arena or the general heap.
+  */
+void microbit_arena_free(void *mem);
+
+/**
+  * A simple helper that activates an arena for the lifetime of a scope, such as an event handler,
+  * and restores the previously active arena on exit.
+  *
+  * If a handler run by invoke() blocks within the scope, the fiber forked to complete it keeps the arena,
+  * and the fiber that called invoke() continues with the arena it had before.
+  *
+  * @code
+  * MicroBitArena arena(256);
+  *
+  * void onButtonA(MicroBitEvent)
+  * {
+  *     MicroBitArenaScope scope(arena);
+  *
+  *     ManagedString s = ManagedString("A:") + ManagedString(uBit.systemTime());
+  *     uBit.display.scroll(s);
+  * }
+  * @endcode
+  */
+class MicroBitArenaScope
+{
+    MicroBitArena *previous;
+
+    public:
+
+    MicroBitArenaScope(MicroBitArena &arena)
+    {
+        previous = microbit_arena_activate(&arena);
+    }
+
+    ~MicroBitArenaScope()
+    {
+        microbit_arena_activate(previous);
+    }
+};
+
+#endif
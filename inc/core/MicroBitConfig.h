@@ -125,6 +125,19 @@ extern uint32_t __etext;
 #define MICROBIT_HEAP_BLOCK_SIZE                4
 #endif
 
+// The default size of a MicroBitArena, in bytes, if none is specified when it is created.
+// Arenas are used to hold short lived reference counted data (strings, images and packets) created by event handlers.
+#ifndef MICROBIT_ARENA_DEFAULT_SIZE
+#define MICROBIT_ARENA_DEFAULT_SIZE             256
+#endif
+
+// The maximum number of relocatable heap blocks (see microbit_handle_alloc()) that may exist at any one time.
+// Each entry costs 8 bytes of RAM. Set to '0' to disable idle time heap compaction, in which case
+// microbit_handle_alloc() returns ordinary blocks that are never moved.
+#ifndef MICROBIT_HEAP_MAX_HANDLES
+#define MICROBIT_HEAP_MAX_HANDLES               4
+#endif
+
 // If defined, reuse any unused SRAM normally reserved for SoftDevice (Nordic's memory resident BLE stack) as heap memory.
 // The amount of memory reused depends upon whether or not BLE is enabled using MICROBIT_BLE_ENABLED.
 // Set '1' to enable.
@@ -182,6 +195,13 @@ extern uint32_t __etext;
 #define MICROBIT_SYSTEM_COMPONENTS              10
 #endif
 
+// Enable this to record how long each component's systemTick() takes (min/avg/max), and the
+// jitter between successive system timer interrupts. Adds a small overhead to every tick.
+// Set '1' to enable.
+#ifndef MICROBIT_SYSTEM_TIMER_PROFILING
+#define MICROBIT_SYSTEM_TIMER_PROFILING         0
+#endif
+
 // To reduce memory cost and complexity, the micro:bit allows components to register for
 // periodic callback events when the processor is idle.
 // This defines the maximum size of the idle callback list.
@@ -387,6 +407,65 @@ extern uint32_t __etext;
 #define MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS     MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS
 #endif
 
+// The shortest interval (in microseconds) the timer is asked to schedule between two steps
+// of a greyscale row. Pixels due off sooner than this after a timer event are switched off by a short
+// busy wait within that event instead.
+#ifndef MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL
+#define MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL 20
+#endif
+
+// Selects whether the display skips rows of the LED matrix that have nothing lit by default.
+// The lit rows then share all of the refresh time, and so appear brighter. See MicroBitDisplay::setAdaptiveRefresh().
+#ifndef MICROBIT_DISPLAY_ADAPTIVE_REFRESH
+#define MICROBIT_DISPLAY_ADAPTIVE_REFRESH       0
+#endif
+
+// The shortest run of pixels that a transparent paste of one byte per pixel images copies four pixels at a time.
+// Shorter runs, such as the rows of a 5x5 glyph, are quicker byte by byte than aligning the destination to a word.
+#ifndef MICROBIT_IMAGE_BLIT_WORD_MIN
+#define MICROBIT_IMAGE_BLIT_WORD_MIN            8
+#endif
+
+// The number of decoded font glyphs to cache, to save decoding the same characters repeatedly
+// when text is printed or laid out for scrolling. Set to zero to disable the cache.
+#ifndef MICROBIT_FONT_GLYPH_CACHE_SIZE
+#define MICROBIT_FONT_GLYPH_CACHE_SIZE          8
+#endif
+
+// Determines if text scrolled on the display uses proportional spacing, where empty columns either
+// side of each character are removed. Defaults to fixed width characters.
+#ifndef MICROBIT_DISPLAY_SCROLL_PROPORTIONAL
+#define MICROBIT_DISPLAY_SCROLL_PROPORTIONAL    0
+#endif
+
+// The number of items that can be queued on a MicroBitTimeline at once.
+// One slot is always kept free, so a timeline holds at most one less than this.
+#ifndef MICROBIT_TIMELINE_LENGTH
+#define MICROBIT_TIMELINE_LENGTH                8
+#endif
+
+// The number of bytes read at a time when a MicroBitAnimation is played from a file.
+#ifndef MICROBIT_ANIMATION_BUFFER_SIZE
+#define MICROBIT_ANIMATION_BUFFER_SIZE          16
+#endif
+
+// The number of smoothed light levels kept by MicroBitLightSensor.
+#ifndef MICROBIT_LIGHT_SENSOR_HISTORY
+#define MICROBIT_LIGHT_SENSOR_HISTORY           16
+#endif
+
+// The default smoothing applied to light levels by MicroBitLightSensor, as a shift (0 = none).
+// See MicroBitLightSensor::setSmoothing().
+#ifndef MICROBIT_LIGHT_SENSOR_SMOOTHING
+#define MICROBIT_LIGHT_SENSOR_SMOOTHING         0
+#endif
+
+// How far the light level must move back past the only threshold set on a MicroBitLightSensor
+// before that threshold's event can be raised again. See MicroBitLightSensor::setThresholds().
+#ifndef MICROBIT_LIGHT_SENSOR_HYSTERESIS
+#define MICROBIT_LIGHT_SENSOR_HYSTERESIS        8
+#endif
+
 // Selects the default scroll speed for the display.
 // The time taken to move a single pixel (ms).
 #ifndef MICROBIT_DEFAULT_SCROLL_SPEED
@@ -443,6 +522,15 @@ extern uint32_t __etext;
 #define MICROBIT_DEFAULT_PULLMODE                PullDown
 #endif
 
+//
+// The interval between samples of a button (or touch pin), in milliseconds. Debounce times are unaffected,
+// so longer intervals save time in the system timer interrupt at the cost of some noise immunity.
+// Defaults to zero, which samples on every system tick.
+//
+#ifndef MICROBIT_BUTTON_SAMPLE_PERIOD
+#define MICROBIT_BUTTON_SAMPLE_PERIOD            0
+#endif
+
 //
 // Panic options
 //
@@ -42,6 +42,8 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitEvent.h"
 #include "EventModel.h"
 
+class MicroBitArena;
+
 // Fiber Scheduler Flags
 #define MICROBIT_SCHEDULER_RUNNING	     	0x01
 
@@ -89,6 +91,7 @@ struct Fiber
     uint32_t flags;                     // Information about this fiber.
     Fiber **queue;                      // The queue this fiber is stored on.
     Fiber *next, *prev;                 // Position of this Fiber on the run queue.
+    MicroBitArena *arena;               // The arena from which this Fiber's reference counted data is allocated, if any.
 };
 
 extern Fiber *currentFiber;
@@ -34,12 +34,78 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_FONT_ASCII_START 32
 #define MICROBIT_FONT_ASCII_END 126
 
+#define MICROBIT_FONT_MAX_WIDTH 8
+#define MICROBIT_FONT_MAX_HEIGHT 8
+#define MICROBIT_FONT_NO_GLYPH 0xffff
+
+/**
+  * A run of consecutive character codes held in a MicroBitFontDefinition.
+  */
+struct MicroBitFontRange
+{
+    uint16_t first;     // The first character code in the range.
+    uint16_t count;     // The number of consecutive character codes in the range.
+    uint16_t index;     // The position in the glyph index of the first character of the range.
+};
+
+/**
+  * A pair of characters whose spacing is adjusted when they are written next to each other.
+  */
+struct MicroBitFontKerning
+{
+    uint16_t left;      // The character code on the left of the pair.
+    uint16_t right;     // The character code on the right of the pair.
+    int8_t adjust;      // The number of columns to add to (or if negative, remove from) the space between them.
+};
+
+/**
+  * A font held in flash, with variable width glyphs and any number of ranges of characters.
+  *
+  * The ranges are sorted by character code, and each maps its characters onto consecutive entries of the index.
+  * Each index entry holds the offset of a glyph in the glyph data, or MICROBIT_FONT_NO_GLYPH for a character
+  * missing from its range. Characters that look the same can share a single glyph by sharing an offset.
+  *
+  * Each glyph is a header byte holding its width in columns, followed by the columns packed least
+  * significant bit first into a stream of height bits per column. MicroBitFont::encodeGlyph() builds these.
+  *
+  * @code
+  * const MicroBitFontRange ranges[] = { { 0xc0, 2, 0 } };  // À and Á
+  * const uint16_t index[] = { 0, 4 };                      // Each 4x5 glyph is a header byte and 20 bits of columns.
+  * const uint8_t glyphs[] = { ... };
+  * const MicroBitFontDefinition latin = { 5, 4, 1, ranges, index, glyphs, 0, NULL };
+  *
+  * MicroBitFont::setSystemFont(MicroBitFont(&latin));
+  * @endcode
+  */
+struct MicroBitFontDefinition
+{
+    uint8_t height;                         // The number of rows in every glyph, at most MICROBIT_FONT_MAX_HEIGHT.
+    uint8_t width;                          // The width of the widest glyph, at most MICROBIT_FONT_MAX_WIDTH.
+    uint16_t rangeCount;                    // The number of entries in ranges.
+    const MicroBitFontRange *ranges;        // The ranges of characters in the font, sorted by first character code.
+    const uint16_t *index;                  // The offset into glyphs of the glyph for each character.
+    const uint8_t *glyphs;                  // The glyph data.
+    uint16_t kerningCount;                  // The number of entries in kerning.
+    const MicroBitFontKerning *kerning;     // Kerning pairs, sorted by left and then right character code, or NULL.
+};
+
+/**
+  * A glyph decoded from a font, as held in the glyph cache.
+  */
+struct MicroBitGlyph
+{
+    const void *font;                           // The font the glyph was decoded from, or NULL if unused.
+    uint16_t c;                                 // The character this glyph represents.
+    uint8_t width;                              // The number of columns in the glyph.
+    uint8_t columns[MICROBIT_FONT_MAX_WIDTH];   // One byte per column. Bit n is set if the pixel in row n is lit.
+};
+
 /**
   * Class definition for a MicrobitFont
   * This class represents a font that can be used by the display to render text.
   *
-  * A MicroBitFont is 5x5.
-  * Each Row is represented by a byte in the array.
+  * A MicroBitFont is either a MicroBitFontDefinition, or a legacy table of 5x5 ASCII characters.
+  * In a legacy table, each Row is represented by a byte in the array.
   *
   * Row Format:
   *            ================================================================
@@ -51,8 +117,6 @@ DEALINGS IN THE SOFTWARE.
   * Example: { 0x08, 0x08, 0x08, 0x0, 0x08 }
   *
   * The above will produce an exclaimation mark on the second column in form the left.
-  *
-  * We could compress further, but the complexity of decode would likely outweigh the gains.
   */
 class MicroBitFont
 {
@@ -65,6 +129,8 @@ class MicroBitFont
 
     int asciiEnd;
 
+    const MicroBitFontDefinition *definition;
+
     /**
       * Constructor.
       *
@@ -76,6 +142,16 @@ class MicroBitFont
       */
     MicroBitFont(const unsigned char* font, int asciiEnd = MICROBIT_FONT_ASCII_END);
 
+    /**
+      * Constructor.
+      *
+      * Sets the font represented by this font object to one held in a MicroBitFontDefinition.
+      *
+      * @param definition The definition of the font, typically held in flash. It must remain valid
+      *                   for as long as the font is in use.
+      */
+    MicroBitFont(const MicroBitFontDefinition *definition);
+
     /**
       * Default Constructor.
       *
@@ -95,6 +171,98 @@ class MicroBitFont
       */
     static MicroBitFont getSystemFont();
 
+    /**
+      * Decodes the glyph for the given character into columns, using the glyph cache where possible.
+      *
+      * @param c The character to decode.
+      *
+      * @param columns A buffer of at least MICROBIT_FONT_WIDTH bytes to receive the glyph. Each byte holds
+      *                one column, with bit n set if the pixel in row n is lit. Glyphs of other widths are
+      *                padded with blank columns, or truncated.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the character is not in this font.
+      */
+    int getGlyph(char c, uint8_t *columns);
+
+    /**
+      * Decodes the glyph for the given character code into columns, using the glyph cache where possible.
+      *
+      * @param c The character code to decode, such as one returned by nextCharacter().
+      *
+      * @param columns A buffer of at least MICROBIT_FONT_MAX_WIDTH bytes to receive the glyph. Each byte holds
+      *                one column, with bit n set if the pixel in row n is lit.
+      *
+      * @return The width of the glyph in columns, or MICROBIT_INVALID_PARAMETER if the character is not in this font.
+      */
+    int getColumns(uint16_t c, uint8_t *columns);
+
+    /**
+      * Determines the adjustment to the space between two characters written next to each other.
+      *
+      * @param left The character code on the left.
+      *
+      * @param right The character code on the right.
+      *
+      * @return The number of columns to add to the space between them, which may be negative, or zero if
+      *         the font has no kerning for the pair.
+      */
+    int getKerning(uint16_t left, uint16_t right);
+
+    /**
+      * Gets the number of rows in the glyphs of this font.
+      */
+    int getHeight();
+
+    /**
+      * Gets the width of the widest glyph in this font.
+      */
+    int getWidth();
+
+    /**
+      * Decodes the next character of a UTF-8 string.
+      *
+      * Bytes that don't form part of a valid sequence, or sequences for characters beyond 0xffff, are
+      * returned one at a time as they are, so text in a single byte encoding such as Latin-1 is still shown.
+      *
+      * @param s The string to decode.
+      *
+      * @param length The length of the string, in bytes.
+      *
+      * @param position The offset of the next byte to decode, which is advanced past the character.
+      *
+      * @return The character code, or 0 if position is at or beyond the end of the string.
+      *
+      * @code
+      * int i = 0;
+      * while (i < s.length())
+      *     font.getColumns(MicroBitFont::nextCharacter(s.toCharArray(), s.length(), i), columns);
+      * @endcode
+      */
+    static uint16_t nextCharacter(const char *s, int length, int &position);
+
+    /**
+      * Encodes a glyph into the format used by MicroBitFontDefinition.
+      *
+      * @param columns The columns of the glyph, with bit n of each set if the pixel in row n is lit.
+      *
+      * @param width The number of columns in the glyph, at most MICROBIT_FONT_MAX_WIDTH.
+      *
+      * @param height The number of rows in the font, at most MICROBIT_FONT_MAX_HEIGHT.
+      *
+      * @param buffer A buffer to receive the encoded glyph, of at least 1 + (width * height + 7) / 8 bytes.
+      *
+      * @return The number of bytes written, or MICROBIT_INVALID_PARAMETER.
+      */
+    static int encodeGlyph(const uint8_t *columns, int width, int height, uint8_t *buffer);
+
+    private:
+
+    /**
+      * Decodes the glyph for the given character code directly from the font, without the glyph cache.
+      *
+      * @return The width of the glyph in columns, or MICROBIT_INVALID_PARAMETER if the character is not in this font.
+      */
+    int decode(uint16_t c, uint8_t *columns);
 };
 
 #endif
@@ -66,6 +66,31 @@ struct HeapDefinition
     uint32_t *heap_end;		    // Physical address of the end of this heap.
 };
 
+/**
+  * Usage and fragmentation statistics for the heap, as reported by microbit_heap_stats().
+  */
+struct MicroBitHeapStats
+{
+    uint32_t    totalFree;      // Total free memory, in bytes.
+    uint32_t    totalUsed;      // Total allocated memory, including block headers, in bytes.
+    uint32_t    largestFree;    // The largest contiguous region of free memory, in bytes.
+    uint32_t    freeRegions;    // The number of distinct regions of free memory.
+    uint32_t    usedBlocks;     // The number of allocated blocks.
+};
+
+/**
+  * A reference to a relocatable block of heap memory.
+  *
+  * Relocatable blocks may be moved by the heap allocator when the processor is idle, in order to
+  * coalesce free space into larger contiguous regions. The data pointer is therefore only stable
+  * while the block is locked, or until the calling fiber next yields the processor.
+  */
+struct MicroBitHeapHandle
+{
+    void        *data;          // The current location of the block, or NULL if this handle is unused.
+    uint32_t    locks;          // The number of outstanding locks. Locked blocks are never moved.
+};
+
 /**
   * Create and initialise a given memory region as for heap storage.
   * After this is called, any future calls to malloc, new, free or delete may use the new heap.
@@ -82,7 +107,83 @@ struct HeapDefinition
   * code, and user code targetting the runtime. External code can choose to include this file, or
   * simply use the standard heap.
   */
-int microbit_create_heap(uint32_t start, uint32_t end);
+int microbit_create_heap(uintptr_t start, uintptr_t end);
 void microbit_heap_print();
 
+/**
+  * Gathers usage and fragmentation statistics across all initialised heaps.
+  *
+  * @param stats The structure to populate.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if heap corruption was detected,
+  * or MICROBIT_NOT_SUPPORTED if the micro:bit heap allocator is disabled.
+  *
+  * @code
+  * MicroBitHeapStats stats;
+  * microbit_heap_stats(stats);
+  *
+  * // A simple measure of fragmentation: how much of the free memory can't be used by a single allocation.
+  * int fragmentation = 100 - (100 * stats.largestFree) / stats.totalFree;
+  * @endcode
+  */
+int microbit_heap_stats(MicroBitHeapStats &stats);
+
+/**
+  * Verifies the integrity of all initialised heaps, by walking every block header
+  * and checking that each relocatable block refers to memory that is in use.
+  *
+  * @return 1 if the heaps are consistent, 0 otherwise.
+  */
+int microbit_heap_verify();
+
+/**
+  * Allocate a relocatable block of memory. Ideal for large, long lived buffers that would otherwise
+  * pin holes in the heap, preventing later allocations from succeeding.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A handle to the allocated memory, or NULL if insufficient memory or handles are available.
+  *
+  * @code
+  * MicroBitHeapHandle *h = microbit_handle_alloc(1024);
+  *
+  * uint8_t *buffer = (uint8_t *) microbit_handle_lock(h);
+  * memset(buffer, 0, 1024);
+  * microbit_handle_unlock(h);
+  * @endcode
+  */
+MicroBitHeapHandle *microbit_handle_alloc(size_t size);
+
+/**
+  * Release a relocatable block of memory, and the handle that refers to it.
+  *
+  * @param handle The handle to release.
+  */
+void microbit_handle_free(MicroBitHeapHandle *handle);
+
+/**
+  * Prevents the given block from being moved, and determines its current location.
+  * Calls may be nested, and must be balanced with calls to microbit_handle_unlock().
+  *
+  * @param handle The handle of the block to lock.
+  *
+  * @return The location of the block, which will remain valid until the block is unlocked.
+  */
+void *microbit_handle_lock(MicroBitHeapHandle *handle);
+
+/**
+  * Allows the given block to be moved again, once all locks on it have been released.
+  *
+  * @param handle The handle of the block to unlock.
+  */
+void microbit_handle_unlock(MicroBitHeapHandle *handle);
+
+/**
+  * Moves at most one unlocked relocatable block towards the start of its heap, merging the free
+  * space it leaves behind with any free space above it. Called periodically from idle().
+  *
+  * @return The number of bytes moved, or zero if no further compaction is possible.
+  */
+int microbit_heap_compact();
+
 #endif
@@ -39,9 +39,43 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_SYSTEM_TIMER_H
 
 #include "mbed.h"
+#include "us_ticker_api.h"
 #include "MicroBitConfig.h"
 #include "MicroBitComponent.h"
 
+/**
+  * Execution time statistics for a component's systemTick(), in microseconds.
+  * Gathered when MICROBIT_SYSTEM_TIMER_PROFILING is enabled.
+  */
+struct SystemTickProfile
+{
+    MicroBitComponent   *component;     // The component profiled.
+    uint32_t            calls;          // The number of times systemTick() has been called.
+    uint32_t            total;          // The total time spent in systemTick().
+    uint16_t            min;            // The shortest time spent in a single call.
+    uint16_t            max;            // The longest time spent in a single call.
+};
+
+/**
+  * Statistics on the interval between successive system timer interrupts, in microseconds.
+  * Gathered when MICROBIT_SYSTEM_TIMER_PROFILING is enabled.
+  */
+struct SystemTickJitter
+{
+    uint32_t            ticks;          // The number of intervals measured.
+    uint32_t            total;          // The sum of all intervals measured.
+    uint32_t            min;            // The shortest interval measured.
+    uint32_t            max;            // The longest interval measured.
+};
+
+/*
+ * Time since power on, in microseconds, at the point the clock was last synchronised,
+ * and the value of the free running microsecond ticker at that same point.
+ * Maintained by update_time(). Use system_timer_current_time_us() to read the clock.
+ */
+extern uint64_t system_timer_base_us;
+extern uint32_t system_timer_base_ticks;
+
 /**
   * Initialises a system wide timer, used to drive the various components used in the runtime.
   *
@@ -70,26 +104,47 @@ int system_timer_set_period(int period);
 int system_timer_get_period();
 
 /**
-  * Updates the current time in microseconds, since power on.
+  * Synchronises the 64 bit system clock with the free running 32 bit microsecond ticker.
+  *
+  * The ticker is never stopped or reset, so no time is lost between calls. This must be called
+  * at least once every 2^32 microseconds (around 71 minutes) to track overflow of the ticker,
+  * which the system timer interrupt does on every tick.
   *
-  * If the mbed Timer hasn't been initialised, it will be initialised
+  * If the system timer hasn't been initialised, it will be initialised
   * on the first call to this function.
   */
-inline void update_time();
+void update_time();
 
 /**
   * Determines the time since the device was powered on.
   *
-  * @return the current time since power on in milliseconds
+  * This is cheap enough to be used freely in interrupt context and on hot paths,
+  * as it only reads the hardware ticker and never modifies the clock.
+  *
+  * @return the current time since power on in microseconds
   */
-uint64_t system_timer_current_time();
+inline uint64_t system_timer_current_time_us()
+{
+    uint32_t primask = __get_PRIMASK();
+    uint64_t t;
+
+    // The 64 bit base is updated from interrupt context, so ensure we read a consistent snapshot.
+    __disable_irq();
+    t = system_timer_base_us + (uint32_t)(us_ticker_read() - system_timer_base_ticks);
+    __set_PRIMASK(primask);
+
+    return t;
+}
 
 /**
   * Determines the time since the device was powered on.
   *
-  * @return the current time since power on in microseconds
+  * @return the current time since power on in milliseconds
   */
-uint64_t system_timer_current_time_us();
+inline uint64_t system_timer_current_time()
+{
+    return system_timer_current_time_us() / 1000;
+}
 
 /**
   * Timer callback. Called from interrupt context, once per period.
@@ -116,6 +171,27 @@ void system_timer_tick();
   */
 int system_timer_add_component(MicroBitComponent *component);
 
+/**
+  * Add a component to the array of system components. This component will then receive
+  * periodic callbacks in interrupt context, at (approximately) the given period.
+  *
+  * Components sharing the same period are spread across different ticks, to even out the
+  * amount of work performed in each system timer interrupt.
+  *
+  * @param component The component to add.
+  *
+  * @param period The period between callbacks in milliseconds, rounded down to a whole number of
+  * system ticks. A period of zero (or less than one system tick) provides a callback every tick.
+  *
+  * @return MICROBIT_OK on success or MICROBIT_NO_RESOURCES if the component array is full.
+  *
+  * @code
+  * // Sample once per second.
+  * system_timer_add_component(thermometer, 1000);
+  * @endcode
+  */
+int system_timer_add_component(MicroBitComponent *component, int period);
+
 /**
   * Remove a component from the array of system components. This component will no longer receive
   * periodic callbacks.
@@ -135,6 +211,134 @@ int system_timer_add_component(MicroBitComponent *component);
   */
 int system_timer_remove_component(MicroBitComponent *component);
 
+/**
+  * Retrieves the execution time statistics of a component registered with the system timer.
+  *
+  * @param index The position of the component in the system timer's list, starting at zero.
+  *
+  * @param profile The structure to populate.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if index is out of range,
+  * or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TIMER_PROFILING is disabled.
+  *
+  * @code
+  * SystemTickProfile p;
+  *
+  * for (int i = 0; system_timer_get_profile(i, p) == MICROBIT_OK; i++)
+  *     uBit.serial.printf("%p: %d/%d/%d us\r\n", p.component, p.min, p.calls ? p.total / p.calls : 0, p.max);
+  * @endcode
+  */
+int system_timer_get_profile(int index, SystemTickProfile &profile);
+
+/**
+  * Retrieves statistics on the interval between successive system timer interrupts.
+  *
+  * @param jitter The structure to populate.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TIMER_PROFILING is disabled.
+  */
+int system_timer_get_jitter(SystemTickJitter &jitter);
+
+/**
+  * Discards all execution time and jitter statistics gathered so far.
+  */
+void system_timer_reset_profile();
+
+/**
+  * Displays a table of systemTick() execution times and system timer jitter
+  * via the debug serial port. Requires MICROBIT_DBG and MICROBIT_SYSTEM_TIMER_PROFILING.
+  */
+void system_timer_print_profile();
+
+/**
+  * Schedules an event to be raised on the default EventModel once the given period has elapsed.
+  * Listeners receive the event in thread context as usual, so no fiber needs to sleep waiting for it.
+  *
+  * @param period The time to wait before raising the event, in milliseconds.
+  *
+  * @param id The ID of the event to raise.
+  *
+  * @param value The value of the event to raise.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  *
+  * @code
+  * #define MY_APP_ID       9000
+  * #define MY_APP_TIMEOUT  1
+  *
+  * uBit.messageBus.listen(MY_APP_ID, MY_APP_TIMEOUT, onTimeout);
+  * system_timer_event_after(500, MY_APP_ID, MY_APP_TIMEOUT);
+  * @endcode
+  */
+int system_timer_event_after(uint32_t period, uint16_t id, uint16_t value);
+
+/**
+  * Schedules an event to be raised on the default EventModel repeatedly, once every period.
+  * Events stay in step with whole periods from the first. If the system falls more than a period behind,
+  * the missed events are skipped rather than raised in a burst.
+  *
+  * @param period The time between events, in milliseconds.
+  *
+  * @param id The ID of the event to raise.
+  *
+  * @param value The value of the event to raise.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is zero,
+  * or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_event_every(uint32_t period, uint16_t id, uint16_t value);
+
+/**
+  * Cancels all timers previously scheduled to raise the given event.
+  *
+  * @param id The ID of the event.
+  *
+  * @param value The value of the event.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no such timer exists.
+  */
+int system_timer_cancel_event(uint16_t id, uint16_t value);
+
+/**
+  * Schedules a function to be called once the given period has elapsed.
+  *
+  * @param period The time to wait before calling the function, in milliseconds.
+  *
+  * @param fn The function to call. This is invoked in interrupt context, so must not block.
+  *
+  * @param arg An optional parameter to pass to the function.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_callback_after(uint32_t period, void (*fn)(void *), void *arg = NULL);
+
+/**
+  * Schedules a function to be called repeatedly, once every period.
+  * Calls stay in step with whole periods from the first. If the system falls more than a period behind,
+  * the missed calls are skipped rather than made in a burst.
+  *
+  * @param period The time between calls, in milliseconds.
+  *
+  * @param fn The function to call. This is invoked in interrupt context, so must not block.
+  *
+  * @param arg An optional parameter to pass to the function.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is zero,
+  * or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_callback_every(uint32_t period, void (*fn)(void *), void *arg = NULL);
+
+/**
+  * Cancels all timers previously scheduled to call the given function with the given parameter.
+  *
+  * @param fn The function.
+  *
+  * @param arg The parameter.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no such timer exists.
+  */
+int system_timer_cancel_callback(void (*fn)(void *), void *arg = NULL);
+
 /**
   * A simple C/C++ wrapper to allow periodic callbacks to standard C functions transparently.
   */
@@ -147,12 +351,14 @@ class MicroBitSystemTimerCallback : MicroBitComponent
      * and, in turn, calls a plain C function as provided as a parameter.
      *
      * @param function the function to invoke upon a systemTick.
+     *
+     * @param period the period between callbacks in milliseconds. Defaults to every system tick.
      */
     public:
-    MicroBitSystemTimerCallback(void (*function)(void))
+    MicroBitSystemTimerCallback(void (*function)(void), int period = 0)
     {
         fn = function;
-        system_timer_add_component(this);
+        system_timer_add_component(this, period);
     }
 
     void systemTick()
@@ -0,0 +1,205 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_ANIMATION_H
+#define MICROBIT_ANIMATION_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitImage.h"
+#include "MicroBitFile.h"
+
+/**
+  * The first two bytes of every animation.
+  */
+#define MICROBIT_ANIMATION_MAGIC_0              0x4D
+#define MICROBIT_ANIMATION_MAGIC_1              0x41
+
+/**
+  * Sizes of the fixed parts of the format, in bytes.
+  */
+#define MICROBIT_ANIMATION_HEADER_SIZE          8
+#define MICROBIT_ANIMATION_FRAME_HEADER_SIZE    3
+
+/**
+  * Frame flags.
+  */
+#define MICROBIT_ANIMATION_FRAME_DELTA          0x01
+
+/**
+  * Class definition for a MicroBitAnimation.
+  *
+  * A MicroBitAnimation is a compressed sequence of frames, read from memory (typically a constant array
+  * in flash) or from a MicroBitFile, and decoded one frame at a time. Only a single frame is ever held in RAM,
+  * however long the animation.
+  *
+  * The format is little endian, and consists of an 8 byte header:
+  *
+  *     'M', 'A', width, height, frame count (16 bit), 0, 0
+  *
+  * followed by each frame in turn:
+  *
+  *     delay in milliseconds (16 bit), flags, pixel data
+  *
+  * The pixel data is width * height bytes, row by row, run length encoded in PackBits form: a control byte n
+  * below 128 is followed by n + 1 literal bytes, while a control byte of 128 or more is followed by a single
+  * byte repeated n - 126 times. If the frame has the MICROBIT_ANIMATION_FRAME_DELTA flag set, each decoded
+  * byte is XORed with the previous frame, so pixels that don't change become long runs of zero.
+  *
+  * encodeHeader() and encodeFrame() produce this format on the device.
+  */
+class MicroBitAnimation
+{
+    const uint8_t *data;                    // The animation, if held in memory.
+    int length;                             // The length of the animation in memory, in bytes.
+    int offset;                             // The position of the next byte to read from memory.
+
+    MicroBitFile *file;                     // The file holding the animation, if not in memory.
+    int start;                              // The position of the animation within the file.
+    uint8_t buffer[MICROBIT_ANIMATION_BUFFER_SIZE];
+    uint8_t bufferLength;
+    uint8_t bufferPosition;
+
+    uint16_t frameCount;                    // The number of frames in the animation.
+    uint16_t frameIndex;                    // The number of frames decoded since the start.
+    MicroBitImage frame;                    // The most recently decoded frame.
+
+    /**
+      * Reads and validates the header, and prepares the frame buffer.
+      */
+    void init(const uint8_t *header);
+
+    /**
+      * Reads the next byte of the animation.
+      *
+      * @return the byte, or MICROBIT_NO_DATA if the end of the animation has been reached.
+      */
+    int readByte();
+
+    public:
+
+    /**
+      * Constructor.
+      * Creates an animation read directly from memory, with no copying.
+      *
+      * @param data The encoded animation. This must remain valid for the life of the animation.
+      *
+      * @param length The length of the encoded animation, in bytes.
+      *
+      * @code
+      * static const uint8_t blink[] = { 'M', 'A', 2, 1, 2, 0, 0, 0,   100, 0, 0, 0x80, 255,   100, 0, 1, 0x80, 255 };
+      * MicroBitAnimation a(blink, sizeof(blink));
+      * uBit.display.animate(a);
+      * @endcode
+      */
+    MicroBitAnimation(const uint8_t *data, int length);
+
+    /**
+      * Constructor.
+      * Creates an animation read from a file, starting at the file's current position.
+      *
+      * @param file The file to read. This must remain open for the life of the animation.
+      */
+    MicroBitAnimation(MicroBitFile &file);
+
+    /**
+      * Determines if the animation has a valid header.
+      */
+    bool isValid();
+
+    /**
+      * Retrieves the width of the animation, in pixels.
+      */
+    int getWidth();
+
+    /**
+      * Retrieves the height of the animation, in pixels.
+      */
+    int getHeight();
+
+    /**
+      * Retrieves the number of frames in the animation.
+      */
+    int getFrameCount();
+
+    /**
+      * Returns to the start of the animation.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if the animation is not valid.
+      */
+    int rewind();
+
+    /**
+      * Decodes the next frame of the animation. The result is available from getFrame().
+      *
+      * @return the time to show the frame for in milliseconds, MICROBIT_NO_DATA if there are no more frames,
+      *         or MICROBIT_INVALID_PARAMETER if the animation is not valid.
+      */
+    int nextFrame();
+
+    /**
+      * Retrieves the most recently decoded frame.
+      */
+    MicroBitImage getFrame();
+
+    /**
+      * Writes the header of an animation.
+      *
+      * @param buffer The buffer to write to, of at least MICROBIT_ANIMATION_HEADER_SIZE bytes.
+      *
+      * @param width The width of the animation, in the range 1 - 255.
+      *
+      * @param height The height of the animation, in the range 1 - 255.
+      *
+      * @param frames The number of frames in the animation.
+      *
+      * @return the number of bytes written, or MICROBIT_INVALID_PARAMETER.
+      */
+    static int encodeHeader(uint8_t *buffer, int width, int height, int frames);
+
+    /**
+      * Encodes a single frame of an animation.
+      *
+      * @param buffer The buffer to write to.
+      *
+      * @param size The size of the buffer. Up to MICROBIT_ANIMATION_FRAME_HEADER_SIZE + width * height * 129 / 128 + 1
+      *             bytes are needed for a frame that doesn't compress.
+      *
+      * @param image The frame to encode. Pixels outside the image are encoded as zero.
+      *
+      * @param width The width of the animation.
+      *
+      * @param height The height of the animation.
+      *
+      * @param delay The time to show the frame for, in milliseconds.
+      *
+      * @param previous The preceding frame, to encode as a delta against. Defaults to none, encoding a key frame.
+      *
+      * @return the number of bytes written, MICROBIT_INVALID_PARAMETER, or MICROBIT_NO_RESOURCES if the buffer is too small.
+      */
+    static int encodeFrame(uint8_t *buffer, int size, MicroBitImage image, int width, int height, int delay, MicroBitImage *previous = NULL);
+};
+
+#endif
@@ -130,7 +130,7 @@ class MicroBitButton : public MicroBitComponent
     void setEventConfiguration(MicroBitButtonEventConfiguration config);
 
     /**
-      * periodic callback from MicroBit system timer.
+      * periodic callback from MicroBit system timer, every MICROBIT_BUTTON_SAMPLE_PERIOD milliseconds (by default, every tick).
       *
       * Check for state change for this button, and fires various events on a state change.
       */
@@ -31,7 +31,12 @@ DEALINGS IN THE SOFTWARE.
 #include "ManagedString.h"
 #include "MicroBitComponent.h"
 #include "MicroBitImage.h"
+#include "MicroBitSprite.h"
+#include "MicroBitTimeline.h"
+#include "MicroBitAnimation.h"
+#include "MicroBitDisplayRecorder.h"
 #include "MicroBitFont.h"
+#include "MicroBitTextStrip.h"
 #include "MicroBitMatrixMaps.h"
 #include "MicroBitLightSensor.h"
 
@@ -57,7 +62,9 @@ enum AnimationMode {
     ANIMATION_MODE_SCROLL_IMAGE,
     ANIMATION_MODE_ANIMATE_IMAGE,
     ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR,
-    ANIMATION_MODE_PRINT_CHARACTER
+    ANIMATION_MODE_PRINT_CHARACTER,
+    ANIMATION_MODE_TIMELINE,
+    ANIMATION_MODE_STREAM
 };
 
 enum DisplayMode {
@@ -73,6 +80,25 @@ enum DisplayRotation {
     MICROBIT_DISPLAY_ROTATION_270
 };
 
+/**
+  * A single step in the schedule used to render one row of the display in greyscale.
+  * Every lit LED in the row is switched on together, and each step switches off those
+  * whose on time has elapsed.
+  */
+struct GreyscaleStep
+{
+    uint16_t columns;           // Bitmask of the columns of the row that are lit during this step.
+    uint16_t delay;             // Time in microseconds until the next step, or zero if this is the last step.
+                                // Delays under MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL are busy waited.
+};
+
+/**
+  * A gamma curve of 2.2, for use with MicroBitDisplay::setGammaTable(), so that evenly spaced pixel values
+  * appear evenly spaced in brightness. The curve is too shallow there for 8 bit levels to follow it, so values
+  * 1 to 24 all map to level 1, and are visible but indistinguishable.
+  */
+extern const uint8_t microbitGammaTable[256];
+
 /**
   * Class definition for MicroBitDisplay.
   *
@@ -86,13 +112,58 @@ class MicroBitDisplay : public MicroBitComponent
     uint8_t strobeRow;
     uint8_t rotation;
     uint8_t mode;
-    uint8_t greyscaleBitMsk;
     uint8_t timingCount;
     uint32_t col_mask;
 
+    // Set when a change to the configuration of the display requires the frame to be recompiled.
+    volatile bool frameDirty;
+
+    // The visible region of the image, as it was when the current frame was compiled.
+    // Rendering only ever uses this copy, so the image can be updated while the display is being strobed.
+    uint8_t *frontBuffer;
+
+    // The visible region of the image alone, that sprites are composited over.
+    // Only allocated once a sprite is added to the display.
+    uint8_t *backgroundBuffer;
+
+    // The sprites shown on the display, in order of increasing depth.
+    MicroBitSprite *sprites;
+
+    // The front buffer packed at a bit per pixel, in the layout of MICROBIT_IMAGE_FORMAT_1BPP.
+    // Updated whenever the frame is compiled, so that it can be read without any work.
+    uint8_t *packedFrame;
+
+    // Offset into the front buffer of the pixel driven by each column of each row of the matrix,
+    // for the current rotation. Indexed as [row * columns + column].
+    uint16_t *pixelMap;
+
+    // Precompiled PORT0 words for each row of the matrix, ready to be written to the LEDs.
+    uint32_t *rowData;
+
+    // Bitmask of the rows of the matrix with at least one LED lit in the current frame.
+    uint32_t litRows;
+
+    // Set if rows with no LEDs lit are skipped when strobing the display.
+    bool adaptiveRefresh;
+
+    // Precompiled greyscale schedule for each row, of (columns + 1) steps each.
+    // Only allocated once greyscale mode is used.
+    GreyscaleStep *greyscaleSteps;
+
+    // The greyscale level shown for each pixel value, combining the brightness and gamma table.
+    // Only allocated once greyscale mode is used, and recompiled with the frame when levelsDirty is set.
+    uint8_t *levelMap;
+    volatile bool levelsDirty;
+
+    // The curve applied to pixel values in greyscale mode, or NULL for a linear response.
+    const uint8_t *gammaTable;
+
     Timeout renderTimer;
     PortOut *LEDMatrix;
 
+    // Receives a copy of every value written to the LED matrix, if set.
+    MicroBitDisplayRecorder *recorder;
+
     //
     // State used by all animation routines.
     //
@@ -106,6 +177,10 @@ class MicroBitDisplay : public MicroBitComponent
     // The time in milliseconds since the frame update.
     uint16_t animationTick;
 
+    // Incremented each time a streamed animation starts, so that the fiber playing one can tell
+    // if it has been stopped and the display taken over by another stream while it slept.
+    uint16_t streamGeneration;
+
     // Stop playback of any animations
     void stopAnimation(int delay);
 
@@ -113,14 +188,11 @@ class MicroBitDisplay : public MicroBitComponent
     // State for scrollString() method.
     // This is a surprisingly intricate method.
     //
-    // The text being displayed.
-    ManagedString scrollingText;
-
-    // The index of the character currently being displayed.
-    uint16_t scrollingChar;
+    // The text being displayed, rendered into a strip of columns.
+    MicroBitTextStrip scrollingStrip;
 
-    // The number of pixels the current character has been shifted on the display.
-    uint8_t scrollingPosition;
+    // The column of the strip that will next be brought onto the display.
+    int32_t scrollingPosition;
 
     //
     // State for printString() method.
@@ -146,6 +218,12 @@ class MicroBitDisplay : public MicroBitComponent
     // The number of pixels the image is shifted on the display in each quantum.
     int8_t scrollingImageStride;
 
+    //
+    // State for playAsync() method.
+    //
+    // The timeline being played.
+    MicroBitTimeline *timeline;
+
     // A pointer to an instance of light sensor, if in use
     MicroBitLightSensor* lightSensor;
 
@@ -168,7 +246,67 @@ class MicroBitDisplay : public MicroBitComponent
     void renderFinish();
 
     /**
-      * Translates a bit mask to a bit mask suitable for the nrf PORT0 and PORT1.
+      * Recalculates the location in the image bitmap of the pixel driven by each LED of the matrix,
+      * taking into account the current rotation of the display.
+      */
+    void compilePixelMap();
+
+    /**
+      * Translates the front buffer into the words written to PORT0 for each row of the matrix
+      * (and the greyscale schedule if in use), so that the strobe interrupt has minimal work to do.
+      */
+    void compileFrame();
+
+    /**
+      * Called at the start of each refresh. Copies any changes to the visible region of the image
+      * into the front buffer, and recompiles the frame only if its content or configuration has changed.
+      */
+    void updateFrame();
+
+    /**
+      * Copies the visible region of the image into a byte per pixel buffer the size of the display.
+      *
+      * @param buffer The buffer to update.
+      *
+      * @return true if the content of the buffer changed, false otherwise.
+      */
+    bool snapshotImage(uint8_t *buffer);
+
+    /**
+      * Clears the changed flag of every sprite, and restores the ordering of the sprite list
+      * by depth if any of them changed.
+      *
+      * @return true if any sprite changed since the last call, false otherwise.
+      */
+    bool updateSprites();
+
+    /**
+      * Moves the strobe on to the next row of the matrix, picking up any changes to the image
+      * at the start of each refresh.
+      */
+    void nextRow();
+
+    /**
+      * Moves the strobe on to the next row of the matrix with an LED lit, found directly from litRows,
+      * picking up any changes to the image if that starts a new refresh.
+      */
+    void nextLitRow();
+
+    /**
+      * Writes a value to the GPIO port driving the LED matrix, passing it on to the recorder if there is one.
+      *
+      * @param value The value to write.
+      */
+    inline void writeMatrix(uint32_t value)
+    {
+        *LEDMatrix = value;
+
+        if (recorder)
+            recorder->record(value);
+    }
+
+    /**
+      * Writes the precompiled bit pattern for the current row to PORT0.
       * Brightness has two levels on, or off.
       */
     void render();
@@ -180,7 +318,23 @@ class MicroBitDisplay : public MicroBitComponent
     void renderWithLightSense();
 
     /**
-      * Translates a bit mask into a timer interrupt that gives the appearence of greyscale.
+      * Recalculates the greyscale level shown for each pixel value, from the gamma table and the brightness.
+      */
+    void compileLevelMap();
+
+    /**
+      * Calculates the greyscale schedule for a single row of the matrix.
+      *
+      * @param row the row of the matrix to compile.
+      *
+      * @param values the greyscale level of each column of the row.
+      */
+    void compileGreyscaleRow(int row, uint8_t *values);
+
+    /**
+      * Steps through the precompiled greyscale schedule of the current row, rescheduling itself
+      * on the render timer. Only steps closer together than MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL
+      * are busy waited in interrupt context.
       */
     void renderGreyscale();
 
@@ -208,12 +362,31 @@ class MicroBitDisplay : public MicroBitComponent
       */
     void updateAnimateImage();
 
+    /**
+      * Internal timeline update method.
+      * Advances the timeline being played, and completes the animation once it is empty.
+      */
+    void updateTimeline();
+
     /**
      * Broadcasts an event onto the defult EventModel indicating that the
      * current animation has completed.
      */
     void sendAnimationCompleteEvent();
 
+    /**
+      * Ensures the display image is a private, full size buffer before an animation starts to update it.
+      * Animations run in interrupt context, so this avoids copy on write having to allocate memory there.
+      */
+    void prepareImage();
+
+    /**
+      * Replaces the display image, without the strobe interrupt ever seeing a buffer that has been freed.
+      *
+      * @param i The image to show.
+      */
+    void replaceImage(const MicroBitImage &i);
+
     /**
       * Blocks the current fiber until the display is available (i.e. does not effect is being displayed).
       * Animations are queued until their time to display.
@@ -235,6 +408,8 @@ class MicroBitDisplay : public MicroBitComponent
 
 public:
     // The mutable bitmap buffer being rendered to the LED matrix.
+    // Images are copy on write, so a copy of it is a snapshot: it doesn't follow later changes to the
+    // display, and drawing into the copy doesn't change the display. Draw into display.image itself.
     MicroBitImage image;
 
     /**
@@ -386,7 +561,7 @@ public:
       * @param delay The time to delay between characters, in milliseconds. Defaults
       *              to: MICROBIT_DEFAULT_SCROLL_SPEED.
       *
-      * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+      * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, MICROBIT_INVALID_PARAMETER, or MICROBIT_NO_RESOURCES if the text could not be laid out.
       *
       * @code
       * display.scrollAsync("abc123",100);
@@ -506,6 +681,59 @@ public:
       */
     int animate(MicroBitImage image, int delay, int stride, int startingPosition = MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS, int autoClear = MICROBIT_DISPLAY_DEFAULT_AUTOCLEAR);
 
+    /**
+      * Plays a compressed animation on the display, decoding one frame at a time.
+      * Blocks the calling thread until the animation is complete.
+      *
+      * Frames are decoded by the calling fiber rather than in interrupt context, so animations can be
+      * streamed from a file, and only a single frame is ever held in RAM.
+      *
+      * @param animation The animation to play, from its first frame.
+      *
+      * @return MICROBIT_OK, MICROBIT_CANCELLED, or MICROBIT_INVALID_PARAMETER if the animation is not valid.
+      *
+      * @code
+      * MicroBitFile f("intro.anim", READ);
+      * MicroBitAnimation a(f);
+      * display.animate(a);
+      * @endcode
+      */
+    int animate(MicroBitAnimation &animation);
+
+    /**
+      * Plays the items queued on the given timeline, if the display is not in use.
+      * Returns immediately. Items can continue to be added to the timeline while it is playing,
+      * and the animation completes once the timeline is empty.
+      *
+      * @param timeline The timeline to play. It must remain valid until playback completes.
+      *
+      * @return MICROBIT_OK, or MICROBIT_BUSY if the display is already in use.
+      *
+      * @code
+      * MicroBitTimeline t;
+      * t.addScroll("hi");
+      * t.addFade(0, 255, 500);
+      * display.playAsync(t);
+      * @endcode
+      */
+    int playAsync(MicroBitTimeline &timeline);
+
+    /**
+      * Plays the items queued on the given timeline.
+      * Blocks the calling thread until the timeline is empty.
+      *
+      * @param timeline The timeline to play.
+      *
+      * @return MICROBIT_OK, or MICROBIT_CANCELLED.
+      *
+      * @code
+      * MicroBitTimeline t;
+      * t.addFrame(MicroBitImage("255,0\n0,255\n"), 1000);
+      * display.play(t);
+      * @endcode
+      */
+    int play(MicroBitTimeline &timeline);
+
     /**
       * Configures the brightness of the display.
       *
@@ -531,6 +759,23 @@ public:
       */
     void setDisplayMode(DisplayMode mode);
 
+    /**
+      * Configures the curve used to translate pixel values into LED brightness in greyscale mode.
+      *
+      * The table is combined with the display brightness into a single lookup table whenever either changes,
+      * so it costs nothing as each frame is drawn.
+      *
+      * @param table 256 entries giving the level shown for each pixel value, or NULL for a linear response.
+      *              The table is not copied, and must remain valid while in use. microbitGammaTable gives
+      *              a perceptually even response.
+      *
+      * @code
+      * display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+      * display.setGammaTable(microbitGammaTable);
+      * @endcode
+      */
+    void setGammaTable(const uint8_t *table);
+
     /**
       * Retrieves the mode of the display.
       *
@@ -538,6 +783,27 @@ public:
       */
     int getDisplayMode();
 
+    /**
+      * Enables or disables adaptive refresh. When enabled, rows of the matrix with no LEDs lit are skipped,
+      * and their time shared between the rows that are lit, which appear brighter as a result. If nothing is lit
+      * at all, the matrix is not driven. Has no effect in DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE, which
+      * relies on a fixed strobe sequence.
+      *
+      * @param enable true to enable adaptive refresh, false to strobe every row in turn.
+      *
+      * @code
+      * display.setAdaptiveRefresh(true);
+      * @endcode
+      */
+    void setAdaptiveRefresh(bool enable);
+
+    /**
+      * Determines if adaptive refresh is enabled.
+      *
+      * @return true if rows with no LEDs lit are skipped, false otherwise.
+      */
+    bool isAdaptiveRefresh();
+
     /**
       * Fetches the current brightness of this display.
       *
@@ -614,9 +880,68 @@ public:
       * Captures the bitmap currently being rendered on the display.
       *
       * @return a MicroBitImage containing the captured data.
+      *
+      * @note This allocates a new image. Use getSnapshot() to capture the display without allocating memory.
       */
     MicroBitImage screenShot();
 
+    /**
+      * Gets the number of bytes needed to hold a snapshot of the display from getSnapshot().
+      *
+      * @return The size of a snapshot, in bytes.
+      */
+    int getSnapshotSize();
+
+    /**
+      * Copies the frame currently being shown into a caller provided buffer, packed at a bit per pixel.
+      *
+      * Each row of the display takes (width + 7) / 8 bytes, with the leftmost pixel of each in the least
+      * significant bit, as in MICROBIT_IMAGE_FORMAT_1BPP. A bit is set for any pixel that is not blank.
+      * The snapshot includes any sprites, and is kept up to date as each frame is compiled,
+      * so taking one needs no memory to be allocated and costs no more than a copy.
+      *
+      * @param buffer The buffer to receive the snapshot.
+      *
+      * @param length The size of the buffer, which must be at least getSnapshotSize() bytes.
+      *
+      * @return The number of bytes written, or MICROBIT_INVALID_PARAMETER.
+      *
+      * @code
+      * uint8_t frame[5];
+      * display.getSnapshot(frame, sizeof(frame));
+      * @endcode
+      *
+      * @note While the display is disabled, the frame is compiled on demand, so the snapshot still
+      *       follows changes to the image.
+      */
+    int getSnapshot(uint8_t *buffer, int length);
+
+    /**
+      * Adds a sprite to the display. Sprites are composited over the display's image in order of
+      * depth, and are redrawn automatically whenever they are moved or otherwise changed.
+      *
+      * @param sprite The sprite to add. It must remain valid until removed from the display.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the sprite is already on the display,
+      *         or MICROBIT_NO_RESOURCES if there is insufficient memory to composite sprites.
+      *
+      * @code
+      * MicroBitSprite ball(MicroBitImage("255\n"), 2, 2);
+      * display.addSprite(ball);
+      * ball.moveBy(1, 0);
+      * @endcode
+      */
+    int addSprite(MicroBitSprite &sprite);
+
+    /**
+      * Removes a sprite from the display.
+      *
+      * @param sprite The sprite to remove.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the sprite is not on the display.
+      */
+    int removeSprite(MicroBitSprite &sprite);
+
     /**
       * Gives a representative figure of the light level in the current environment
       * where are micro:bit is situated.
@@ -635,6 +960,35 @@ public:
       */
     int readLightLevel();
 
+    /**
+      * Attaches a recorder, which keeps a timestamped copy of every write to the LED matrix.
+      * Used to check what the display shows, and how, without needing to see the LEDs.
+      *
+      * @param recorder The recorder to attach, or NULL to detach the current recorder.
+      *
+      * @code
+      * MicroBitDisplayRecorder recorder(256);
+      * display.setRecorder(&recorder);
+      * @endcode
+      */
+    void setRecorder(MicroBitDisplayRecorder *recorder);
+
+    /**
+      * Retrieves the light sensor that uses the LEDs of the display, so that continuous sensing, smoothing
+      * and threshold events can be configured.
+      *
+      * Internally, it constructs an instance of a MicroBitLightSensor if not already configured
+      * and sets the display mode to DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE.
+      *
+      * @return the light sensor.
+      *
+      * @code
+      * display.getLightSensor().setContinuous(true);
+      * display.getLightSensor().setSmoothing(3);
+      * @endcode
+      */
+    MicroBitLightSensor& getLightSensor();
+
     /**
       * Destructor for MicroBitDisplay, where we deregister this instance from the array of system components.
       */
@@ -0,0 +1,136 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_DISPLAY_RECORDER_H
+#define MICROBIT_DISPLAY_RECORDER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitImage.h"
+#include "MicroBitMatrixMaps.h"
+
+/**
+  * A single value written to the LED matrix, and when it was written.
+  */
+struct MicroBitDisplaySample
+{
+    uint32_t time;                          // The time of the write, in microseconds since power on (modulo 2^32).
+    uint32_t value;                         // The value written to the GPIO port driving the matrix.
+};
+
+/**
+  * Class definition for a MicroBitDisplayRecorder.
+  *
+  * A recorder attached to a MicroBitDisplay with setRecorder() keeps a timestamped copy of the most recent
+  * writes to the LED matrix. From these it can reconstruct the image a viewer would have perceived over any
+  * period, so that scrolling, animation, rotation and greyscale rendering can be checked without LEDs,
+  * and the cost of the strobe interrupt measured from the spacing of the writes.
+  *
+  * @code
+  * MicroBitDisplayRecorder recorder(256);
+  * uBit.display.setRecorder(&recorder);
+  * uBit.display.print('A');
+  * uBit.sleep(100);
+  * uBit.serial.send(recorder.getFrame().toString());
+  * @endcode
+  */
+class MicroBitDisplayRecorder
+{
+    const MatrixMap &matrixMap;
+    MicroBitDisplaySample *samples;         // A ring buffer of the most recent writes.
+    uint16_t capacity;                      // The number of writes the buffer can hold.
+    uint16_t length;                        // The number of writes in the buffer.
+    uint16_t head;                          // The position the next write will be stored at.
+
+    // Recorders own their buffer, so aren't copied.
+    MicroBitDisplayRecorder(const MicroBitDisplayRecorder &);
+    MicroBitDisplayRecorder& operator=(const MicroBitDisplayRecorder &);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * @param capacity The number of writes to keep. Once full, the oldest writes are discarded.
+      *
+      * @param map The matrix map of the display being recorded. Defaults to microbitMatrixMap.
+      */
+    MicroBitDisplayRecorder(int capacity, const MatrixMap &map = microbitMatrixMap);
+
+    /**
+      * Records a write to the LED matrix. Called by MicroBitDisplay, from interrupt context.
+      *
+      * @param value The value written to the GPIO port.
+      */
+    void record(uint32_t value);
+
+    /**
+      * Discards all recorded writes.
+      */
+    void clear();
+
+    /**
+      * Determines the number of writes currently recorded.
+      */
+    int getLength();
+
+    /**
+      * Retrieves a recorded write.
+      *
+      * @param index The write to retrieve, where 0 is the oldest.
+      *
+      * @param sample The structure to fill in.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if the index is out of range.
+      */
+    int getSample(int index, MicroBitDisplaySample &sample);
+
+    /**
+      * Reconstructs the image perceived over the given period, from the recorded writes.
+      * A pixel is at full brightness (255) if its LED was lit for the whole of its row's share of the period.
+      * The image is in the physical orientation of the matrix, regardless of any rotation of the display.
+      *
+      * @param start The start of the period, in microseconds since power on.
+      *
+      * @param end The end of the period, in microseconds since power on.
+      *
+      * @return the perceived image, or an empty image if the period is invalid.
+      */
+    MicroBitImage getFrame(uint32_t start, uint32_t end);
+
+    /**
+      * Reconstructs the image perceived over the whole period covered by the recorded writes.
+      *
+      * @return the perceived image, or an empty image if fewer than two writes have been recorded.
+      */
+    MicroBitImage getFrame();
+
+    /**
+      * Destructor.
+      */
+    ~MicroBitDisplayRecorder();
+};
+
+#endif
@@ -39,6 +39,12 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_LIGHT_SENSOR_MAX_VALUE     338
 #define MICROBIT_LIGHT_SENSOR_MIN_VALUE     75
 
+/**
+  * Light sensor events
+  */
+#define MICROBIT_LIGHT_SENSOR_EVT_DARK      1
+#define MICROBIT_LIGHT_SENSOR_EVT_BRIGHT    2
+
 /**
   * Class definition for MicroBitLightSensor.
   *
@@ -56,8 +62,29 @@ class MicroBitLightSensor
     //a Timeout which triggers our analogReady() call
     Timeout analogTrigger;
 
-    //a pointer the currently sensed pin, represented as an AnalogIn
-    AnalogIn* sensePin;
+    //set if every channel is sampled in each sensing slot, rather than one channel per slot. Slots are no more frequent.
+    bool continuous;
+    //the value of continuous when the current sensing slot started, so a slot is finished as it was begun
+    bool sampleAll;
+
+    //the light level, after smoothing, in 24.8 fixed point
+    int32_t filtered;
+
+    //the number of bits the smoothing filter shifts each new reading by
+    uint8_t smoothing;
+
+    //the most recent filtered light levels, oldest first from historyHead once full
+    uint8_t history[MICROBIT_LIGHT_SENSOR_HISTORY];
+    uint8_t historyHead;
+    uint8_t historyLength;
+
+    //light levels at or below which MICROBIT_LIGHT_SENSOR_EVT_DARK is raised, and at or above which
+    //MICROBIT_LIGHT_SENSOR_EVT_BRIGHT is raised. Disabled when out of range.
+    int16_t darkThreshold;
+    int16_t brightThreshold;
+
+    //the most recent threshold event raised, or zero if none
+    uint8_t thresholdState;
 
     const MatrixMap &matrixMap;
 
@@ -81,6 +108,27 @@ class MicroBitLightSensor
       */
     void analogDisable();
 
+    /**
+      * Takes a single ADC reading of the given channel. Configures the ADC directly,
+      * so no memory is allocated in interrupt context.
+      *
+      * @param chan the channel (column) to read.
+      *
+      * @return the raw 10 bit reading.
+      */
+    int sample(int chan);
+
+    /**
+      * Converts the latest readings of all channels into a light level in the range 0 - 255.
+      */
+    int level();
+
+    /**
+      * Feeds the latest readings through the smoothing filter into the history buffer,
+      * and raises any threshold events.
+      */
+    void update();
+
     public:
 
     /**
@@ -94,7 +142,8 @@ class MicroBitLightSensor
     MicroBitLightSensor(const MatrixMap &map);
 
     /**
-      * This method returns a summed average of the three sections of the display.
+      * This method returns the light level, smoothed as configured by setSmoothing(), from a summed
+      * average of the three sections of the display.
       *
       * A section is defined as:
       *  ___________________
@@ -116,6 +165,57 @@ class MicroBitLightSensor
       */
     int read();
 
+    /**
+      * Selects whether every section of the display is sampled each time the display pauses to sense light,
+      * rather than a single section each time. This doesn't sense any more often: the display still pauses
+      * for light sensing at the same rate. But as each pause then updates all three sections, the light level
+      * follows a change in about a third of the time, at the cost of a little more time spent in interrupt context.
+      *
+      * @param enable true to sample every section each time, false to sample one section at a time.
+      */
+    void setContinuous(bool enable);
+
+    /**
+      * Configures the smoothing applied to the light level. Each new reading moves the smoothed level
+      * 1 / 2^shift of the way towards it.
+      *
+      * @param shift the amount of smoothing, in the range 0 (none) to 7.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+      */
+    int setSmoothing(int shift);
+
+    /**
+      * Configures threshold events. MICROBIT_LIGHT_SENSOR_EVT_DARK is raised when the smoothed light level
+      * falls to the dark threshold, and MICROBIT_LIGHT_SENSOR_EVT_BRIGHT when it rises to the bright threshold.
+      * Each is only raised again once the other has been, so the gap between them acts as hysteresis.
+      * With only one threshold set, its event is raised again once the level has moved back past it by
+      * MICROBIT_LIGHT_SENSOR_HYSTERESIS and returned.
+      *
+      * @param dark the dark threshold, in the range 0 - 255, or -1 to disable dark events.
+      *
+      * @param bright the bright threshold, in the range 0 - 255, or -1 to disable bright events.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if a threshold is out of range or dark is not below bright.
+      *
+      * @code
+      * uBit.display.getLightSensor().setThresholds(40, 120);
+      * uBit.messageBus.listen(MICROBIT_ID_LIGHT_SENSOR, MICROBIT_LIGHT_SENSOR_EVT_DARK, onDark);
+      * @endcode
+      */
+    int setThresholds(int dark, int bright);
+
+    /**
+      * Copies the most recent smoothed light levels, oldest first.
+      *
+      * @param buffer the buffer to fill.
+      *
+      * @param length the size of the buffer. Up to MICROBIT_LIGHT_SENSOR_HISTORY levels are available.
+      *
+      * @return the number of levels copied, or MICROBIT_INVALID_PARAMETER.
+      */
+    int getHistory(uint8_t *buffer, int length);
+
     /**
       * The method that is invoked by sending MICROBIT_DISPLAY_EVT_LIGHT_SENSE
       * using the id MICROBIT_ID_DISPLAY.
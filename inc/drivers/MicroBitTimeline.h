@@ -0,0 +1,206 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_TIMELINE_H
+#define MICROBIT_TIMELINE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+#include "MicroBitImage.h"
+
+/**
+  * The kinds of item that can be queued on a timeline.
+  */
+#define MICROBIT_TIMELINE_FRAME                 1
+#define MICROBIT_TIMELINE_SCROLL                2
+#define MICROBIT_TIMELINE_FADE                  3
+#define MICROBIT_TIMELINE_PAUSE                 4
+
+class MicroBitDisplay;
+
+/**
+  * A single precomputed item of a timeline.
+  */
+struct MicroBitTimelineItem
+{
+    MicroBitImage image;                    // The image shown by a frame or scroll.
+    uint16_t duration;                      // The length of a frame, pause or fade, or the interval between steps of a scroll (ms).
+    int16_t a;                              // The x position of a frame, first position of a scroll, or starting brightness of a fade.
+    int16_t b;                              // The y position of a frame, number of steps of a scroll, or final brightness of a fade.
+    int8_t stride;                          // The distance moved by each step of a scroll.
+    uint8_t type;                           // One of MICROBIT_TIMELINE_*.
+    int32_t rate;                           // The change in brightness per millisecond of a fade, in 16.16 fixed point.
+};
+
+/**
+  * Class definition for a MicroBitTimeline.
+  *
+  * A timeline is a queue of display effects - image frames, scrolls, brightness fades and pauses -
+  * that is played back by the display entirely from its periodic interrupt, with no fiber involvement.
+  * Everything an effect needs (text layout, fade rates, scroll extents) is calculated as it is added,
+  * so playback does no more than paste an image or set the brightness.
+  *
+  * Items can be added at any time, including while the timeline is playing, and never block.
+  *
+  * The display never frees memory from its interrupt, so the images of played items are held until
+  * the next item is added, the timeline is cleared, or a call to MicroBitDisplay::play() returns.
+  *
+  * @code
+  * MicroBitTimeline t;
+  * t.addFrame(MicroBitImage("255,0,255\n0,255,0\n"), 500);
+  * t.addFade(255, 0, 400);
+  * t.addScroll("hello");
+  * uBit.display.playAsync(t);
+  * @endcode
+  */
+class MicroBitTimeline
+{
+    friend class MicroBitDisplay;
+
+    // A ring buffer of items. Items are added at head by fibers, and consumed from tail by the display.
+    MicroBitTimelineItem items[MICROBIT_TIMELINE_LENGTH];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+
+    // Playback state of the item at the tail of the queue.
+    bool started;
+    uint16_t elapsed;
+    int16_t position;
+    int16_t remaining;
+
+    /**
+      * Releases the images held by slots that the display has finished with.
+      * Called from fiber context, so images are never freed by the display's interrupt.
+      */
+    void release();
+
+    /**
+      * Adds a precomputed item to the end of the queue.
+      *
+      * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the queue is full.
+      */
+    int queue(uint8_t type, MicroBitImage image, int duration, int a, int b, int stride, int32_t rate);
+
+    /**
+      * Shows the first step of the given item on the display.
+      */
+    void start(MicroBitDisplay &display, MicroBitTimelineItem &item);
+
+    /**
+      * Advances playback. Called by the display from interrupt context on each animation tick.
+      *
+      * @param display The display to update.
+      *
+      * @param period The time since the last call, in milliseconds.
+      *
+      * @return true if the timeline is still playing, false once all items have been played.
+      */
+    bool update(MicroBitDisplay &display, int period);
+
+    public:
+
+    /**
+      * Constructor.
+      * Creates an empty timeline.
+      */
+    MicroBitTimeline();
+
+    /**
+      * Queues an image to be shown on the display for a given time.
+      *
+      * @param image The image to show.
+      *
+      * @param duration The time to show the image for, in milliseconds.
+      *
+      * @param x The horizontal position of the image on the display. Defaults to 0.
+      *
+      * @param y The vertical position of the image on the display. Defaults to 0.
+      *
+      * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+      */
+    int addFrame(MicroBitImage image, int duration, int x = 0, int y = 0);
+
+    /**
+      * Queues an image to be scrolled across the display.
+      *
+      * @param image The image to scroll.
+      *
+      * @param delay The time between each step of the scroll, in milliseconds. Defaults to MICROBIT_DEFAULT_SCROLL_SPEED.
+      *
+      * @param stride The number of pixels moved by each step. Negative values scroll from right to left.
+      *               Defaults to MICROBIT_DEFAULT_SCROLL_STRIDE.
+      *
+      * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+      */
+    int addScroll(MicroBitImage image, int delay = MICROBIT_DEFAULT_SCROLL_SPEED, int stride = MICROBIT_DEFAULT_SCROLL_STRIDE);
+
+    /**
+      * Queues text to be scrolled across the display, from right to left.
+      * The text is rendered into an image immediately, so nothing is decoded during playback.
+      *
+      * @param s The text to scroll.
+      *
+      * @param delay The time between each step of the scroll, in milliseconds. Defaults to MICROBIT_DEFAULT_SCROLL_SPEED.
+      *
+      * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full
+      *         or the text could not be rendered.
+      */
+    int addScroll(ManagedString s, int delay = MICROBIT_DEFAULT_SCROLL_SPEED);
+
+    /**
+      * Queues a linear change in the brightness of the display.
+      *
+      * @param from The brightness at the start of the fade, in the range 0 - 255.
+      *
+      * @param to The brightness at the end of the fade, in the range 0 - 255.
+      *
+      * @param duration The length of the fade, in milliseconds.
+      *
+      * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+      */
+    int addFade(int from, int to, int duration);
+
+    /**
+      * Queues a pause, during which the display is left unchanged.
+      *
+      * @param duration The length of the pause, in milliseconds.
+      *
+      * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+      */
+    int addPause(int duration);
+
+    /**
+      * Determines the number of items waiting to be played, including any item currently playing.
+      */
+    int getLength();
+
+    /**
+      * Removes all items from the timeline. If the timeline is playing, it completes on the next tick.
+      */
+    void clear();
+};
+
+#endif
@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_MANAGED_TYPE_H
 
 #include "MicroBitConfig.h"
+#include "MicroBitArena.h"
 
 /**
   * Class definition for a Generic Managed Type.
@@ -168,7 +169,7 @@ template<typename T>
 ManagedType<T>::ManagedType(T* object)
 {
     this->object = object;
-    ref = (int *)malloc(sizeof(int));
+    ref = (int *)microbit_arena_malloc(sizeof(int));
     *ref = 1;
 }
 
@@ -179,7 +180,7 @@ template<typename T>
 ManagedType<T>::ManagedType()
 {
     this->object = NULL;
-    ref = (int *)malloc(sizeof(int));
+    ref = (int *)microbit_arena_malloc(sizeof(int));
     *ref = 0;
 }
 
@@ -212,7 +213,7 @@ ManagedType<T>::~ManagedType()
     if (*ref == 0)
     {
         // Simply destroy our reference counter and we're done.
-        free(ref);
+        microbit_arena_free(ref);
     }
 
     // Normal case - we have a valid piece of data.
@@ -220,7 +221,7 @@ ManagedType<T>::~ManagedType()
     else if (--(*ref) == 0)
     {
         delete object;
-        free(ref);
+        microbit_arena_free(ref);
     }
 }
 
@@ -243,13 +244,13 @@ ManagedType<T>& ManagedType<T>::operator = (const ManagedType<T>&t)
     if (*ref == 0)
     {
         // Simply destroy our reference counter, as we're about to adopt another.
-        free(ref);
+        microbit_arena_free(ref);
     }
 
     else if (--(*ref) == 0)
     {
         delete object;
-        free(ref);
+        microbit_arena_free(ref);
     }
 
     object = t.object;
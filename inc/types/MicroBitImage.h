@@ -31,18 +31,88 @@ DEALINGS IN THE SOFTWARE.
 #include "ManagedString.h"
 #include "RefCounted.h"
 
+/**
+  * The pixel formats a MicroBitImage can be stored in.
+  *
+  * Packed formats hold each row in whole bytes, with pixels from the least significant bits upwards.
+  * Pixel values are always read and written in the range 0..255, and converted to and from the
+  * packed representation as necessary.
+  */
+enum ImageFormat
+{
+    MICROBIT_IMAGE_FORMAT_8BPP = 0,     // One byte per pixel, with 256 levels.
+    MICROBIT_IMAGE_FORMAT_4BPP = 1,     // Two pixels per byte, with 16 levels.
+    MICROBIT_IMAGE_FORMAT_1BPP = 2      // Eight pixels per byte, either on or off.
+};
+
 struct ImageData : RefCounted
 {
-    uint16_t width;     // Width in pixels
-    uint16_t height;    // Height in pixels
-    uint8_t data[0];    // 2D array representing the bitmap image
+    uint16_t width;         // Width in pixels
+    uint16_t height : 12;   // Height in pixels
+    uint16_t format : 4;    // Pixel format of the bitmap, one of ImageFormat
+    uint8_t data[0];        // 2D array representing the bitmap image
 };
 
+/**
+  * Declares the data of a read only image, held in flash and built entirely at compile time.
+  * No parsing is done and no memory is allocated when the image is used, unlike MicroBitImage(const char *).
+  * Use MICROBIT_IMAGE() to refer to the data as a MicroBitImage.
+  *
+  * The pixel data is given row by row, in the layout of the chosen format (packed formats hold the leftmost
+  * pixel in the lowest bits of each byte). The number of bytes given is checked against the size of the image
+  * when compiled.
+  *
+  * @param name The name of the literal to declare.
+  *
+  * @param width The width of the image, in pixels.
+  *
+  * @param height The height of the image, in pixels.
+  *
+  * @param format The pixel format of the data, one of ImageFormat.
+  *
+  * @code
+  * MICROBIT_IMAGE_LITERAL_FORMAT(tick, 5, 5, MICROBIT_IMAGE_FORMAT_1BPP, 0x00, 0x10, 0x08, 0x05, 0x02);
+  * uBit.display.print(MICROBIT_IMAGE(tick));
+  * @endcode
+  */
+#define MICROBIT_IMAGE_LITERAL_FORMAT(name, width, height, format, ...)                                         \
+    static const uint8_t name[] __attribute__ ((aligned (4))) =                                                 \
+        { 0xff, 0xff, (width) & 0xff, ((width) >> 8) & 0xff, (height) & 0xff, (((height) >> 8) & 0x0f) | ((format) << 4), __VA_ARGS__ }; \
+    static_assert(sizeof(name) == sizeof(ImageData) + (height) * (((width) * ((format) == MICROBIT_IMAGE_FORMAT_8BPP ? 8 : (format) == MICROBIT_IMAGE_FORMAT_4BPP ? 4 : 1) + 7) >> 3), \
+        "image literal " #name " does not match its dimensions")
+
+/**
+  * Declares the data of a read only image of one byte per pixel, held in flash and built entirely at compile time.
+  *
+  * @param name The name of the literal to declare.
+  *
+  * @param width The width of the image, in pixels.
+  *
+  * @param height The height of the image, in pixels.
+  *
+  * @code
+  * MICROBIT_IMAGE_LITERAL(heart, 5, 5, 0,255,0,255,0, 255,255,255,255,255, 255,255,255,255,255, 0,255,255,255,0, 0,0,255,0,0);
+  * uBit.display.print(MICROBIT_IMAGE(heart));
+  * @endcode
+  */
+#define MICROBIT_IMAGE_LITERAL(name, width, height, ...)                                                        \
+    MICROBIT_IMAGE_LITERAL_FORMAT(name, width, height, MICROBIT_IMAGE_FORMAT_8BPP, __VA_ARGS__)
+
+/**
+  * Refers to a literal declared with MICROBIT_IMAGE_LITERAL() as a MicroBitImage.
+  * The image is a temporary that shares the literal's data in flash, so it costs no more than a pointer copy
+  * to create, and needs no static object to be constructed or destroyed.
+  *
+  * @param name The name of the literal.
+  */
+#define MICROBIT_IMAGE(name)                                                                                    \
+    MicroBitImage((ImageData *)(void *)(name))
+
 /**
   * Class definition for a MicroBitImage.
   *
   * An MicroBitImage is a simple bitmap representation of an image.
-  * n.b. This is a mutable, managed type.
+  * n.b. This is a mutable, managed type. Copies share the same bitmap until one of them is modified.
   */
 class MicroBitImage
 {
@@ -56,9 +126,11 @@ class MicroBitImage
       *
       * @param y the height of the image
       *
-      * @param bitmap an array of integers that make up an image.
+      * @param bitmap an array of integers that make up an image, one byte per pixel.
+      *
+      * @param format the pixel format the image is stored in.
       */
-    void init(const int16_t x, const int16_t y, const uint8_t *bitmap);
+    void init(const int16_t x, const int16_t y, const uint8_t *bitmap, ImageFormat format = MICROBIT_IMAGE_FORMAT_8BPP);
 
     /**
       * Internal constructor which defaults to the Empty Image instance variable
@@ -77,6 +149,11 @@ class MicroBitImage
 
     /**
       * Return a 2D array representing the bitmap image.
+      *
+      * @note this is only one byte per pixel for images in MICROBIT_IMAGE_FORMAT_8BPP. Each row is getStride() bytes long.
+      *
+      * @note images are copy on write, and the bitmap may be shared with other images (or reside in flash).
+      *       Call detach() before writing through this pointer.
       */
     uint8_t *getBitmap()
     {
@@ -88,11 +165,14 @@ class MicroBitImage
       * Create an image from a specially prepared constant array, with no copying. Will call ptr->incr().
       *
       * @param ptr The literal - first two bytes should be 0xff, then width, 0, height, 0, and the bitmap. Width and height are 16 bit. The literal has to be 4-byte aligned.
+      *            The top four bits of the height select a packed ImageFormat, and are normally zero for one byte per pixel.
       *
       * @code
       * static const uint8_t heart[] __attribute__ ((aligned (4))) = { 0xff, 0xff, 10, 0, 5, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, }; // a cute heart
       * MicroBitImage i((ImageData*)(void*)heart);
       * @endcode
+      *
+      * @note MICROBIT_IMAGE_LITERAL() builds such a literal at compile time, and MICROBIT_IMAGE() wraps it in an image.
       */
     MicroBitImage(ImageData *ptr);
 
@@ -150,6 +230,22 @@ class MicroBitImage
       */
     MicroBitImage(const int16_t x, const int16_t y);
 
+    /**
+      * Constructor.
+      * Create a blank bitmap representation of a given size, stored in the given pixel format.
+      *
+      * @param x the width of the image.
+      *
+      * @param y the height of the image.
+      *
+      * @param format the pixel format to store the image in.
+      *
+      * @code
+      * MicroBitImage i(100, 5, MICROBIT_IMAGE_FORMAT_1BPP); // a monochrome scroll buffer, in 65 bytes rather than 500.
+      * @endcode
+      */
+    MicroBitImage(const int16_t x, const int16_t y, ImageFormat format);
+
     /**
       * Constructor.
       * Create a bitmap representation of a given size, based on a given buffer.
@@ -325,6 +421,164 @@ class MicroBitImage
        */
     int print(char c, int16_t x = 0, int16_t y = 0);
 
+    /**
+      * Prints the glyph for a character code of the system font at the given location.
+      *
+      * The glyph is centred in a cell as wide as the widest glyph of the font, and the rest of the cell is cleared.
+      *
+      * @param c The character code to display, such as one returned by MicroBitFont::nextCharacter().
+      *
+      * @param x The x co-ordinate of on the image to place the top left of the character cell. Defaults to 0.
+      *
+      * @param y The y co-ordinate of on the image to place the top left of the character cell. Defaults to 0.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.printCharacter(0xe9); // é, if the system font includes it
+      * @endcode
+      */
+    int printCharacter(uint16_t c, int16_t x = 0, int16_t y = 0);
+
+    /**
+      * Fills a rectangular area of this image with a single value.
+      *
+      * The rectangle is clipped to the bounds of the image once, and each row is then filled as a single run.
+      *
+      * @param x The leftmost co-ordinate of the rectangle.
+      *
+      * @param y The uppermost co-ordinate of the rectangle.
+      *
+      * @param width The width of the rectangle.
+      *
+      * @param height The height of the rectangle.
+      *
+      * @param value The brightness level 0-255 to fill with.
+      *
+      * @return MICROBIT_OK on success (including when the rectangle lies wholly outside the image),
+      *         or MICROBIT_INVALID_PARAMETER if the width or height is negative.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.fillRect(1, 1, 3, 3, 255); // a 3x3 square in the middle of the image
+      * @endcode
+      */
+    int fillRect(int16_t x, int16_t y, int16_t width, int16_t height, uint8_t value);
+
+    /**
+      * Draws a horizontal line, clipped to the bounds of this image.
+      *
+      * @param x The leftmost co-ordinate of the line.
+      *
+      * @param y The co-ordinate of the row to draw on.
+      *
+      * @param length The number of pixels in the line.
+      *
+      * @param value The brightness level 0-255 to draw with.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the length is negative.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.drawHLine(0, 2, 5, 255);
+      * @endcode
+      */
+    int drawHLine(int16_t x, int16_t y, int16_t length, uint8_t value);
+
+    /**
+      * Draws a vertical line, clipped to the bounds of this image.
+      *
+      * @param x The co-ordinate of the column to draw on.
+      *
+      * @param y The uppermost co-ordinate of the line.
+      *
+      * @param length The number of pixels in the line.
+      *
+      * @param value The brightness level 0-255 to draw with.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the length is negative.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.drawVLine(2, 0, 5, 255);
+      * @endcode
+      */
+    int drawVLine(int16_t x, int16_t y, int16_t length, uint8_t value);
+
+    /**
+      * Draws a straight line between two points, inclusive, using Bresenham's algorithm.
+      *
+      * Horizontal and vertical lines are filled as runs. Other lines that lie wholly inside the image are
+      * drawn without checking the bounds of each pixel, and those wholly outside are rejected up front.
+      *
+      * @param x0 The x co-ordinate of the start of the line.
+      *
+      * @param y0 The y co-ordinate of the start of the line.
+      *
+      * @param x1 The x co-ordinate of the end of the line.
+      *
+      * @param y1 The y co-ordinate of the end of the line.
+      *
+      * @param value The brightness level 0-255 to draw with.
+      *
+      * @return MICROBIT_OK.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.drawLine(0, 0, 4, 4, 255); // a diagonal line across the image
+      * @endcode
+      */
+    int drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t value);
+
+    /**
+      * Draws a circle, using the midpoint circle algorithm.
+      *
+      * A filled circle is drawn as one clipped run per row. The outline of a circle that lies wholly inside the
+      * image is drawn without checking the bounds of each pixel, and one wholly outside is rejected up front.
+      *
+      * @param x The x co-ordinate of the centre of the circle.
+      *
+      * @param y The y co-ordinate of the centre of the circle.
+      *
+      * @param radius The radius of the circle, in pixels.
+      *
+      * @param value The brightness level 0-255 to draw with.
+      *
+      * @param fill true to fill the circle, false to draw only its outline. Defaults to false.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the radius is negative.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.drawCircle(2, 2, 2, 255);
+      * @endcode
+      */
+    int drawCircle(int16_t x, int16_t y, int16_t radius, uint8_t value, bool fill = false);
+
+    /**
+      * Replaces the area of identical pixels connected horizontally or vertically to the given point with a new value.
+      *
+      * Each row of the area is found and filled as a single run, and only one point per run on the
+      * neighbouring rows is remembered, so the working memory needed is small.
+      *
+      * @param x The x co-ordinate of the point to fill from.
+      *
+      * @param y The y co-ordinate of the point to fill from.
+      *
+      * @param value The brightness level 0-255 to fill with.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the point lies outside the image,
+      *         or MICROBIT_NO_RESOURCES if there is insufficient memory to complete the fill.
+      *
+      * @code
+      * MicroBitImage i(5,5);
+      * i.drawCircle(2, 2, 2, 255);
+      * i.floodFill(2, 2, 128); // fill the inside of the circle
+      * @endcode
+      */
+    int floodFill(int16_t x, int16_t y, uint8_t value);
+
     /**
       * Shifts the pixels in this Image a given number of pixels to the left.
       *
@@ -419,7 +673,7 @@ class MicroBitImage
     }
 
     /**
-      * Gets number of bytes in the bitmap, ie., width * height.
+      * Gets number of bytes in the bitmap, ie., stride * height (width * height for one byte per pixel).
       *
       * @return The size of the bitmap.
       *
@@ -431,9 +685,49 @@ class MicroBitImage
       */
     int getSize() const
     {
-        return ptr->width * ptr->height;
+        return getStride() * ptr->height;
+    }
+
+    /**
+      * Gets the pixel format this image is stored in.
+      *
+      * @return The format of this image.
+      */
+    ImageFormat getFormat() const
+    {
+        return (ImageFormat) ptr->format;
     }
 
+    /**
+      * Gets the number of bytes used to store each row of the bitmap.
+      *
+      * @return The stride of the bitmap.
+      */
+    int getStride() const
+    {
+        if (ptr->format == MICROBIT_IMAGE_FORMAT_1BPP)
+            return (ptr->width + 7) >> 3;
+
+        if (ptr->format == MICROBIT_IMAGE_FORMAT_4BPP)
+            return (ptr->width + 1) >> 1;
+
+        return ptr->width;
+    }
+
+    /**
+      * Creates a copy of this image, stored in the given pixel format.
+      *
+      * @param format The pixel format to convert to.
+      *
+      * @return the converted image, or this image if it is already in the requested format.
+      *
+      * @code
+      * MicroBitImage i("0,255,0\n255,0,255\n");
+      * MicroBitImage packed = i.convert(MICROBIT_IMAGE_FORMAT_1BPP);
+      * @endcode
+      */
+    MicroBitImage convert(ImageFormat format);
+
     /**
       * Converts the bitmap to a csv ManagedString.
       *
@@ -469,6 +763,22 @@ class MicroBitImage
       */
     bool isReadOnly();
 
+    /**
+      * Ensures this image holds the only reference to its bitmap, and that the bitmap is in RAM,
+      * by taking a private copy if necessary.
+      *
+      * Images are copy on write, so every method that modifies an image does this automatically.
+      * It only needs to be called directly before writing through getBitmap().
+      *
+      * @code
+      * MicroBitImage i("0,1,0\n1,0,1\n");
+      * MicroBitImage i2(i);    // i and i2 share the same bitmap
+      * i2.detach();            // i2 now has a copy of its own
+      * i2.getBitmap()[0] = 255;
+      * @endcode
+      */
+    void detach();
+
     /**
       * Create a copy of the image bitmap. Used particularly, when isReadOnly() is true.
       *
@@ -0,0 +1,180 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_SPRITE_H
+#define MICROBIT_SPRITE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitImage.h"
+
+/**
+  * Status flags used by MicroBitSprite.
+  */
+#define MICROBIT_SPRITE_VISIBLE                 0x01
+#define MICROBIT_SPRITE_TRANSPARENT             0x02
+#define MICROBIT_SPRITE_CHANGED                 0x04
+
+class MicroBitDisplay;
+
+/**
+  * Class definition for a MicroBitSprite.
+  *
+  * A sprite is an image layer composited onto the display at a given position. Sprites are drawn
+  * over the display's own image in order of depth (lowest first), and the display recomposes its
+  * frame only when a sprite or the underlying image has changed.
+  *
+  * Sprites are owned by the application, and added to the display with MicroBitDisplay::addSprite().
+  * A sprite must be removed from the display before it is destroyed.
+  */
+class MicroBitSprite
+{
+    friend class MicroBitDisplay;
+
+    MicroBitImage image;                    // The image drawn by this sprite.
+    int16_t x;                              // The position of the top left of the sprite on the display.
+    int16_t y;
+    int16_t z;                              // The depth of the sprite. Higher values are drawn on top.
+    volatile uint8_t flags;                 // A combination of MICROBIT_SPRITE_* flags.
+    MicroBitSprite *next;                   // The next sprite on the display, in order of depth.
+
+    /**
+      * Draws this sprite into a byte per pixel buffer the size of the display.
+      *
+      * @param buffer The buffer to draw into.
+      *
+      * @param width The width of the buffer.
+      *
+      * @param height The height of the buffer.
+      */
+    void render(uint8_t *buffer, int width, int height);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates a visible sprite, with pixels of value zero treated as transparent.
+      *
+      * @param image The image to draw.
+      *
+      * @param x The horizontal position of the sprite on the display. Defaults to 0.
+      *
+      * @param y The vertical position of the sprite on the display. Defaults to 0.
+      *
+      * @param z The depth of the sprite. Higher values are drawn on top. Defaults to 0.
+      *
+      * @code
+      * MicroBitSprite ship(MicroBitImage("0,255,0\n255,255,255\n"), 1, 3);
+      * uBit.display.addSprite(ship);
+      * @endcode
+      */
+    MicroBitSprite(MicroBitImage image, int x = 0, int y = 0, int z = 0);
+
+    /**
+      * Changes the image drawn by this sprite.
+      *
+      * @param image The new image.
+      */
+    void setImage(MicroBitImage image);
+
+    /**
+      * Retrieves the image drawn by this sprite.
+      */
+    MicroBitImage getImage();
+
+    /**
+      * Moves the sprite to the given position on the display.
+      *
+      * @param x The new horizontal position.
+      *
+      * @param y The new vertical position.
+      */
+    void moveTo(int x, int y);
+
+    /**
+      * Moves the sprite relative to its current position.
+      *
+      * @param dx The number of pixels to move to the right (or left, if negative).
+      *
+      * @param dy The number of pixels to move down (or up, if negative).
+      */
+    void moveBy(int dx, int dy);
+
+    /**
+      * Changes the depth of this sprite. Higher values are drawn on top.
+      *
+      * @param z The new depth.
+      */
+    void setDepth(int z);
+
+    /**
+      * Shows or hides this sprite.
+      *
+      * @param visible true to show the sprite, false to hide it.
+      */
+    void setVisible(bool visible);
+
+    /**
+      * Determines if pixels of value zero in the image are transparent, or drawn as black.
+      *
+      * @param transparent true to treat zero pixels as transparent, false to draw them.
+      */
+    void setTransparent(bool transparent);
+
+    /**
+      * Retrieves the horizontal position of the sprite.
+      */
+    int getX()
+    {
+        return x;
+    }
+
+    /**
+      * Retrieves the vertical position of the sprite.
+      */
+    int getY()
+    {
+        return y;
+    }
+
+    /**
+      * Retrieves the depth of the sprite.
+      */
+    int getDepth()
+    {
+        return z;
+    }
+
+    /**
+      * Determines if the sprite is visible.
+      */
+    bool isVisible()
+    {
+        return (flags & MICROBIT_SPRITE_VISIBLE) != 0;
+    }
+};
+
+#endif
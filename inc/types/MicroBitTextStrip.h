@@ -0,0 +1,118 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_TEXT_STRIP_H
+#define MICROBIT_TEXT_STRIP_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "ManagedString.h"
+#include "MicroBitFont.h"
+
+// The default number of blank columns between characters.
+#define MICROBIT_TEXT_STRIP_SPACING             1
+
+// The width of a space (or any character without lit pixels) when text is laid out proportionally.
+#define MICROBIT_TEXT_STRIP_SPACE_WIDTH         2
+
+/**
+  * Class definition for a MicroBitTextStrip.
+  *
+  * A MicroBitTextStrip is a line of text rendered once, using the system font, into a packed strip
+  * of one byte per column. Text can then be scrolled by simply walking along the strip, rather than
+  * decoding each character from the font as it comes into view, and without needing a byte per pixel
+  * image as wide as the text.
+  */
+class MicroBitTextStrip
+{
+    uint8_t *columns;                       // One byte per column. Bit n is set if the pixel in row n is lit.
+    uint16_t length;                        // The number of columns in the strip.
+
+    // Strips own their buffer, so aren't copied.
+    MicroBitTextStrip(const MicroBitTextStrip &);
+    MicroBitTextStrip& operator=(const MicroBitTextStrip &);
+
+    public:
+
+    /**
+      * Constructor.
+      * Creates an empty strip.
+      */
+    MicroBitTextStrip();
+
+    /**
+      * Renders the given text into this strip, replacing any previous content.
+      *
+      * @param s The text to render, which may be encoded as UTF-8.
+      *
+      * @param proportional If true, empty columns either side of each character are removed, and the font's
+      *                     kerning is applied. Defaults to false.
+      *
+      * @param spacing The number of blank columns placed after each character. Defaults to MICROBIT_TEXT_STRIP_SPACING.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the spacing is negative or the text too long,
+      *         or MICROBIT_NO_RESOURCES if the strip could not be allocated.
+      *
+      * @code
+      * MicroBitTextStrip strip;
+      * strip.layout("Hello", true);
+      * @endcode
+      */
+    int layout(ManagedString s, bool proportional = false, int spacing = MICROBIT_TEXT_STRIP_SPACING);
+
+    /**
+      * Releases the memory held by this strip, leaving it empty.
+      */
+    void clear();
+
+    /**
+      * Determines the number of columns in this strip.
+      *
+      * @return the length of the strip in columns.
+      */
+    int getLength() const
+    {
+        return length;
+    }
+
+    /**
+      * Retrieves a single column of the strip.
+      *
+      * @param x The column to read. Columns outside of the strip are blank.
+      *
+      * @return the column, with bit n set if the pixel in row n is lit.
+      */
+    uint8_t getColumn(int x) const
+    {
+        return (x >= 0 && x < length) ? columns[x] : 0;
+    }
+
+    /**
+      * Destructor.
+      */
+    ~MicroBitTextStrip();
+};
+
+#endif
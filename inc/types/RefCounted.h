@@ -32,7 +32,7 @@ DEALINGS IN THE SOFTWARE.
 
 /**
   * Base class for payload for ref-counted objects. Used by ManagedString and MicroBitImage.
-  * There is no constructor, as this struct is typically malloc()ed.
+  * There is no constructor, as this struct is typically malloc()ed (see microbit_arena_malloc()).
   */
 struct RefCounted
 {
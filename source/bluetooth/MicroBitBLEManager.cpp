@@ -783,30 +783,25 @@ void MicroBitBLEManager::showManagementModeAnimation(MicroBitDisplay &display)
     // Animation for display object
     // https://makecode.microbit.org/93264-81126-90471-58367
 
-    const uint8_t mgmt_animation[] __attribute__ ((aligned (4))) =
-    {
-         0xff, 0xff, 20, 0, 5, 0,
+    MICROBIT_IMAGE_LITERAL(mgmt, 20, 5,
          255,255,255,255,255,   255,255,255,255,255,   255,255,  0,255,255,   255,  0,  0,  0,255,
          255,255,255,255,255,   255,255,  0,255,255,   255,  0,  0,  0,255,     0,  0,  0,  0,  0,
          255,255,  0,255,255,   255,  0,  0,  0,255,     0,  0,  0,  0,  0,     0,  0,  0,  0,  0,
          255,255,255,255,255,   255,255,  0,255,255,   255,  0,  0,  0,255,     0,  0,  0,  0,  0,
          255,255,255,255,255,   255,255,255,255,255,   255,255,  0,255,255,   255,  0,  0,  0,255
-    };
+    );
 
-    MicroBitImage mgmt((ImageData*)mgmt_animation);
-    display.animate(mgmt,100,5);
+    display.animate(MICROBIT_IMAGE(mgmt),100,5);
 
-    const uint8_t bt_icon_raw[] =
-    {
+    MICROBIT_IMAGE_LITERAL(bt_icon, 5, 5,
           0,  0,255,255,  0,
         255,  0,255,  0,255,
           0,255,255,255,  0,
         255,  0,255,  0,255,
           0,  0,255,255,  0
-    };
+    );
 
-    MicroBitImage bt_icon(5,5,bt_icon_raw);
-    display.print(bt_icon,0,0,0,0);
+    display.print(MICROBIT_IMAGE(bt_icon),0,0,0,0);
 
     for(int i=0; i < 255; i = i + 5){
         display.setBrightness(i);
@@ -122,15 +122,18 @@ void MicroBitLEDService::onDataRead(GattReadAuthCallbackParams *params)
 {
     if (params->handle == matrixCharacteristicHandle)
     {
+        // The display keeps a packed copy of its frame, with the leftmost pixel of each row in bit 0.
+        // The characteristic holds the leftmost pixel in bit 4, so each row only needs its bits reversing.
+        uint8_t frame[MICROBIT_DISPLAY_HEIGHT * ((MICROBIT_DISPLAY_WIDTH + 7) >> 3)];
+        int stride = (MICROBIT_DISPLAY_WIDTH + 7) >> 3;
+
+        if (display.getSnapshot(frame, sizeof(frame)) < 0)
+            memset(frame, 0, sizeof(frame));
+
         for (int y=0; y<5; y++)
         {
-            matrixCharacteristicBuffer[y] = 0;
-
-            for (int x=0; x<5; x++)
-            {
-                if (display.image.getPixelValue(x, y))
-                    matrixCharacteristicBuffer[y] |= 0x01 << (4-x);
-            }
+            uint8_t v = frame[y * stride];
+            matrixCharacteristicBuffer[y] = ((v & 0x01) << 4) | ((v & 0x02) << 2) | (v & 0x04) | ((v & 0x08) >> 2) | ((v & 0x10) >> 4);
         }
 
         ble.gattServer().write(matrixCharacteristicHandle, (const uint8_t *)&matrixCharacteristicBuffer, sizeof(matrixCharacteristicBuffer));
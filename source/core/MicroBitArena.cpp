@@ -0,0 +1,265 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simple bump pointer arena allocator, used to reduce heap churn caused by short lived
+  * ManagedString, MicroBitImage and PacketBuffer instances.
+  *
+  * An arena is a single block of memory allocated from the heap. Once activated (typically for
+  * the duration of an event handler), any reference counted data created by the calling fiber is
+  * carved out of the arena by simply advancing a pointer. Individual releases are very cheap, and
+  * once the last object held in the arena is released, the whole arena is reset in one step.
+  *
+  * If an arena runs out of space, allocations silently fall back to the general heap.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitArena.h"
+#include "MicroBitFiber.h"
+#include "MicroBitDevice.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+// List of all arenas in existence. Used to determine which arena (if any) a block of memory belongs to.
+static MicroBitArena *arenas = NULL;
+
+// The arena in use before the fiber scheduler is initialised.
+static MicroBitArena *defaultArena = NULL;
+
+/**
+  * Constructor.
+  *
+  * Create a new arena, and allocate its storage from the heap.
+  *
+  * @param size The amount of memory to reserve for the arena, in bytes. Defaults to MICROBIT_ARENA_DEFAULT_SIZE.
+  *
+  * @code
+  * MicroBitArena arena(256);
+  * @endcode
+  */
+MicroBitArena::MicroBitArena(int size)
+{
+    // Round up to a whole number of words, and ensure we can index the whole arena.
+    size = min(max(size, 0), 0xFFFC);
+    size = (size + 3) & ~3;
+
+    this->buffer = (uint8_t *) malloc(size);
+    this->size = this->buffer ? size : 0;
+    this->offset = 0;
+    this->live = 0;
+
+    __disable_irq();
+    this->next = arenas;
+    arenas = this;
+    __enable_irq();
+}
+
+/**
+  * Destructor.
+  *
+  * Releases the storage held by this arena.
+  *
+  * @note It is an error to destroy an arena that still holds live allocations.
+  */
+MicroBitArena::~MicroBitArena()
+{
+    if (live)
+        microbit_panic(MICROBIT_HEAP_ERROR);
+
+    __disable_irq();
+
+    MicroBitArena **p = &arenas;
+    while (*p != NULL && *p != this)
+        p = &(*p)->next;
+
+    if (*p == this)
+        *p = next;
+
+    if (defaultArena == this)
+        defaultArena = NULL;
+
+    __enable_irq();
+
+    if (buffer)
+        free(buffer);
+}
+
+/**
+  * Attempt to allocate a given amount of memory from this arena.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A word aligned pointer to the allocated memory, or NULL if the arena has insufficient space.
+  */
+void *MicroBitArena::alloc(size_t size)
+{
+    void *p = NULL;
+
+    // Keep all allocations word aligned.
+    size = (size + 3) & ~3;
+
+    __disable_irq();
+
+    if (size > 0 && size <= (size_t)(this->size - offset))
+    {
+        p = buffer + offset;
+        offset += size;
+        live++;
+    }
+
+    __enable_irq();
+
+    return p;
+}
+
+/**
+  * Release a block of memory previously allocated from this arena.
+  *
+  * When the last outstanding allocation is released, the whole arena is made available for reuse.
+  *
+  * @param mem The memory to release.
+  */
+void MicroBitArena::release(void *mem)
+{
+    if (!contains(mem) || live == 0)
+        microbit_panic(MICROBIT_HEAP_ERROR);
+
+    __disable_irq();
+
+    if (--live == 0)
+        offset = 0;
+
+    __enable_irq();
+}
+
+/**
+  * Determines if the given memory was allocated from this arena.
+  *
+  * @param mem The memory to test.
+  *
+  * @return true if mem lies within this arena, false otherwise.
+  */
+bool MicroBitArena::contains(void *mem)
+{
+    return (uint8_t *)mem >= buffer && (uint8_t *)mem < buffer + size;
+}
+
+/**
+  * Determines the amount of space remaining in this arena.
+  *
+  * @return The number of bytes available for allocation.
+  */
+int MicroBitArena::getFree()
+{
+    return size - offset;
+}
+
+/**
+  * Determines the number of allocations from this arena that are still in use.
+  *
+  * @return The number of outstanding allocations.
+  */
+int MicroBitArena::getLive()
+{
+    return live;
+}
+
+/**
+  * Activates the given arena for the calling fiber. All subsequent reference counted
+  * allocations made by the fiber will be attempted from the arena first.
+  *
+  * @param arena The arena to activate, or NULL to revert to the general heap.
+  *
+  * @return The arena that was previously active, or NULL if there was none.
+  */
+MicroBitArena *microbit_arena_activate(MicroBitArena *arena)
+{
+    MicroBitArena *previous;
+
+    if (currentFiber)
+    {
+        previous = currentFiber->arena;
+        currentFiber->arena = arena;
+    }
+    else
+    {
+        previous = defaultArena;
+        defaultArena = arena;
+    }
+
+    return previous;
+}
+
+/**
+  * Determines the arena currently active for the calling fiber.
+  *
+  * @return The active arena, or NULL if allocations are being made from the general heap.
+  */
+MicroBitArena *microbit_arena_current()
+{
+    return currentFiber ? currentFiber->arena : defaultArena;
+}
+
+/**
+  * Attempt to allocate a given amount of memory from the active arena, falling
+  * back to the general heap if no arena is active or the active arena is full.
+  *
+  * Allocations made in interrupt context are always made from the general heap.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+void *microbit_arena_malloc(size_t size)
+{
+    MicroBitArena *arena = microbit_arena_current();
+    void *p = NULL;
+
+    if (arena && !inInterruptContext())
+        p = arena->alloc(size);
+
+    if (p == NULL)
+        p = malloc(size);
+
+    return p;
+}
+
+/**
+  * Release memory allocated by microbit_arena_malloc().
+  *
+  * @param mem The memory to release. This may have been allocated either from an arena or the general heap.
+  */
+void microbit_arena_free(void *mem)
+{
+    for (MicroBitArena *a = arenas; a != NULL; a = a->next)
+    {
+        if (a->contains(mem))
+        {
+            a->release(mem);
+            return;
+        }
+    }
+
+    free(mem);
+}
@@ -34,6 +34,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitFiber.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitHeapAllocator.h"
 
 /*
  * Statically allocated values used to create and destroy Fibers.
@@ -169,6 +170,7 @@ Fiber *getFiberContext()
 
     // Ensure this fiber is in suitable state for reuse.
     f->flags = 0;
+    f->arena = NULL;
     f->tcb.stack_base = CORTEX_M0_STACK_BASE;
 
     return f;
@@ -240,13 +242,14 @@ void scheduler_tick()
 {
     Fiber *f = sleepQueue;
     Fiber *t;
+    uint64_t now = system_timer_current_time();
 
     // Check the sleep queue, and wake up any fibers as necessary.
     while (f != NULL)
     {
         t = f->next;
 
-        if (system_timer_current_time() >= f->context)
+        if (now >= f->context)
         {
             // Wakey wakey!
             dequeue_fiber(f);
@@ -483,6 +486,9 @@ int invoke(void (*entry_fn)(void))
         return MICROBIT_OK;
     }
 
+    // Remember which arena was active, as the user code may change it before it blocks.
+    MicroBitArena *arena = currentFiber->arena;
+
     // Snapshot current context, but also update the Link Register to
     // refer to our calling function.
     save_register_context(&currentFiber->tcb);
@@ -492,10 +498,12 @@ int invoke(void (*entry_fn)(void))
     // 2) We've already tried to execute the code, it blocked, and we've backtracked.
 
     // If we're returning from the user function and we forked another fiber then cleanup and exit.
+    // The forked fiber has taken any arena the user code activated with it, so restore our own.
     if (currentFiber->flags & MICROBIT_FIBER_FLAG_PARENT)
     {
         currentFiber->flags &= ~MICROBIT_FIBER_FLAG_FOB;
         currentFiber->flags &= ~MICROBIT_FIBER_FLAG_PARENT;
+        currentFiber->arena = arena;
         return MICROBIT_OK;
     }
 
@@ -546,6 +554,9 @@ int invoke(void (*entry_fn)(void *), void *param)
         return MICROBIT_OK;
     }
 
+    // Remember which arena was active, as the user code may change it before it blocks.
+    MicroBitArena *arena = currentFiber->arena;
+
     // Snapshot current context, but also update the Link Register to
     // refer to our calling function.
     save_register_context(&currentFiber->tcb);
@@ -555,10 +566,12 @@ int invoke(void (*entry_fn)(void *), void *param)
     // 2) We've already tried to execute the code, it blocked, and we've backtracked.
 
     // If we're returning from the user function and we forked another fiber then cleanup and exit.
+    // The forked fiber has taken any arena the user code activated with it, so restore our own.
     if (currentFiber->flags & MICROBIT_FIBER_FLAG_PARENT)
     {
         currentFiber->flags &= ~MICROBIT_FIBER_FLAG_FOB;
         currentFiber->flags &= ~MICROBIT_FIBER_FLAG_PARENT;
+        currentFiber->arena = arena;
         return MICROBIT_OK;
     }
 
@@ -790,6 +803,9 @@ void schedule()
         currentFiber->flags |= MICROBIT_FIBER_FLAG_PARENT;
         forkedFiber->flags |= MICROBIT_FIBER_FLAG_CHILD;
 
+        // The forked fiber continues the user code, so it continues to allocate from the same arena.
+        forkedFiber->arena = currentFiber->arena;
+
         // Define the stack base of the forked fiber to be align with the entry point of the parent fiber
         forkedFiber->tcb.stack_base = currentFiber->tcb.SP;
 
@@ -924,8 +940,9 @@ void idle()
         if(idleThreadComponents[i] != NULL)
             idleThreadComponents[i]->idleTick();
 
-    // If the above did create any useful work, enter power efficient sleep.
-    if(scheduler_runqueue_empty())
+    // If the above didn't create any useful work, use the time to incrementally defragment the heap.
+    // Once there's nothing left to move, enter power efficient sleep.
+    if(scheduler_runqueue_empty() && microbit_heap_compact() == 0)
     	__WFE();
 }
 
@@ -27,8 +27,8 @@ DEALINGS IN THE SOFTWARE.
   * Class definition for a MicrobitFont
   * This class represents a font that can be used by the display to render text.
   *
-  * A MicroBitFont is 5x5.
-  * Each Row is represented by a byte in the array.
+  * A MicroBitFont is either a MicroBitFontDefinition, or a legacy table of 5x5 ASCII characters.
+  * In a legacy table, each Row is represented by a byte in the array.
   *
   * Row Format:
   *            ================================================================
@@ -40,12 +40,12 @@ DEALINGS IN THE SOFTWARE.
   * Example: { 0x08, 0x08, 0x08, 0x0, 0x08 }
   *
   * The above will produce an exclamation mark on the second column from the left.
-  *
-  * We could compress further, but the complexity of decode would likely outweigh the gains.
   */
 
 #include "MicroBitConfig.h"
 #include "MicroBitFont.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
 
 const unsigned char pendolino3[475] = {
 0x0, 0x0, 0x0, 0x0, 0x0, 0x8, 0x8, 0x8, 0x0, 0x8, 0xa, 0x4a, 0x40, 0x0, 0x0, 0xa, 0x5f, 0xea, 0x5f, 0xea, 0xe, 0xd9, 0x2e, 0xd3, 0x6e, 0x19, 0x32, 0x44, 0x89, 0x33, 0xc, 0x92, 0x4c, 0x92, 0x4d, 0x8, 0x8, 0x0, 0x0, 0x0, 0x4, 0x88, 0x8, 0x8, 0x4, 0x8, 0x4, 0x84, 0x84, 0x88, 0x0, 0xa, 0x44, 0x8a, 0x40, 0x0, 0x4, 0x8e, 0xc4, 0x80, 0x0, 0x0, 0x0, 0x4, 0x88, 0x0, 0x0, 0xe, 0xc0, 0x0, 0x0, 0x0, 0x0, 0x8, 0x0, 0x1, 0x22, 0x44, 0x88, 0x10, 0xc, 0x92, 0x52, 0x52, 0x4c, 0x4, 0x8c, 0x84, 0x84, 0x8e, 0x1c, 0x82, 0x4c, 0x90, 0x1e, 0x1e, 0xc2, 0x44, 0x92, 0x4c, 0x6, 0xca, 0x52, 0x5f, 0xe2, 0x1f, 0xf0, 0x1e, 0xc1, 0x3e, 0x2, 0x44, 0x8e, 0xd1, 0x2e, 0x1f, 0xe2, 0x44, 0x88, 0x10, 0xe, 0xd1, 0x2e, 0xd1, 0x2e, 0xe, 0xd1, 0x2e, 0xc4, 0x88, 0x0, 0x8, 0x0, 0x8, 0x0, 0x0, 0x4, 0x80, 0x4, 0x88, 0x2, 0x44, 0x88, 0x4, 0x82, 0x0, 0xe, 0xc0, 0xe, 0xc0, 0x8, 0x4, 0x82, 0x44, 0x88, 0xe, 0xd1, 0x26, 0xc0, 0x4, 0xe, 0xd1, 0x35, 0xb3, 0x6c, 0xc, 0x92, 0x5e, 0xd2, 0x52, 0x1c, 0x92, 0x5c, 0x92, 0x5c, 0xe, 0xd0, 0x10, 0x10, 0xe, 0x1c, 0x92, 0x52, 0x52, 0x5c, 0x1e, 0xd0, 0x1c, 0x90, 0x1e, 0x1e, 0xd0, 0x1c, 0x90, 0x10, 0xe, 0xd0, 0x13, 0x71, 0x2e, 0x12, 0x52, 0x5e, 0xd2, 0x52, 0x1c, 0x88, 0x8, 0x8, 0x1c, 0x1f, 0xe2, 0x42, 0x52, 0x4c, 0x12, 0x54, 0x98, 0x14, 0x92, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x11, 0x3b, 0x75, 0xb1, 0x31, 0x11, 0x39, 0x35, 0xb3, 0x71, 0xc, 0x92, 0x52, 0x52, 0x4c, 0x1c, 0x92, 0x5c, 0x90, 0x10, 0xc, 0x92, 0x52, 0x4c, 0x86, 0x1c, 0x92, 0x5c, 0x92, 0x51, 0xe, 0xd0, 0xc, 0x82, 0x5c, 0x1f, 0xe4, 0x84, 0x84, 0x84, 0x12, 0x52, 0x52, 0x52, 0x4c, 0x11, 0x31, 0x31, 0x2a, 0x44, 0x11, 0x31, 0x35, 0xbb, 0x71, 0x12, 0x52, 0x4c, 0x92, 0x52, 0x11, 0x2a, 0x44, 0x84, 0x84, 0x1e, 0xc4, 0x88, 0x10, 0x1e, 0xe, 0xc8, 0x8, 0x8, 0xe, 0x10, 0x8, 0x4, 0x82, 0x41, 0xe, 0xc2, 0x42, 0x42, 0x4e, 0x4, 0x8a, 0x40, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x1f, 0x8, 0x4, 0x80, 0x0, 0x0, 0x0, 0xe, 0xd2, 0x52, 0x4f, 0x10, 0x10, 0x1c, 0x92, 0x5c, 0x0, 0xe, 0xd0, 0x10, 0xe, 0x2, 0x42, 0x4e, 0xd2, 0x4e, 0xc, 0x92, 0x5c, 0x90, 0xe, 0x6, 0xc8, 0x1c, 0x88, 0x8, 0xe, 0xd2, 0x4e, 0xc2, 0x4c, 0x10, 0x10, 0x1c, 0x92, 0x52, 0x8, 0x0, 0x8, 0x8, 0x8, 0x2, 0x40, 0x2, 0x42, 0x4c, 0x10, 0x14, 0x98, 0x14, 0x92, 0x8, 0x8, 0x8, 0x8, 0x6, 0x0, 0x1b, 0x75, 0xb1, 0x31, 0x0, 0x1c, 0x92, 0x52, 0x52, 0x0, 0xc, 0x92, 0x52, 0x4c, 0x0, 0x1c, 0x92, 0x5c, 0x90, 0x0, 0xe, 0xd2, 0x4e, 0xc2, 0x0, 0xe, 0xd0, 0x10, 0x10, 0x0, 0x6, 0xc8, 0x4, 0x98, 0x8, 0x8, 0xe, 0xc8, 0x7, 0x0, 0x12, 0x52, 0x52, 0x4f, 0x0, 0x11, 0x31, 0x2a, 0x44, 0x0, 0x11, 0x31, 0x35, 0xbb, 0x0, 0x12, 0x4c, 0x8c, 0x92, 0x0, 0x11, 0x2a, 0x44, 0x98, 0x0, 0x1e, 0xc4, 0x88, 0x1e, 0x6, 0xc4, 0x8c, 0x84, 0x86, 0x8, 0x8, 0x8, 0x8, 0x8, 0x18, 0x8, 0xc, 0x88, 0x18, 0x0, 0x0, 0xc, 0x83, 0x60};
@@ -54,6 +54,10 @@ const unsigned char pendolino3[475] = {
 const unsigned char* MicroBitFont::defaultFont = pendolino3;
 MicroBitFont MicroBitFont::systemFont = MicroBitFont(defaultFont, MICROBIT_FONT_ASCII_END);
 
+#if MICROBIT_FONT_GLYPH_CACHE_SIZE > 0
+static MicroBitGlyph glyphCache[MICROBIT_FONT_GLYPH_CACHE_SIZE];
+#endif
+
 /**
   * Constructor.
   *
@@ -67,6 +71,22 @@ MicroBitFont::MicroBitFont(const unsigned char* characters, int asciiEnd)
 {
     this->characters = characters;
     this->asciiEnd = asciiEnd;
+    this->definition = NULL;
+}
+
+/**
+  * Constructor.
+  *
+  * Sets the font represented by this font object to one held in a MicroBitFontDefinition.
+  *
+  * @param definition The definition of the font, typically held in flash. It must remain valid
+  *                   for as long as the font is in use.
+  */
+MicroBitFont::MicroBitFont(const MicroBitFontDefinition *definition)
+{
+    this->characters = NULL;
+    this->asciiEnd = 0;
+    this->definition = definition;
 }
 
 /**
@@ -78,6 +98,7 @@ MicroBitFont::MicroBitFont()
 {
     this->characters = defaultFont;
     this->asciiEnd = MICROBIT_FONT_ASCII_END;
+    this->definition = NULL;
 }
 
 /**
@@ -97,3 +118,324 @@ MicroBitFont MicroBitFont::getSystemFont()
 {
     return MicroBitFont::systemFont;
 }
+
+/**
+  * Decodes the glyph for the given character code directly from the font, without the glyph cache.
+  *
+  * @return The width of the glyph in columns, or MICROBIT_INVALID_PARAMETER if the character is not in this font.
+  */
+int MicroBitFont::decode(uint16_t c, uint8_t *columns)
+{
+    if (definition == NULL)
+    {
+        if (c < MICROBIT_FONT_ASCII_START || c > asciiEnd)
+            return MICROBIT_INVALID_PARAMETER;
+
+        const unsigned char *row = characters + (c - MICROBIT_FONT_ASCII_START) * MICROBIT_FONT_HEIGHT;
+
+        memset(columns, 0, MICROBIT_FONT_WIDTH);
+
+        for (int y = 0; y < MICROBIT_FONT_HEIGHT; y++)
+        {
+            unsigned char v = *row++;
+
+            for (int col = 0; col < MICROBIT_FONT_WIDTH; col++)
+                if (v & (0x10 >> col))
+                    columns[col] |= (1 << y);
+        }
+
+        return MICROBIT_FONT_WIDTH;
+    }
+
+    // Binary search for the range holding the character.
+    int low = 0;
+    int high = definition->rangeCount - 1;
+    const MicroBitFontRange *range = NULL;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        const MicroBitFontRange *r = &definition->ranges[mid];
+
+        if (c < r->first)
+            high = mid - 1;
+        else if (c >= r->first + r->count)
+            low = mid + 1;
+        else
+        {
+            range = r;
+            break;
+        }
+    }
+
+    if (range == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint16_t offset = definition->index[range->index + (c - range->first)];
+
+    if (offset == MICROBIT_FONT_NO_GLYPH)
+        return MICROBIT_INVALID_PARAMETER;
+
+    const uint8_t *glyph = definition->glyphs + offset;
+    int width = min(glyph[0] & 0x0f, MICROBIT_FONT_MAX_WIDTH);
+    int height = definition->height;
+    uint8_t mask = (1 << height) - 1;
+    int bit = 0;
+
+    glyph++;
+
+    // Unpack height bits per column from the stream.
+    for (int col = 0; col < width; col++)
+    {
+        const uint8_t *p = glyph + (bit >> 3);
+        uint16_t v = p[0];
+
+        if ((bit & 7) + height > 8)
+            v |= p[1] << 8;
+
+        columns[col] = (v >> (bit & 7)) & mask;
+        bit += height;
+    }
+
+    return width;
+}
+
+/**
+  * Decodes the glyph for the given character code into columns, using the glyph cache where possible.
+  *
+  * @param c The character code to decode, such as one returned by nextCharacter().
+  *
+  * @param columns A buffer of at least MICROBIT_FONT_MAX_WIDTH bytes to receive the glyph. Each byte holds
+  *                one column, with bit n set if the pixel in row n is lit.
+  *
+  * @return The width of the glyph in columns, or MICROBIT_INVALID_PARAMETER if the character is not in this font.
+  */
+int MicroBitFont::getColumns(uint16_t c, uint8_t *columns)
+{
+    if (columns == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+#if MICROBIT_FONT_GLYPH_CACHE_SIZE > 0
+    const void *font = definition ? (const void *)definition : (const void *)characters;
+    MicroBitGlyph *g = &glyphCache[c % MICROBIT_FONT_GLYPH_CACHE_SIZE];
+    int width;
+
+    // The cache is shared with text rendered from interrupt context, so keep lookup and fill atomic.
+    __disable_irq();
+
+    if (g->font != font || g->c != c)
+    {
+        width = decode(c, g->columns);
+
+        if (width < 0)
+        {
+            __enable_irq();
+            return width;
+        }
+
+        g->font = font;
+        g->c = c;
+        g->width = width;
+    }
+
+    width = g->width;
+    memcpy(columns, g->columns, width);
+
+    __enable_irq();
+
+    return width;
+#else
+    return decode(c, columns);
+#endif
+}
+
+/**
+  * Decodes the glyph for the given character into columns, using the glyph cache where possible.
+  *
+  * @param c The character to decode.
+  *
+  * @param columns A buffer of at least MICROBIT_FONT_WIDTH bytes to receive the glyph. Each byte holds
+  *                one column, with bit n set if the pixel in row n is lit. Glyphs of other widths are
+  *                padded with blank columns, or truncated.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the character is not in this font.
+  */
+int MicroBitFont::getGlyph(char c, uint8_t *columns)
+{
+    uint8_t glyph[MICROBIT_FONT_MAX_WIDTH];
+
+    if (columns == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int width = getColumns((uint8_t)c, glyph);
+
+    if (width < 0)
+        return width;
+
+    for (int col = 0; col < MICROBIT_FONT_WIDTH; col++)
+        columns[col] = col < width ? glyph[col] : 0;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the adjustment to the space between two characters written next to each other.
+  *
+  * @param left The character code on the left.
+  *
+  * @param right The character code on the right.
+  *
+  * @return The number of columns to add to the space between them, which may be negative, or zero if
+  *         the font has no kerning for the pair.
+  */
+int MicroBitFont::getKerning(uint16_t left, uint16_t right)
+{
+    if (definition == NULL || definition->kerning == NULL)
+        return 0;
+
+    uint32_t key = ((uint32_t)left << 16) | right;
+    int low = 0;
+    int high = definition->kerningCount - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        const MicroBitFontKerning *k = &definition->kerning[mid];
+        uint32_t pair = ((uint32_t)k->left << 16) | k->right;
+
+        if (key < pair)
+            high = mid - 1;
+        else if (key > pair)
+            low = mid + 1;
+        else
+            return k->adjust;
+    }
+
+    return 0;
+}
+
+/**
+  * Gets the number of rows in the glyphs of this font.
+  */
+int MicroBitFont::getHeight()
+{
+    return definition ? definition->height : MICROBIT_FONT_HEIGHT;
+}
+
+/**
+  * Gets the width of the widest glyph in this font.
+  */
+int MicroBitFont::getWidth()
+{
+    return definition ? min(definition->width, MICROBIT_FONT_MAX_WIDTH) : MICROBIT_FONT_WIDTH;
+}
+
+/**
+  * Decodes the next character of a UTF-8 string.
+  *
+  * Bytes that don't form part of a valid sequence, or sequences for characters beyond 0xffff, are
+  * returned one at a time as they are, so text in a single byte encoding such as Latin-1 is still shown.
+  *
+  * @param s The string to decode.
+  *
+  * @param length The length of the string, in bytes.
+  *
+  * @param position The offset of the next byte to decode, which is advanced past the character.
+  *
+  * @return The character code, or 0 if position is at or beyond the end of the string.
+  *
+  * @code
+  * int i = 0;
+  * while (i < s.length())
+  *     font.getColumns(MicroBitFont::nextCharacter(s.toCharArray(), s.length(), i), columns);
+  * @endcode
+  */
+uint16_t MicroBitFont::nextCharacter(const char *s, int length, int &position)
+{
+    if (s == NULL || position < 0 || position >= length)
+        return 0;
+
+    const uint8_t *p = (const uint8_t *)s + position;
+    uint8_t b = p[0];
+    int extra = 0;
+    uint16_t c = b;
+
+    if ((b & 0xe0) == 0xc0)
+    {
+        extra = 1;
+        c = b & 0x1f;
+    }
+    else if ((b & 0xf0) == 0xe0)
+    {
+        extra = 2;
+        c = b & 0x0f;
+    }
+
+    if (extra == 0 || position + extra >= length)
+    {
+        position++;
+        return b;
+    }
+
+    for (int i = 1; i <= extra; i++)
+    {
+        // Fall back to the single byte if the sequence is broken.
+        if ((p[i] & 0xc0) != 0x80)
+        {
+            position++;
+            return b;
+        }
+
+        c = (c << 6) | (p[i] & 0x3f);
+    }
+
+    // Reject overlong encodings, which would otherwise alias other characters.
+    if (c < (extra == 1 ? 0x80 : 0x800))
+    {
+        position++;
+        return b;
+    }
+
+    position += extra + 1;
+    return c;
+}
+
+/**
+  * Encodes a glyph into the format used by MicroBitFontDefinition.
+  *
+  * @param columns The columns of the glyph, with bit n of each set if the pixel in row n is lit.
+  *
+  * @param width The number of columns in the glyph, at most MICROBIT_FONT_MAX_WIDTH.
+  *
+  * @param height The number of rows in the font, at most MICROBIT_FONT_MAX_HEIGHT.
+  *
+  * @param buffer A buffer to receive the encoded glyph, of at least 1 + (width * height + 7) / 8 bytes.
+  *
+  * @return The number of bytes written, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitFont::encodeGlyph(const uint8_t *columns, int width, int height, uint8_t *buffer)
+{
+    if (columns == NULL || buffer == NULL || width < 0 || width > MICROBIT_FONT_MAX_WIDTH || height <= 0 || height > MICROBIT_FONT_MAX_HEIGHT)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int size = 1 + (width * height + 7) / 8;
+    int bit = 0;
+
+    memset(buffer, 0, size);
+    buffer[0] = width;
+
+    for (int col = 0; col < width; col++)
+    {
+        uint16_t v = (columns[col] & ((1 << height) - 1)) << (bit & 7);
+        uint8_t *p = buffer + 1 + (bit >> 3);
+
+        p[0] |= v;
+
+        if ((bit & 7) + height > 8)
+            p[1] |= v >> 8;
+
+        bit += height;
+    }
+
+    return size;
+}
@@ -61,6 +61,15 @@ HeapDefinition heap[MICROBIT_MAXIMUM_HEAPS] = { };
 uint8_t heap_count = 0;
 extern "C" int __end__;
 
+#if MICROBIT_HEAP_MAX_HANDLES > 0
+// A list of all relocatable blocks, which may be moved by microbit_heap_compact().
+static MicroBitHeapHandle heap_handles[MICROBIT_HEAP_MAX_HANDLES];
+
+// Incremented whenever microbit_malloc() rewrites block headers, so that a compaction pass
+// running with interrupts enabled can tell that the layout of the heap has changed beneath it.
+static volatile uint32_t heap_generation = 0;
+#endif
+
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
 // Diplays a usage summary about a given heap...
 void microbit_heap_print(HeapDefinition &heap)
@@ -79,7 +88,7 @@ void microbit_heap_print(HeapDefinition &heap)
 
     if(SERIAL_DEBUG) SERIAL_DEBUG->printf("heap_start : %p\n", heap.heap_start);
     if(SERIAL_DEBUG) SERIAL_DEBUG->printf("heap_end   : %p\n", heap.heap_end);
-    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("heap_size  : %d\n", (int)heap.heap_end - (int)heap.heap_start);
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("heap_size  : %d\n", (int)(heap.heap_end - heap.heap_start) * MICROBIT_HEAP_BLOCK_SIZE);
 
 	// Disable IRQ temporarily to ensure no race conditions!
     __disable_irq();
@@ -140,7 +149,7 @@ void microbit_heap_print()
   * code, and user code targetting the runtime. External code can choose to include this file, or
   * simply use the standard heap.
   */
-int microbit_create_heap(uint32_t start, uint32_t end)
+int microbit_create_heap(uintptr_t start, uintptr_t end)
 {
     HeapDefinition *h = &heap[heap_count];
 
@@ -160,7 +169,7 @@ int microbit_create_heap(uint32_t start, uint32_t end)
     h->heap_end = (uint32_t *)end;
 
     // Initialise the heap as being completely empty and available for use.
-    *h->heap_start = MICROBIT_HEAP_BLOCK_FREE | (((uint32_t) h->heap_end - (uint32_t) h->heap_start) / MICROBIT_HEAP_BLOCK_SIZE);
+    *h->heap_start = MICROBIT_HEAP_BLOCK_FREE | (uint32_t)(h->heap_end - h->heap_start);
     heap_count++;
 
 	// Enable Interrupts
@@ -214,11 +223,8 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		// We have a free block. Let's see if the subsequent ones are too. If so, we can merge...
 		next = block + blockSize;
 
-		while (*next & MICROBIT_HEAP_BLOCK_FREE)
+		while (next < heap.heap_end && *next & MICROBIT_HEAP_BLOCK_FREE)
 		{
-			if (next >= heap.heap_end)
-				break;
-
 			// We can merge!
 			blockSize += (*next & ~MICROBIT_HEAP_BLOCK_FREE);
 			*block = blockSize | MICROBIT_HEAP_BLOCK_FREE;
@@ -235,6 +241,11 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		block += blockSize;
 	}
 
+#if MICROBIT_HEAP_MAX_HANDLES > 0
+    // Free blocks may have been merged above, and are about to be split, so any compaction in progress must restart.
+    heap_generation++;
+#endif
+
 	// We're full!
 	if (block >= heap.heap_end)
     {
@@ -274,13 +285,13 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 void *malloc(size_t size)
 {
     static uint8_t initialised = 0;
-    void *p;
+    void *p = NULL;
 
     if (!initialised)
     {
-        heap_count = 0;
-
-        if(microbit_create_heap((uint32_t)(&__end__), (uint32_t)(MICROBIT_HEAP_END)) == MICROBIT_INVALID_PARAMETER)
+        // Unless a heap has already been created explicitly (as a host test harness does),
+        // use all the memory between the end of static data and the stack.
+        if(heap_count == 0 && microbit_create_heap((uintptr_t)(&__end__), (uintptr_t)(MICROBIT_HEAP_END)) == MICROBIT_INVALID_PARAMETER)
             microbit_panic(MICROBIT_HEAP_ERROR);
 
         initialised = 1;
@@ -338,11 +349,11 @@ void free(void *mem)
         if(memory > heap[i].heap_start && memory < heap[i].heap_end)
         {
             // The memory block given is part of this heap, so we can simply
-	        // flag that this memory area is now free, and we're done.
+            // flag that this memory area is now free, and we're done.
             if (*cb == 0 || *cb & MICROBIT_HEAP_BLOCK_FREE)
                 microbit_panic(MICROBIT_HEAP_ERROR);
 
-	        *cb |= MICROBIT_HEAP_BLOCK_FREE;
+            *cb |= MICROBIT_HEAP_BLOCK_FREE;
             return;
         }
     }
@@ -373,13 +384,343 @@ void* realloc (void* ptr, size_t size)
         uint32_t *cb = ((uint32_t *)ptr) - 1;
         uint32_t blockSize = *cb & ~MICROBIT_HEAP_BLOCK_FREE;
 
-        memcpy(mem, ptr, min(blockSize * sizeof(uint32_t), size));
+        // The block size includes its header, which isn't part of the data.
+        memcpy(mem, ptr, min((blockSize - 1) * sizeof(uint32_t), size));
         free(ptr);
     }
 
     return mem;
 }
 
+/**
+  * Gathers usage and fragmentation statistics for a given heap.
+  *
+  * @param heap The heap to inspect.
+  *
+  * @param stats The statistics to add this heap's usage to.
+  *
+  * @return true if the heap is consistent, false if a corrupt block header was found.
+  */
+static bool microbit_heap_stats(HeapDefinition &heap, MicroBitHeapStats &stats)
+{
+	uint32_t	blockSize;
+	uint32_t	*block;
+    uint32_t    freeRun = 0;
+
+	block = heap.heap_start;
+	while (block < heap.heap_end)
+	{
+		blockSize = *block & ~MICROBIT_HEAP_BLOCK_FREE;
+
+        // Every block must at least hold its own header, and lie wholly within the heap.
+        if (blockSize == 0 || blockSize > (uint32_t)(heap.heap_end - block))
+            return false;
+
+		if (*block & MICROBIT_HEAP_BLOCK_FREE)
+        {
+            // Adjacent free blocks are merged lazily, so count them as a single region.
+            if (freeRun == 0)
+                stats.freeRegions++;
+
+            freeRun += blockSize;
+            stats.totalFree += blockSize * MICROBIT_HEAP_BLOCK_SIZE;
+
+            if (freeRun * MICROBIT_HEAP_BLOCK_SIZE > stats.largestFree)
+                stats.largestFree = freeRun * MICROBIT_HEAP_BLOCK_SIZE;
+        }
+        else
+        {
+            freeRun = 0;
+            stats.usedBlocks++;
+            stats.totalUsed += blockSize * MICROBIT_HEAP_BLOCK_SIZE;
+        }
+
+		block += blockSize;
+	}
+
+    // The last block must end exactly at the end of the heap.
+    return block == heap.heap_end;
+}
+
+/**
+  * Gathers usage and fragmentation statistics across all initialised heaps.
+  *
+  * @param stats The structure to populate.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if heap corruption was detected.
+  */
+int microbit_heap_stats(MicroBitHeapStats &stats)
+{
+    bool ok = true;
+
+    memclr(&stats, sizeof(MicroBitHeapStats));
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    for (int i=0; i < heap_count; i++)
+        ok = ok && microbit_heap_stats(heap[i], stats);
+
+	// Enable Interrupts
+    __enable_irq();
+
+    return ok ? MICROBIT_OK : MICROBIT_INVALID_PARAMETER;
+}
+
+/**
+  * Verifies the integrity of all initialised heaps, by walking every block header
+  * and checking that each relocatable block refers to memory that is in use.
+  *
+  * @return 1 if the heaps are consistent, 0 otherwise.
+  */
+int microbit_heap_verify()
+{
+    MicroBitHeapStats stats;
+
+    if (microbit_heap_stats(stats) != MICROBIT_OK)
+        return 0;
+
+#if MICROBIT_HEAP_MAX_HANDLES > 0
+    for (int i = 0; i < MICROBIT_HEAP_MAX_HANDLES; i++)
+    {
+        if (heap_handles[i].data == NULL)
+            continue;
+
+        uint32_t *cb = (uint32_t *)heap_handles[i].data - 1;
+
+        if (*cb == 0 || *cb & MICROBIT_HEAP_BLOCK_FREE)
+            return 0;
+    }
+#endif
+
+    return 1;
+}
+
+#if MICROBIT_HEAP_MAX_HANDLES > 0
+/**
+  * Allocate a relocatable block of memory. Ideal for large, long lived buffers that would otherwise
+  * pin holes in the heap, preventing later allocations from succeeding.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A handle to the allocated memory, or NULL if insufficient memory or handles are available.
+  */
+MicroBitHeapHandle *microbit_handle_alloc(size_t size)
+{
+    MicroBitHeapHandle *h = NULL;
+    void *mem = malloc(size);
+
+    if (mem == NULL)
+        return NULL;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    for (int i = 0; i < MICROBIT_HEAP_MAX_HANDLES; i++)
+    {
+        if (heap_handles[i].data == NULL)
+        {
+            h = &heap_handles[i];
+            h->data = mem;
+            h->locks = 0;
+            break;
+        }
+    }
+
+	// Enable Interrupts
+    __enable_irq();
+
+    // No handles left, so give the memory back.
+    if (h == NULL)
+        free(mem);
+
+    return h;
+}
+
+/**
+  * Release a relocatable block of memory, and the handle that refers to it.
+  *
+  * @param handle The handle to release.
+  */
+void microbit_handle_free(MicroBitHeapHandle *handle)
+{
+    void *mem;
+
+    if (handle == NULL)
+        return;
+
+    __disable_irq();
+    mem = handle->data;
+    handle->data = NULL;
+    handle->locks = 0;
+    __enable_irq();
+
+    free(mem);
+}
+
+/**
+  * Prevents the given block from being moved, and determines its current location.
+  * Calls may be nested, and must be balanced with calls to microbit_handle_unlock().
+  *
+  * @param handle The handle of the block to lock.
+  *
+  * @return The location of the block, which will remain valid until the block is unlocked.
+  */
+void *microbit_handle_lock(MicroBitHeapHandle *handle)
+{
+    void *mem;
+
+    __disable_irq();
+    handle->locks++;
+    mem = handle->data;
+    __enable_irq();
+
+    return mem;
+}
+
+/**
+  * Allows the given block to be moved again, once all locks on it have been released.
+  *
+  * @param handle The handle of the block to unlock.
+  */
+void microbit_handle_unlock(MicroBitHeapHandle *handle)
+{
+    __disable_irq();
+    if (handle->locks > 0)
+        handle->locks--;
+    __enable_irq();
+}
+
+/**
+  * Determines if the given heap block is relocatable.
+  *
+  * @param block The header of the heap block to look up.
+  *
+  * @return The handle that refers to the block, or NULL if the block is not relocatable.
+  */
+static MicroBitHeapHandle *microbit_handle_find(uint32_t *block)
+{
+    for (int i = 0; i < MICROBIT_HEAP_MAX_HANDLES; i++)
+        if (heap_handles[i].data == block+1)
+            return &heap_handles[i];
+
+    return NULL;
+}
+
+/**
+  * Moves the first unlocked relocatable block that is preceded by free space in the given heap
+  * down into that free space.
+  *
+  * The heap is walked one block at a time, with interrupts enabled between blocks, so the time spent with
+  * interrupts disabled is bounded by the cost of moving a single block. If an allocation changes the layout
+  * of the heap part way through, the pass is abandoned and left for the next call.
+  *
+  * @param heap The heap to compact.
+  *
+  * @return The number of bytes moved, or zero if no block could be moved.
+  */
+static int microbit_heap_compact(HeapDefinition &heap)
+{
+	uint32_t	blockSize;
+	uint32_t	*block;
+	uint32_t	*gap = NULL;
+    uint32_t    generation;
+    int         moved = 0;
+
+    __disable_irq();
+    generation = heap_generation;
+    __enable_irq();
+
+	block = heap.heap_start;
+	while (block < heap.heap_end && moved == 0)
+	{
+        // Each block is examined (and possibly moved) atomically, as an ISR may be allocating or freeing memory.
+        __disable_irq();
+
+        if (heap_generation != generation)
+        {
+            __enable_irq();
+            return 0;
+        }
+
+		blockSize = *block & ~MICROBIT_HEAP_BLOCK_FREE;
+
+        // Record the start of any run of free blocks, merging them as we go.
+		if (*block & MICROBIT_HEAP_BLOCK_FREE)
+        {
+            if (gap == NULL)
+                gap = block;
+            else
+                *gap = (uint32_t)((block + blockSize) - gap) | MICROBIT_HEAP_BLOCK_FREE;
+
+            block += blockSize;
+            __enable_irq();
+            continue;
+        }
+
+        // We have a used block. If it follows some free space and is free to move, slide it down.
+        MicroBitHeapHandle *h = gap != NULL ? microbit_handle_find(block) : NULL;
+
+        if (h != NULL && h->locks == 0)
+        {
+            uint32_t gapSize = block - gap;
+
+            memmove(gap, block, blockSize * MICROBIT_HEAP_BLOCK_SIZE);
+            h->data = gap + 1;
+
+            // The free space now lies immediately after the block we've moved.
+            gap += blockSize;
+            *gap = gapSize | MICROBIT_HEAP_BLOCK_FREE;
+
+            moved = blockSize * MICROBIT_HEAP_BLOCK_SIZE;
+        }
+
+        gap = NULL;
+		block += blockSize;
+
+        __enable_irq();
+	}
+
+    return moved;
+}
+
+/**
+  * Determines if any relocatable blocks have been allocated.
+  */
+static bool microbit_handles_in_use()
+{
+    for (int i = 0; i < MICROBIT_HEAP_MAX_HANDLES; i++)
+        if (heap_handles[i].data != NULL)
+            return true;
+
+    return false;
+}
+#endif
+
+/**
+  * Moves at most one unlocked relocatable block towards the start of its heap, merging the free
+  * space it leaves behind with any free space above it. Called periodically from idle().
+  *
+  * @return The number of bytes moved, or zero if no further compaction is possible.
+  */
+int microbit_heap_compact()
+{
+#if MICROBIT_HEAP_MAX_HANDLES > 0
+    // Nothing can be moved unless a relocatable block exists, so don't walk the heap at all.
+    if (!microbit_handles_in_use())
+        return 0;
+
+    for (int i=0; i < heap_count; i++)
+    {
+        int moved = microbit_heap_compact(heap[i]);
+        if (moved)
+            return moved;
+    }
+#endif
+
+    return 0;
+}
+
 // make sure the libc allocator is not pulled in
 void *_malloc_r(struct _reent *, size_t len)
 {
@@ -400,7 +741,7 @@ _realloc_r (struct _reent *ptr, void *old, size_t newlen)
 
 #else
 
-int microbit_create_heap(uint32_t start, uint32_t end)
+int microbit_create_heap(uintptr_t start, uintptr_t end)
 {
     (void) start;
     (void) end;
@@ -408,4 +749,64 @@ int microbit_create_heap(uint32_t start, uint32_t end)
     return MICROBIT_OK;
 }
 
+int microbit_heap_compact()
+{
+    return 0;
+}
+
+int microbit_heap_stats(MicroBitHeapStats &stats)
+{
+    memclr(&stats, sizeof(MicroBitHeapStats));
+
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+int microbit_heap_verify()
+{
+    return 1;
+}
+
+#endif
+
+#if !CONFIG_ENABLED(MICROBIT_HEAP_ENABLED) || MICROBIT_HEAP_MAX_HANDLES == 0
+
+// Without our own heap, or without a table of relocatable blocks, relocatable blocks are simply never moved.
+MicroBitHeapHandle *microbit_handle_alloc(size_t size)
+{
+    MicroBitHeapHandle *h = (MicroBitHeapHandle *) malloc(sizeof(MicroBitHeapHandle));
+
+    if (h == NULL)
+        return NULL;
+
+    h->data = malloc(size);
+    h->locks = 0;
+
+    if (h->data == NULL)
+    {
+        free(h);
+        return NULL;
+    }
+
+    return h;
+}
+
+void microbit_handle_free(MicroBitHeapHandle *handle)
+{
+    if (handle == NULL)
+        return;
+
+    free(handle->data);
+    free(handle);
+}
+
+void *microbit_handle_lock(MicroBitHeapHandle *handle)
+{
+    return handle ? handle->data : NULL;
+}
+
+void microbit_handle_unlock(MicroBitHeapHandle *handle)
+{
+    (void) handle;
+}
+
 #endif
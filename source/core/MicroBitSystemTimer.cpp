@@ -36,24 +36,97 @@ DEALINGS IN THE SOFTWARE.
   */
 #include "MicroBitConfig.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitEvent.h"
+#include "MicroBitCompat.h"
 #include "ErrorNo.h"
 
 /*
- * Time since power on. Measured in milliseconds.
- * When stored as an unsigned long, this gives us approx 50 days between rollover, which is ample. :-)
+ * Time since power on, measured in microseconds, as of the last call to update_time().
+ * Extended from the 32 bit hardware ticker, this gives us well over 500,000 years between rollover. :-)
  */
-static uint64_t time_us = 0;
+uint64_t system_timer_base_us = 0;
+uint32_t system_timer_base_ticks = 0;
 static unsigned int tick_period = 0;
 
-// Array of components which are iterated during a system tick
-static MicroBitComponent* systemTickComponents[MICROBIT_SYSTEM_COMPONENTS];
+/*
+ * A component registered for periodic callbacks, and how often it wants them.
+ */
+struct SystemTickEntry
+{
+    MicroBitComponent   *component;     // The component to call.
+    uint16_t            period;         // The requested period between callbacks, in milliseconds.
+    uint16_t            divisor;        // The number of system ticks between callbacks.
+    uint16_t            countdown;      // The number of system ticks until the next callback.
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    SystemTickProfile   profile;        // Execution time of this component's systemTick().
+#endif
+};
+
+/*
+ * A single software timer. Timers are held on a list sorted by deadline, so the system
+ * timer interrupt only ever needs to inspect the head of the list.
+ */
+struct SoftwareTimer
+{
+    uint32_t            deadline;       // The time at which this timer expires (milliseconds since power on, modulo 2^32).
+    uint32_t            period;         // The period of a repeating timer, or zero for a one shot timer.
+    void                (*fn)(void *);  // The function to call on expiry, or NULL to raise an event instead.
+    union
+    {
+        void            *arg;           // The parameter to pass to fn.
+        uint32_t        event;          // The id (low 16 bits) and value (high 16 bits) of the event to raise.
+    };
+    SoftwareTimer       *next;          // The next timer to expire.
+};
+
+// List of pending software timers, in deadline order.
+static SoftwareTimer *softwareTimers = NULL;
+
+// Compact array of components which are iterated during a system tick.
+// Only the first systemTickCount entries are in use.
+static SystemTickEntry systemTickComponents[MICROBIT_SYSTEM_COMPONENTS];
+static int systemTickCount = 0;
+
+// Set while system_timer_tick() is calling components. Components removed meanwhile (typically by
+// themselves) are only marked as dead, and the array is compacted once the tick completes, so the
+// loop never skips the entry that would otherwise be moved into the removed one's place.
+static bool systemTickActive = false;
+static bool systemTickDead = false;
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+// Interval between system timer interrupts, and the time of the last interrupt.
+static SystemTickJitter systemTickJitter;
+static uint32_t lastTick = 0;
+
+/**
+  * Clears the given execution time statistics.
+  */
+static void system_timer_reset_profile(SystemTickProfile &p)
+{
+    p.calls = 0;
+    p.total = 0;
+    p.min = 0xFFFF;
+    p.max = 0;
+}
+#endif
+
+/**
+  * Determines how many system ticks lie between callbacks for a given period.
+  *
+  * @param period the requested period in milliseconds.
+  *
+  * @return the number of ticks between callbacks, which is always at least one.
+  */
+static uint16_t system_timer_divisor(int period)
+{
+    int divisor = tick_period ? period / (int)tick_period : 1;
+
+    return divisor < 1 ? 1 : (divisor > 0xFFFF ? 0xFFFF : divisor);
+}
 
 // Periodic callback interrupt
 static Ticker *ticker = NULL;
 
-// System timer.
-static Timer *timer = NULL;
-
 
 /**
   * Initialises a system wide timer, used to drive the various components used in the runtime.
@@ -69,12 +142,6 @@ int system_timer_init(int period)
     if (ticker == NULL)
         ticker = new Ticker();
 
-    if (timer == NULL)
-    {
-        timer = new Timer();
-        timer->start();
-    }
-
     return system_timer_set_period(period);
 }
 
@@ -96,6 +163,21 @@ int system_timer_set_period(int period)
 
 	// register a period callback to drive the scheduler and any other registered components.
     tick_period = period;
+
+    // Rescale the callback rate of any components that asked for a specific period.
+    __disable_irq();
+
+    for (int i = 0; i < systemTickCount; i++)
+    {
+        SystemTickEntry *e = &systemTickComponents[i];
+
+        e->divisor = system_timer_divisor(e->period);
+        if (e->countdown > e->divisor)
+            e->countdown = e->divisor;
+    }
+
+    __enable_irq();
+
     ticker->attach_us(system_timer_tick, period * 1000);
 
     return MICROBIT_OK;
@@ -112,40 +194,274 @@ int system_timer_get_period()
 }
 
 /**
-  * Updates the current time in microseconds, since power on.
+  * Synchronises the 64 bit system clock with the free running 32 bit microsecond ticker.
   *
-  * If the mbed Timer hasn't been initialised, it will be initialised
+  * The ticker is never stopped or reset, so no time is lost between calls. This must be called
+  * at least once every 2^32 microseconds (around 71 minutes) to track overflow of the ticker,
+  * which the system timer interrupt does on every tick.
+  *
+  * If the system timer hasn't been initialised, it will be initialised
   * on the first call to this function.
   */
 void update_time()
 {
     // If we haven't been initialized, bring up the timer with the default period.
-    if (timer == NULL || ticker == NULL)
+    if (ticker == NULL)
         system_timer_init(SYSTEM_TICK_PERIOD_MS);
 
-    time_us += timer->read_us();
-    timer->reset();
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Unsigned arithmetic takes care of the ticker wrapping around.
+    uint32_t now = us_ticker_read();
+    system_timer_base_us += (uint32_t)(now - system_timer_base_ticks);
+    system_timer_base_ticks = now;
+
+    __set_PRIMASK(primask);
 }
 
 /**
-  * Determines the time since the device was powered on.
+  * Adds a software timer to the list of pending timers, in deadline order.
+  * Must be called with interrupts disabled.
   *
-  * @return the current time since power on in milliseconds
+  * @param t The timer to add.
   */
-uint64_t system_timer_current_time()
+static void system_timer_insert(SoftwareTimer *t)
 {
-    return system_timer_current_time_us() / 1000;
+    SoftwareTimer **p = &softwareTimers;
+
+    // Timers with equal deadlines fire in the order they were added.
+    while (*p != NULL && (int32_t)((*p)->deadline - t->deadline) <= 0)
+        p = &(*p)->next;
+
+    t->next = *p;
+    *p = t;
 }
 
 /**
-  * Determines the time since the device was powered on.
+  * Creates and schedules a new software timer.
   *
-  * @return the current time since power on in microseconds
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the timer could not be allocated.
   */
-uint64_t system_timer_current_time_us()
+static int system_timer_schedule(uint32_t period, bool repeat, void (*fn)(void *), void *arg, uint32_t event)
 {
-    update_time();
-    return time_us;
+    SoftwareTimer *t = new SoftwareTimer();
+
+    if (t == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    // Ensure the timer interrupt is running to service us.
+    if (ticker == NULL)
+        system_timer_init(SYSTEM_TICK_PERIOD_MS);
+
+    t->period = repeat ? period : 0;
+    t->fn = fn;
+
+    if (fn)
+        t->arg = arg;
+    else
+        t->event = event;
+
+    __disable_irq();
+    t->deadline = (uint32_t)system_timer_current_time() + period;
+    system_timer_insert(t);
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Removes all software timers matching the given function and parameter (or event).
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no such timer exists.
+  */
+static int system_timer_cancel(void (*fn)(void *), void *arg, uint32_t event)
+{
+    SoftwareTimer **p = &softwareTimers;
+    SoftwareTimer *removed = NULL;
+
+    __disable_irq();
+
+    while (*p != NULL)
+    {
+        SoftwareTimer *t = *p;
+
+        if (t->fn == fn && (fn ? t->arg == arg : t->event == event))
+        {
+            *p = t->next;
+            t->next = removed;
+            removed = t;
+        }
+        else
+        {
+            p = &t->next;
+        }
+    }
+
+    __enable_irq();
+
+    if (removed == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    while (removed != NULL)
+    {
+        SoftwareTimer *t = removed;
+        removed = removed->next;
+        delete t;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Fires any software timers that have expired. Called from interrupt context, once per period.
+  */
+static void system_timer_expire()
+{
+    uint32_t now = (uint32_t)system_timer_current_time();
+
+    while (softwareTimers != NULL && (int32_t)(now - softwareTimers->deadline) >= 0)
+    {
+        SoftwareTimer *t = softwareTimers;
+        void (*fn)(void *) = t->fn;
+        void *arg = t->arg;
+        uint32_t event = t->event;
+
+        softwareTimers = t->next;
+
+        // Reschedule repeating timers before firing, so the handler is free to cancel them.
+        // We schedule relative to the previous deadline, so repeating timers don't drift.
+        // Any whole periods we've already fallen behind by are skipped, rather than caught up in a burst.
+        if (t->period)
+        {
+            t->deadline += t->period;
+
+            if ((int32_t)(now - t->deadline) >= 0)
+                t->deadline += ((now - t->deadline) / t->period + 1) * t->period;
+
+            system_timer_insert(t);
+        }
+        else
+        {
+            delete t;
+        }
+
+        if (fn)
+            fn(arg);
+        else
+            MicroBitEvent(event & 0xFFFF, event >> 16);
+    }
+}
+
+/**
+  * Schedules an event to be raised on the default EventModel once the given period has elapsed.
+  * Listeners receive the event in thread context as usual, so no fiber needs to sleep waiting for it.
+  *
+  * @param period The time to wait before raising the event, in milliseconds.
+  *
+  * @param id The ID of the event to raise.
+  *
+  * @param value The value of the event to raise.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_event_after(uint32_t period, uint16_t id, uint16_t value)
+{
+    return system_timer_schedule(period, false, NULL, NULL, id | ((uint32_t)value << 16));
+}
+
+/**
+  * Schedules an event to be raised on the default EventModel repeatedly, once every period.
+  * Events stay in step with whole periods from the first. If the system falls more than a period behind,
+  * the missed events are skipped rather than raised in a burst.
+  *
+  * @param period The time between events, in milliseconds.
+  *
+  * @param id The ID of the event to raise.
+  *
+  * @param value The value of the event to raise.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is zero,
+  * or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_event_every(uint32_t period, uint16_t id, uint16_t value)
+{
+    if (period == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return system_timer_schedule(period, true, NULL, NULL, id | ((uint32_t)value << 16));
+}
+
+/**
+  * Cancels all timers previously scheduled to raise the given event.
+  *
+  * @param id The ID of the event.
+  *
+  * @param value The value of the event.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no such timer exists.
+  */
+int system_timer_cancel_event(uint16_t id, uint16_t value)
+{
+    return system_timer_cancel(NULL, NULL, id | ((uint32_t)value << 16));
+}
+
+/**
+  * Schedules a function to be called once the given period has elapsed.
+  *
+  * @param period The time to wait before calling the function, in milliseconds.
+  *
+  * @param fn The function to call. This is invoked in interrupt context, so must not block.
+  *
+  * @param arg An optional parameter to pass to the function.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_callback_after(uint32_t period, void (*fn)(void *), void *arg)
+{
+    if (fn == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return system_timer_schedule(period, false, fn, arg, 0);
+}
+
+/**
+  * Schedules a function to be called repeatedly, once every period.
+  * Calls stay in step with whole periods from the first. If the system falls more than a period behind,
+  * the missed calls are skipped rather than made in a burst.
+  *
+  * @param period The time between calls, in milliseconds.
+  *
+  * @param fn The function to call. This is invoked in interrupt context, so must not block.
+  *
+  * @param arg An optional parameter to pass to the function.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if period is zero,
+  * or MICROBIT_NO_RESOURCES if the timer could not be allocated.
+  */
+int system_timer_callback_every(uint32_t period, void (*fn)(void *), void *arg)
+{
+    if (fn == NULL || period == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return system_timer_schedule(period, true, fn, arg, 0);
+}
+
+/**
+  * Cancels all timers previously scheduled to call the given function with the given parameter.
+  *
+  * @param fn The function.
+  *
+  * @param arg The parameter.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no such timer exists.
+  */
+int system_timer_cancel_callback(void (*fn)(void *), void *arg)
+{
+    if (fn == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return system_timer_cancel(fn, arg, 0);
 }
 
 /**
@@ -156,12 +472,82 @@ uint64_t system_timer_current_time_us()
   */
 void system_timer_tick()
 {
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    uint32_t now = us_ticker_read();
+
+    if (lastTick)
+    {
+        uint32_t interval = now - lastTick;
+
+        if (systemTickJitter.ticks == 0 || interval < systemTickJitter.min)
+            systemTickJitter.min = interval;
+
+        if (interval > systemTickJitter.max)
+            systemTickJitter.max = interval;
+
+        systemTickJitter.ticks++;
+        systemTickJitter.total += interval;
+    }
+
+    lastTick = now;
+#endif
+
     update_time();
 
-    // Update any components registered for a callback
-    for(int i = 0; i < MICROBIT_SYSTEM_COMPONENTS; i++)
-        if(systemTickComponents[i] != NULL)
-            systemTickComponents[i]->systemTick();
+    // Fire any software timers that are due.
+    if (softwareTimers != NULL)
+        system_timer_expire();
+
+    // Update any components registered for a callback that are due one this tick.
+    systemTickActive = true;
+
+    for(int i = 0; i < systemTickCount; i++)
+    {
+        SystemTickEntry *e = &systemTickComponents[i];
+
+        if(e->component == NULL)
+            continue;
+
+        if(--e->countdown == 0)
+        {
+            e->countdown = e->divisor;
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+            uint32_t start = us_ticker_read();
+            e->component->systemTick();
+            uint32_t duration = us_ticker_read() - start;
+
+            if (duration > 0xFFFF)
+                duration = 0xFFFF;
+
+            if (duration < e->profile.min)
+                e->profile.min = duration;
+
+            if (duration > e->profile.max)
+                e->profile.max = duration;
+
+            e->profile.calls++;
+            e->profile.total += duration;
+#else
+            e->component->systemTick();
+#endif
+        }
+    }
+
+    systemTickActive = false;
+
+    // Drop any components that were removed while they were being called.
+    if (systemTickDead)
+    {
+        int count = 0;
+
+        for (int i = 0; i < systemTickCount; i++)
+            if (systemTickComponents[i].component != NULL)
+                systemTickComponents[count++] = systemTickComponents[i];
+
+        systemTickCount = count;
+        systemTickDead = false;
+    }
 }
 
 /**
@@ -176,19 +562,60 @@ void system_timer_tick()
   */
 int system_timer_add_component(MicroBitComponent *component)
 {
-    int i = 0;
+    return system_timer_add_component(component, 0);
+}
+
+/**
+  * Add a component to the array of system components. This component will then receive
+  * periodic callbacks in interrupt context, at (approximately) the given period.
+  *
+  * Components sharing the same period are spread across different ticks, to even out the
+  * amount of work performed in each system timer interrupt.
+  *
+  * @param component The component to add.
+  *
+  * @param period The period between callbacks in milliseconds, rounded down to a whole number of
+  * system ticks. A period of zero (or less than one system tick) provides a callback every tick.
+  *
+  * @return MICROBIT_OK on success. MICROBIT_NO_RESOURCES is returned if the component array is full.
+  *
+  * @note The callback will be in interrupt context.
+  */
+int system_timer_add_component(MicroBitComponent *component, int period)
+{
+    int peers = 0;
 
     // If we haven't been initialized, bring up the timer with the default period.
-    if (timer == NULL || ticker == NULL)
+    if (ticker == NULL)
         system_timer_init(SYSTEM_TICK_PERIOD_MS);
 
-    while(systemTickComponents[i] != NULL && i < MICROBIT_SYSTEM_COMPONENTS)
-        i++;
-
-    if(i == MICROBIT_SYSTEM_COMPONENTS)
+    if (systemTickCount == MICROBIT_SYSTEM_COMPONENTS)
         return MICROBIT_NO_RESOURCES;
 
-    systemTickComponents[i] = component;
+    __disable_irq();
+
+    SystemTickEntry *e = &systemTickComponents[systemTickCount];
+
+    e->component = component;
+    e->period = period < 0 ? 0 : min(period, 0xFFFF);
+    e->divisor = system_timer_divisor(e->period);
+
+    // Stagger the phase of components that share the same rate, so they don't all land on the same tick.
+    for (int i = 0; i < systemTickCount; i++)
+        if (systemTickComponents[i].divisor == e->divisor)
+            peers++;
+
+    e->countdown = 1 + (peers % e->divisor);
+
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    e->profile.component = component;
+    system_timer_reset_profile(e->profile);
+#endif
+
+    systemTickCount++;
+
+    __enable_irq();
+
     return MICROBIT_OK;
 }
 
@@ -204,13 +631,126 @@ int system_timer_remove_component(MicroBitComponent *component)
 {
     int i = 0;
 
-    while(systemTickComponents[i] != component && i < MICROBIT_SYSTEM_COMPONENTS)
+    __disable_irq();
+
+    while(i < systemTickCount && systemTickComponents[i].component != component)
         i++;
 
-    if(i == MICROBIT_SYSTEM_COMPONENTS)
+    if(i == systemTickCount)
+    {
+        __enable_irq();
+        return MICROBIT_INVALID_PARAMETER;
+    }
+
+    // If we've been called from a component's systemTick(), leave the array alone until the tick completes.
+    if (systemTickActive)
+    {
+        systemTickComponents[i].component = NULL;
+        systemTickDead = true;
+
+        __enable_irq();
+        return MICROBIT_OK;
+    }
+
+    // Close the gap, preserving the order in which components are called.
+    systemTickCount--;
+    for (; i < systemTickCount; i++)
+        systemTickComponents[i] = systemTickComponents[i+1];
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Retrieves the execution time statistics of a component registered with the system timer.
+  *
+  * @param index The position of the component in the system timer's list, starting at zero.
+  *
+  * @param profile The structure to populate.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if index is out of range,
+  * or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TIMER_PROFILING is disabled.
+  */
+int system_timer_get_profile(int index, SystemTickProfile &profile)
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    if (index < 0 || index >= systemTickCount)
         return MICROBIT_INVALID_PARAMETER;
 
-    systemTickComponents[i] = NULL;
+    __disable_irq();
+    profile = systemTickComponents[index].profile;
+    __enable_irq();
 
     return MICROBIT_OK;
+#else
+    (void) index;
+    (void) profile;
+
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Retrieves statistics on the interval between successive system timer interrupts.
+  *
+  * @param jitter The structure to populate.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if MICROBIT_SYSTEM_TIMER_PROFILING is disabled.
+  */
+int system_timer_get_jitter(SystemTickJitter &jitter)
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    __disable_irq();
+    jitter = systemTickJitter;
+    __enable_irq();
+
+    return MICROBIT_OK;
+#else
+    (void) jitter;
+
+    return MICROBIT_NOT_SUPPORTED;
+#endif
+}
+
+/**
+  * Discards all execution time and jitter statistics gathered so far.
+  */
+void system_timer_reset_profile()
+{
+#if CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    __disable_irq();
+
+    for (int i = 0; i < systemTickCount; i++)
+        system_timer_reset_profile(systemTickComponents[i].profile);
+
+    systemTickJitter.ticks = 0;
+    systemTickJitter.total = 0;
+    systemTickJitter.min = 0;
+    systemTickJitter.max = 0;
+    lastTick = 0;
+
+    __enable_irq();
+#endif
+}
+
+/**
+  * Displays a table of systemTick() execution times and system timer jitter
+  * via the debug serial port. Requires MICROBIT_DBG and MICROBIT_SYSTEM_TIMER_PROFILING.
+  */
+void system_timer_print_profile()
+{
+#if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_SYSTEM_TIMER_PROFILING)
+    SystemTickProfile p;
+    SystemTickJitter j;
+
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("component   calls      min  avg  max (us)\n");
+
+    for (int i = 0; system_timer_get_profile(i, p) == MICROBIT_OK; i++)
+        if(SERIAL_DEBUG) SERIAL_DEBUG->printf("%p %-10d %-4d %-4d %-4d\n", p.component, (int)p.calls, p.calls ? p.min : 0, p.calls ? (int)(p.total / p.calls) : 0, p.max);
+
+    system_timer_get_jitter(j);
+
+    if(SERIAL_DEBUG) SERIAL_DEBUG->printf("tick interval: min %d avg %d max %d (us)\n", j.ticks ? (int)j.min : 0, j.ticks ? (int)(j.total / j.ticks) : 0, (int)j.max);
+#endif
 }
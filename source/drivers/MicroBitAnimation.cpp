@@ -0,0 +1,369 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a MicroBitAnimation.
+  *
+  * A MicroBitAnimation is a compressed sequence of frames, decoded one frame at a time.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitAnimation.h"
+#include "ErrorNo.h"
+
+/**
+  * Reads the value to encode for a pixel of a frame, given its index in row order.
+  * Pixels outside the image are zero, and delta frames encode the difference from the previous frame.
+  */
+static uint8_t encodedPixel(MicroBitImage &image, MicroBitImage *previous, int width, int i)
+{
+    int x = i % width;
+    int y = i / width;
+    int v = image.getPixelValue(x, y);
+    int p = previous ? previous->getPixelValue(x, y) : 0;
+
+    return (v < 0 ? 0 : v) ^ (p < 0 ? 0 : p);
+}
+
+/**
+  * Constructor.
+  * Creates an animation read directly from memory, with no copying.
+  *
+  * @param data The encoded animation. This must remain valid for the life of the animation.
+  *
+  * @param length The length of the encoded animation, in bytes.
+  *
+  * @code
+  * static const uint8_t blink[] = { 'M', 'A', 2, 1, 2, 0, 0, 0,   100, 0, 0, 0x80, 255,   100, 0, 1, 0x80, 255 };
+  * MicroBitAnimation a(blink, sizeof(blink));
+  * uBit.display.animate(a);
+  * @endcode
+  */
+MicroBitAnimation::MicroBitAnimation(const uint8_t *data, int length)
+{
+    this->data = data;
+    this->length = length;
+    this->offset = 0;
+    this->file = NULL;
+    this->start = 0;
+
+    init(length >= MICROBIT_ANIMATION_HEADER_SIZE ? data : NULL);
+}
+
+/**
+  * Constructor.
+  * Creates an animation read from a file, starting at the file's current position.
+  *
+  * @param file The file to read. This must remain open for the life of the animation.
+  */
+MicroBitAnimation::MicroBitAnimation(MicroBitFile &file)
+{
+    uint8_t header[MICROBIT_ANIMATION_HEADER_SIZE];
+
+    this->data = NULL;
+    this->length = 0;
+    this->offset = 0;
+    this->file = &file;
+    this->start = file.getPosition();
+
+    init(file.read((char *)header, MICROBIT_ANIMATION_HEADER_SIZE) == MICROBIT_ANIMATION_HEADER_SIZE ? header : NULL);
+}
+
+/**
+  * Reads and validates the header, and prepares the frame buffer.
+  */
+void MicroBitAnimation::init(const uint8_t *header)
+{
+    frameCount = 0;
+    frameIndex = 0;
+    bufferLength = 0;
+    bufferPosition = 0;
+
+    if (header == NULL || header[0] != MICROBIT_ANIMATION_MAGIC_0 || header[1] != MICROBIT_ANIMATION_MAGIC_1 || header[2] == 0 || header[3] == 0)
+        return;
+
+    frameCount = header[4] | (header[5] << 8);
+    frame = MicroBitImage(header[2], header[3]);
+    offset = MICROBIT_ANIMATION_HEADER_SIZE;
+}
+
+/**
+  * Reads the next byte of the animation.
+  *
+  * @return the byte, or MICROBIT_NO_DATA if the end of the animation has been reached.
+  */
+int MicroBitAnimation::readByte()
+{
+    if (file == NULL)
+    {
+        if (offset >= length)
+            return MICROBIT_NO_DATA;
+
+        return data[offset++];
+    }
+
+    if (bufferPosition == bufferLength)
+    {
+        int result = file->read((char *)buffer, MICROBIT_ANIMATION_BUFFER_SIZE);
+
+        bufferPosition = 0;
+        bufferLength = result > 0 ? result : 0;
+
+        if (bufferLength == 0)
+            return MICROBIT_NO_DATA;
+    }
+
+    return buffer[bufferPosition++];
+}
+
+/**
+  * Determines if the animation has a valid header.
+  */
+bool MicroBitAnimation::isValid()
+{
+    return frame.getWidth() > 0;
+}
+
+/**
+  * Retrieves the width of the animation, in pixels.
+  */
+int MicroBitAnimation::getWidth()
+{
+    return isValid() ? frame.getWidth() : 0;
+}
+
+/**
+  * Retrieves the height of the animation, in pixels.
+  */
+int MicroBitAnimation::getHeight()
+{
+    return isValid() ? frame.getHeight() : 0;
+}
+
+/**
+  * Retrieves the number of frames in the animation.
+  */
+int MicroBitAnimation::getFrameCount()
+{
+    return frameCount;
+}
+
+/**
+  * Returns to the start of the animation.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if the animation is not valid.
+  */
+int MicroBitAnimation::rewind()
+{
+    if (!isValid())
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (file)
+    {
+        int result = file->setPosition(start + MICROBIT_ANIMATION_HEADER_SIZE);
+
+        if (result < 0)
+            return result;
+
+        bufferLength = 0;
+        bufferPosition = 0;
+    }
+
+    offset = MICROBIT_ANIMATION_HEADER_SIZE;
+    frameIndex = 0;
+    frame.clear();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Decodes the next frame of the animation. The result is available from getFrame().
+  *
+  * @return the time to show the frame for in milliseconds, MICROBIT_NO_DATA if there are no more frames,
+  *         or MICROBIT_INVALID_PARAMETER if the animation is not valid.
+  */
+int MicroBitAnimation::nextFrame()
+{
+    if (!isValid())
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (frameIndex >= frameCount)
+        return MICROBIT_NO_DATA;
+
+    int lo = readByte();
+    int hi = readByte();
+    int flags = readByte();
+
+    if (lo < 0 || hi < 0 || flags < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Delta frames are applied to the previous frame in place, so it must not be shared with anyone holding getFrame().
+    frame.detach();
+
+    uint8_t *out = frame.getBitmap();
+    uint8_t *end = out + frame.getWidth() * frame.getHeight();
+    bool delta = (flags & MICROBIT_ANIMATION_FRAME_DELTA) != 0;
+
+    while (out < end)
+    {
+        int control = readByte();
+
+        if (control < 0)
+            return MICROBIT_INVALID_PARAMETER;
+
+        bool literal = control < 128;
+        int count = literal ? control + 1 : control - 126;
+        int value = literal ? 0 : readByte();
+
+        if (value < 0 || count > end - out)
+            return MICROBIT_INVALID_PARAMETER;
+
+        while (count--)
+        {
+            if (literal && (value = readByte()) < 0)
+                return MICROBIT_INVALID_PARAMETER;
+
+            *out = delta ? *out ^ value : value;
+            out++;
+        }
+    }
+
+    frameIndex++;
+
+    return lo | (hi << 8);
+}
+
+/**
+  * Retrieves the most recently decoded frame.
+  */
+MicroBitImage MicroBitAnimation::getFrame()
+{
+    return frame;
+}
+
+/**
+  * Writes the header of an animation.
+  *
+  * @param buffer The buffer to write to, of at least MICROBIT_ANIMATION_HEADER_SIZE bytes.
+  *
+  * @param width The width of the animation, in the range 1 - 255.
+  *
+  * @param height The height of the animation, in the range 1 - 255.
+  *
+  * @param frames The number of frames in the animation.
+  *
+  * @return the number of bytes written, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitAnimation::encodeHeader(uint8_t *buffer, int width, int height, int frames)
+{
+    if (buffer == NULL || width < 1 || width > 255 || height < 1 || height > 255 || frames < 0 || frames > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    buffer[0] = MICROBIT_ANIMATION_MAGIC_0;
+    buffer[1] = MICROBIT_ANIMATION_MAGIC_1;
+    buffer[2] = width;
+    buffer[3] = height;
+    buffer[4] = frames & 0xFF;
+    buffer[5] = frames >> 8;
+    buffer[6] = 0;
+    buffer[7] = 0;
+
+    return MICROBIT_ANIMATION_HEADER_SIZE;
+}
+
+/**
+  * Encodes a single frame of an animation.
+  *
+  * @param buffer The buffer to write to.
+  *
+  * @param size The size of the buffer. Up to MICROBIT_ANIMATION_FRAME_HEADER_SIZE + width * height * 129 / 128 + 1
+  *             bytes are needed for a frame that doesn't compress.
+  *
+  * @param image The frame to encode. Pixels outside the image are encoded as zero.
+  *
+  * @param width The width of the animation.
+  *
+  * @param height The height of the animation.
+  *
+  * @param delay The time to show the frame for, in milliseconds.
+  *
+  * @param previous The preceding frame, to encode as a delta against. Defaults to none, encoding a key frame.
+  *
+  * @return the number of bytes written, MICROBIT_INVALID_PARAMETER, or MICROBIT_NO_RESOURCES if the buffer is too small.
+  */
+int MicroBitAnimation::encodeFrame(uint8_t *buffer, int size, MicroBitImage image, int width, int height, int delay, MicroBitImage *previous)
+{
+    if (buffer == NULL || width < 1 || width > 255 || height < 1 || height > 255 || delay < 0 || delay > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (size < MICROBIT_ANIMATION_FRAME_HEADER_SIZE)
+        return MICROBIT_NO_RESOURCES;
+
+    buffer[0] = delay & 0xFF;
+    buffer[1] = delay >> 8;
+    buffer[2] = previous ? MICROBIT_ANIMATION_FRAME_DELTA : 0;
+
+    int n = width * height;
+    int i = 0;
+    int length = MICROBIT_ANIMATION_FRAME_HEADER_SIZE;
+
+    while (i < n)
+    {
+        uint8_t v = encodedPixel(image, previous, width, i);
+        int run = 1;
+
+        while (i + run < n && run < 129 && encodedPixel(image, previous, width, i + run) == v)
+            run++;
+
+        if (run > 1)
+        {
+            if (length + 2 > size)
+                return MICROBIT_NO_RESOURCES;
+
+            buffer[length++] = run + 126;
+            buffer[length++] = v;
+            i += run;
+            continue;
+        }
+
+        // Gather literals until the next run of two or more begins.
+        int control = length++;
+        int count = 0;
+
+        while (i < n && count < 128 && !(i + 1 < n && encodedPixel(image, previous, width, i + 1) == encodedPixel(image, previous, width, i)))
+        {
+            if (length >= size)
+                return MICROBIT_NO_RESOURCES;
+
+            buffer[length++] = encodedPixel(image, previous, width, i);
+            count++;
+            i++;
+        }
+
+        buffer[control] = count - 1;
+    }
+
+    return length;
+}
@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitButton.h"
 #include "MicroBitSystemTimer.h"
+#include "MicroBitCompat.h"
 
 /**
   * Constructor.
@@ -52,7 +53,7 @@ MicroBitButton::MicroBitButton(PinName name, uint16_t id, MicroBitButtonEventCon
     this->eventConfiguration = eventConfiguration;
     this->downStartTime = 0;
     this->sigma = 0;
-    system_timer_add_component(this);
+    system_timer_add_component(this, MICROBIT_BUTTON_SAMPLE_PERIOD);
 }
 
 /**
@@ -77,12 +78,20 @@ void MicroBitButton::setEventConfiguration(MicroBitButtonEventConfiguration conf
 }
 
 /**
-  * periodic callback from MicroBit system timer.
+  * periodic callback from MicroBit system timer, every MICROBIT_BUTTON_SAMPLE_PERIOD milliseconds (by default, every tick).
   *
   * Check for state change for this button, and fires various events on a state change.
   */
 void MicroBitButton::systemTick()
 {
+#if MICROBIT_BUTTON_SAMPLE_PERIOD > 0
+    // The sigma thresholds assume a sample every system tick, so each sample counts for as many ticks
+    // as the system timer waits between them. The tick period may change at runtime, so use the current one.
+    int step = max(MICROBIT_BUTTON_SAMPLE_PERIOD / max(system_timer_get_period(), 1), 1);
+#else
+    const int step = 1;
+#endif
+
     //
     // If the pin is pulled low (touched), increment our culumative counter.
     // otherwise, decrement it. We're essentially building a lazy follower here.
@@ -91,13 +100,11 @@ void MicroBitButton::systemTick()
     //
     if(!pin)
     {
-        if (sigma < MICROBIT_BUTTON_SIGMA_MAX)
-            sigma++;
+        sigma = min(sigma + step, MICROBIT_BUTTON_SIGMA_MAX);
     }
     else
     {
-        if (sigma > MICROBIT_BUTTON_SIGMA_MIN)
-            sigma--;
+        sigma = max(sigma - step, MICROBIT_BUTTON_SIGMA_MIN);
     }
 
     // Check to see if we have off->on state change.
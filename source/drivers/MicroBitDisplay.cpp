@@ -37,6 +37,31 @@ DEALINGS IN THE SOFTWARE.
 
 const int greyScaleTimings[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH] = {1, 23, 70, 163, 351, 726, 1476, 2976};
 
+/**
+  * A gamma curve of 2.2, for use with MicroBitDisplay::setGammaTable(), so that evenly spaced pixel values
+  * appear evenly spaced in brightness. The curve is too shallow there for 8 bit levels to follow it, so values
+  * 1 to 24 all map to level 1, and are visible but indistinguishable.
+  */
+const uint8_t microbitGammaTable[256] =
+{
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6,
+    6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+    12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19,
+    20, 20, 21, 22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28, 29,
+    30, 30, 31, 32, 33, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41,
+    42, 43, 43, 44, 45, 46, 47, 48, 49, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71,
+    73, 74, 75, 76, 77, 78, 79, 81, 82, 83, 84, 85, 87, 88, 89, 90,
+    91, 93, 94, 95, 97, 98, 99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
 /**
   * Constructor.
   *
@@ -75,13 +100,34 @@ MicroBitDisplay::MicroBitDisplay(uint16_t id, const MatrixMap &map) :
         col_mask |= 0x01 << i;
 
     LEDMatrix = new PortOut(Port0, row_mask | col_mask);
+    recorder = NULL;
+
+    frontBuffer = new uint8_t[width * height];
+    memset(frontBuffer, 0, width * height);
+    packedFrame = new uint8_t[getSnapshotSize()];
+    frameDirty = false;
+    backgroundBuffer = NULL;
+    sprites = NULL;
+
+    pixelMap = new uint16_t[matrixMap.rows * matrixMap.columns];
+    rowData = new uint32_t[matrixMap.rows];
+    greyscaleSteps = NULL;
+    levelMap = NULL;
+    gammaTable = NULL;
+    levelsDirty = true;
+    litRows = 0;
+    adaptiveRefresh = MICROBIT_DISPLAY_ADAPTIVE_REFRESH;
 
-    this->greyscaleBitMsk = 0x01;
     this->timingCount = 0;
     this->setBrightness(MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS);
     this->mode = DISPLAY_MODE_BLACK_AND_WHITE;
     this->animationMode = ANIMATION_MODE_NONE;
+    this->streamGeneration = 0;
     this->lightSensor = NULL;
+    this->timeline = NULL;
+
+    compilePixelMap();
+    compileFrame();
 
 	system_timer_add_component(this);
 
@@ -105,19 +151,27 @@ void MicroBitDisplay::systemTick()
         return;
     }
 
-    // Move on to the next row.
-    strobeRow++;
+    // Move on to the next row, skipping over any dark rows with adaptive refresh, so the lit rows share all of the time available.
+    if(adaptiveRefresh)
+        nextLitRow();
+    else
+        nextRow();
 
-    //reset the row counts and bit mask when we have hit the max.
-    if(strobeRow == matrixMap.rows)
-        strobeRow = 0;
+    // If nothing is lit, there's nothing to drive. Just keep watching for changes to the image.
+    if(adaptiveRefresh && !litRows)
+    {
+        renderTimer.detach();
+        renderFinish();
+        this->animationUpdate();
+        return;
+    }
 
     if(mode == DISPLAY_MODE_BLACK_AND_WHITE)
         render();
 
     if(mode == DISPLAY_MODE_GREYSCALE)
     {
-        greyscaleBitMsk = 0x01;
+        renderTimer.detach();
         timingCount = 0;
         renderGreyscale();
     }
@@ -126,60 +180,387 @@ void MicroBitDisplay::systemTick()
     this->animationUpdate();
 }
 
-void MicroBitDisplay::renderFinish()
+/**
+  * Moves the strobe on to the next row of the matrix, picking up any changes to the image
+  * at the start of each refresh.
+  */
+void MicroBitDisplay::nextRow()
 {
-    *LEDMatrix = 0;
+    strobeRow++;
+
+    //reset the row counts and bit mask when we have hit the max.
+    if(strobeRow == matrixMap.rows)
+        strobeRow = 0;
+
+    // Pick up any changes to the image once per refresh, so every row of a frame is drawn from the same content.
+    if(strobeRow == 0)
+        updateFrame();
 }
 
-void MicroBitDisplay::render()
+/**
+  * Moves the strobe on to the next row of the matrix with an LED lit, found directly from litRows,
+  * picking up any changes to the image if that starts a new refresh.
+  */
+void MicroBitDisplay::nextLitRow()
 {
-    // Simple optimisation.
-    // If display is at zero brightness, there's nothing to do.
-    if(brightness == 0)
+    // With nothing lit there's no row to find, but keep counting rows, so the image is still checked once per refresh.
+    if(!litRows)
     {
-        renderFinish();
+        nextRow();
+        return;
+    }
+
+    // The lowest lit row after the current one, if there is one before the end of the refresh.
+    uint32_t ahead = litRows >> (strobeRow + 1);
+
+    if(ahead)
+    {
+        strobeRow += 1 + __builtin_ctz(ahead);
         return;
     }
 
-    // Calculate the bitpattern to write.
-    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
-    uint32_t col_data = 0;
+    // Otherwise start a new refresh, which may change which rows are lit.
+    strobeRow = 0;
+    updateFrame();
+
+    if(litRows)
+        strobeRow = __builtin_ctz(litRows);
+}
+
+void MicroBitDisplay::renderFinish()
+{
+    writeMatrix(0);
+}
+
+/**
+  * Recalculates the location in the image bitmap of the pixel driven by each LED of the matrix,
+  * taking into account the current rotation of the display.
+  */
+void MicroBitDisplay::compilePixelMap()
+{
+    // The strobe interrupt may compile a frame at any time, so don't let it see a partially updated map.
+    __disable_irq();
+
+    for (int row = 0; row < matrixMap.rows; row++)
+    {
+        for (int i = 0; i < matrixMap.columns; i++)
+        {
+            int index = (i * matrixMap.rows) + row;
+
+            int x = matrixMap.map[index].x;
+            int y = matrixMap.map[index].y;
+            int t = x;
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+            {
+                    x = width - 1 - y;
+                    y = t;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_180)
+            {
+                    x = width - 1 - x;
+                    y = height - 1 - y;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+            {
+                    x = y;
+                    y = height - 1 - t;
+            }
+
+            pixelMap[row * matrixMap.columns + i] = y * width + x;
+        }
+    }
+
+    frameDirty = true;
 
+    __enable_irq();
+}
+
+/**
+  * Translates the front buffer into the words written to PORT0 for each row of the matrix
+  * (and the greyscale schedule if in use), so that the strobe interrupt has minimal work to do.
+  */
+void MicroBitDisplay::compileFrame()
+{
+    uint8_t *bitmap = frontBuffer;
+    uint16_t *p = pixelMap;
+    uint8_t values[16];                 // Matrix maps drive at most 16 columns.
+
+    litRows = 0;
+
+    if(levelMap && levelsDirty)
+        compileLevelMap();
+
+    for (int row = 0; row < matrixMap.rows; row++)
+    {
+        uint32_t col_data = 0;
+
+        for (int i = 0; i < matrixMap.columns; i++)
+        {
+            values[i] = bitmap[*p++];
+
+            if(values[i])
+                col_data |= (1 << i);
+        }
+
+        // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+        rowData[row] = (~col_data << matrixMap.columnStart & col_mask) | (0x01 << (matrixMap.rowStart + row));
+
+        if(col_data)
+            litRows |= 1 << row;
+
+        if(greyscaleSteps)
+            compileGreyscaleRow(row, values);
+    }
+
+    // Keep the packed snapshot in step with the frame, so that reading it needs no work.
+    int stride = (width + 7) >> 3;
+
+    memset(packedFrame, 0, stride * height);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            if(*bitmap++)
+                packedFrame[y * stride + (x >> 3)] |= 1 << (x & 7);
+}
+
+/**
+  * Recalculates the greyscale level shown for each pixel value, from the gamma table and the brightness.
+  */
+void MicroBitDisplay::compileLevelMap()
+{
+    for (int v = 0; v < 256; v++)
+    {
+        int level = min(v, brightness);
+        levelMap[v] = gammaTable ? gammaTable[level] : level;
+    }
+
+    levelsDirty = false;
+}
+
+/**
+  * Calculates the greyscale schedule for a single row of the matrix.
+  *
+  * Rather than showing each bit plane in turn, all the lit LEDs of the row are switched on
+  * together and then switched off in order of their on time. Each step is a timer event, and none
+  * are scheduled less than MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL apart. LEDs due off sooner than
+  * that after a timer event are switched off by a short busy wait within the same event instead,
+  * so every level keeps its own on time, however dim.
+  *
+  * @param row the row of the matrix to compile.
+  *
+  * @param values the greyscale level of each column of the row.
+  */
+void MicroBitDisplay::compileGreyscaleRow(int row, uint8_t *values)
+{
+    GreyscaleStep *step = &greyscaleSteps[row * (matrixMap.columns + 1)];
+    uint16_t onTime[16];
+    uint16_t remaining = 0;
+    int now = 0;
+    int event = 0;
+
+    // Calculate how long each LED should be lit for. This is the same total time it would
+    // have been lit for across all of the bit planes of its greyscale level.
     for (int i = 0; i < matrixMap.columns; i++)
     {
-        int index = (i * matrixMap.rows) + strobeRow;
+        int v = levelMap[values[i]];
+        int t = 0;
+
+        for (int b = 0; v; b++, v >>= 1)
+            if(v & 0x01)
+                t += greyScaleTimings[b];
+
+        onTime[i] = t;
+
+        if(t)
+            remaining |= (1 << i);
+    }
+
+    while(remaining)
+    {
+        // Find the next time an LED is due to be switched off.
+        int next = 0xffff;
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+        for (int i = 0; i < matrixMap.columns; i++)
+            if((remaining & (1 << i)) && onTime[i] < next)
+                next = onTime[i];
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+        // Within the minimum interval of the last timer event, the renderer busy waits to the exact time.
+        // Beyond it, the timer can't reliably be asked for less than the minimum interval from now,
+        // so the next timer event may fall a little late if this one ended with a busy wait.
+        if(next - event >= MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL)
         {
-                x = width - 1 - y;
-                y = t;
+            next = max(next, now + MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL);
+            event = next;
         }
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
+        uint16_t off = 0;
+
+        for (int i = 0; i < matrixMap.columns; i++)
+            if((remaining & (1 << i)) && onTime[i] <= next)
+                off |= (1 << i);
+
+        step->columns = remaining;
+        step->delay = next - now;
+        step++;
+        now = next;
+
+        remaining &= ~off;
+    }
+
+    // Finally, switch off the whole row.
+    step->columns = 0;
+    step->delay = 0;
+}
+
+/**
+  * Copies the visible region of the image into a byte per pixel buffer the size of the display.
+  *
+  * @param buffer The buffer to update.
+  *
+  * @return true if the content of the buffer changed, false otherwise.
+  */
+bool MicroBitDisplay::snapshotImage(uint8_t *buffer)
+{
+    // The image is public, and may be written directly by user code, so changes are detected by
+    // comparison rather than relying on the display's own operations to flag them.
+    bool changed = false;
+    uint8_t *src = image.getBitmap();
+    uint8_t *dst = buffer;
+
+    if (image.getFormat() == MICROBIT_IMAGE_FORMAT_8BPP && image.getWidth() >= width && image.getHeight() >= height)
+    {
+        for (int y = 0; y < height; y++)
         {
-                x = width - 1 - x;
-                y = height - 1 - y;
+            if (memcmp(dst, src, width) != 0)
+            {
+                memcpy(dst, src, width);
+                changed = true;
+            }
+
+            src += image.getStride();
+            dst += width;
         }
+    }
+    else
+    {
+        // Packed (or undersized) images are expanded a pixel at a time. Anything outside the image is blank.
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int v = image.getPixelValue(x, y);
+                uint8_t pixel = v < 0 ? 0 : v;
+
+                if (*dst != pixel)
+                {
+                    *dst = pixel;
+                    changed = true;
+                }
+
+                dst++;
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**
+  * Clears the changed flag of every sprite, and restores the ordering of the sprite list
+  * by depth if any of them changed.
+  *
+  * @return true if any sprite changed since the last call, false otherwise.
+  */
+bool MicroBitDisplay::updateSprites()
+{
+    bool changed = false;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+    for (MicroBitSprite *s = sprites; s != NULL; s = s->next)
+    {
+        if (s->flags & MICROBIT_SPRITE_CHANGED)
         {
-                x = y;
-                y = height - 1 - t;
+            s->flags &= ~MICROBIT_SPRITE_CHANGED;
+            changed = true;
         }
+    }
+
+    if (!changed)
+        return false;
 
-        if(image.getBitmap()[y*(width*2)+x])
-            col_data |= (1 << i);
+    // A sprite may have changed depth, so rebuild the list with a stable insertion sort.
+    // There are only ever a handful of sprites, and the list is usually already in order.
+    MicroBitSprite *sorted = NULL;
+    MicroBitSprite *s = sprites;
+
+    while (s != NULL)
+    {
+        MicroBitSprite *next = s->next;
+        MicroBitSprite **p = &sorted;
+
+        while (*p != NULL && (*p)->z <= s->z)
+            p = &(*p)->next;
+
+        s->next = *p;
+        *p = s;
+        s = next;
     }
 
-    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
-    col_data = ~col_data << matrixMap.columnStart & col_mask;
+    sprites = sorted;
+
+    return true;
+}
+
+/**
+  * Called at the start of each refresh. Copies any changes to the visible region of the image
+  * into the front buffer, and recompiles the frame only if its content or configuration has changed.
+  */
+void MicroBitDisplay::updateFrame()
+{
+    bool changed = frameDirty;
+
+    if (sprites == NULL)
+    {
+        changed |= snapshotImage(frontBuffer);
+    }
+    else
+    {
+        // Sprites are composited straight into the front buffer, over a copy of the image,
+        // and only when either the image or one of the sprites has changed.
+        changed |= snapshotImage(backgroundBuffer);
+        changed |= updateSprites();
+
+        if (changed)
+        {
+            memcpy(frontBuffer, backgroundBuffer, width * height);
+
+            for (MicroBitSprite *s = sprites; s != NULL; s = s->next)
+                s->render(frontBuffer, width, height);
+        }
+    }
+
+    if (changed)
+    {
+        frameDirty = false;
+        compileFrame();
+    }
+}
+
+void MicroBitDisplay::render()
+{
+    // Simple optimisation.
+    // If display is at zero brightness, there's nothing to do.
+    // The extra row used for light sensing is always left dark.
+    if(brightness == 0 || strobeRow >= matrixMap.rows)
+    {
+        renderFinish();
+        return;
+    }
 
     // Write the new bit pattern
-    *LEDMatrix = col_data | row_data;
+    writeMatrix(rowData[strobeRow]);
 
     //timer does not have enough resolution for brightness of 1. 23.53 us
     if(brightness != MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS && brightness > MICROBIT_DISPLAY_MINIMUM_BRIGHTNESS)
@@ -200,6 +581,9 @@ void MicroBitDisplay::renderWithLightSense()
     }
     else
     {
+        if(strobeRow == 0)
+            updateFrame();
+
         render();
         this->animationUpdate();
 
@@ -219,58 +603,26 @@ void MicroBitDisplay::renderGreyscale()
         return;
     }
 
-    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
-    uint32_t col_data = 0;
+    GreyscaleStep *step = &greyscaleSteps[strobeRow * (matrixMap.columns + 1) + timingCount];
 
-    // Calculate the bitpattern to write.
-    for (int i = 0; i < matrixMap.columns; i++)
+    while(true)
     {
-        int index = (i * matrixMap.rows) + strobeRow;
+        // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+        writeMatrix((~((uint32_t)step->columns) << matrixMap.columnStart & col_mask) | (0x01 << (matrixMap.rowStart + strobeRow)));
+        timingCount++;
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
-
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
-        {
-                x = width - 1 - y;
-                y = t;
-        }
-
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
-        }
+        if(step->delay == 0)
+            return;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
-        {
-                x = y;
-                y = height - 1 - t;
-        }
+        // Steps too close together for the timer were compiled to be busy waited here.
+        if(step->delay >= MICROBIT_DISPLAY_GREYSCALE_MIN_INTERVAL)
+            break;
 
-        if(min(image.getBitmap()[y * (width * 2) + x],brightness) & greyscaleBitMsk)
-            col_data |= (1 << i);
+        wait_us(step->delay);
+        step++;
     }
 
-    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
-    col_data = ~col_data << matrixMap.columnStart & col_mask;
-
-    // Write the new bit pattern
-    *LEDMatrix = col_data | row_data;
-
-    if(timingCount > MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH-1)
-        return;
-
-    greyscaleBitMsk <<= 1;
-
-    if(timingCount < 3)
-    {
-        wait_us(greyScaleTimings[timingCount++]);
-        renderGreyscale();
-        return;
-    }
-    renderTimer.attach_us(this,&MicroBitDisplay::renderGreyscale, greyScaleTimings[timingCount++]);
+    renderTimer.attach_us(this, &MicroBitDisplay::renderGreyscale, step->delay);
 }
 
 /**
@@ -289,6 +641,10 @@ MicroBitDisplay::animationUpdate()
     {
         animationTick = 0;
 
+        // prepareImage() gave the animation a private buffer, but the image may have been copied since.
+        // If so, take a new one before any of the updates below start to modify it.
+        image.detach();
+
         if (animationMode == ANIMATION_MODE_SCROLL_TEXT)
             this->updateScrollText();
 
@@ -301,6 +657,9 @@ MicroBitDisplay::animationUpdate()
         if (animationMode == ANIMATION_MODE_ANIMATE_IMAGE || animationMode == ANIMATION_MODE_ANIMATE_IMAGE_WITH_CLEAR)
             this->updateAnimateImage();
 
+        if (animationMode == ANIMATION_MODE_TIMELINE)
+            this->updateTimeline();
+
         if(animationMode == ANIMATION_MODE_PRINT_CHARACTER)
         {
             animationMode = ANIMATION_MODE_NONE;
@@ -322,29 +681,65 @@ void MicroBitDisplay::sendAnimationCompleteEvent()
     MicroBitEvent(MICROBIT_ID_NOTIFY_ONE, MICROBIT_DISPLAY_EVT_FREE);
 }
 
+/**
+  * Ensures the display image is a private, full size buffer before an animation starts to update it.
+  * Animations run in interrupt context, so this avoids copy on write having to allocate memory there.
+  */
+void MicroBitDisplay::prepareImage()
+{
+    if (image.getWidth() == width * 2 && image.getHeight() == height && image.getFormat() == MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        image.detach();
+        return;
+    }
+
+    // The image has been replaced by one of a different shape or format, so restore a standard buffer
+    // holding the same content.
+    MicroBitImage i(width * 2, height);
+    i.paste(image);
+    replaceImage(i);
+}
+
+/**
+  * Replaces the display image, without the strobe interrupt ever seeing a buffer that has been freed.
+  *
+  * @param i The image to show.
+  */
+void MicroBitDisplay::replaceImage(const MicroBitImage &i)
+{
+    // Hold on to the old buffer, so that the assignment can't free it. Freeing memory re-enables interrupts,
+    // which would let the strobe interrupt run part way through the assignment.
+    MicroBitImage previous(image);
+
+    __disable_irq();
+    image = i;
+    __enable_irq();
+
+    // The old buffer is released as previous goes out of scope, once nothing can still be reading it.
+}
+
 /**
   * Internal scrollText update method.
-  * Shift the screen image by one pixel to the left. If necessary, paste in the next char.
+  * Shift the screen image by one pixel to the left, and bring in the next column of the text.
   */
 void MicroBitDisplay::updateScrollText()
 {
     image.shiftLeft(1);
-    scrollingPosition++;
 
-    if (scrollingPosition == width + MICROBIT_DISPLAY_SPACING)
-    {
-        scrollingPosition = 0;
+    uint8_t column = scrollingStrip.getColumn(scrollingPosition);
 
-        image.print(scrollingChar < scrollingText.length() ? scrollingText.charAt(scrollingChar) : ' ',width,0);
+    for (int y = 0; y < height; y++)
+        image.setPixelValue(width - 1, y, (column & (1 << y)) ? 255 : 0);
 
-        if (scrollingChar > scrollingText.length())
-        {
-            animationMode = ANIMATION_MODE_NONE;
-            this->sendAnimationCompleteEvent();
-            return;
-        }
-        scrollingChar++;
-   }
+    // Once the text has scrolled completely off the display, we're done.
+    if (scrollingPosition >= scrollingStrip.getLength() + width)
+    {
+        animationMode = ANIMATION_MODE_NONE;
+        this->sendAnimationCompleteEvent();
+        return;
+    }
+
+    scrollingPosition++;
 }
 
 /**
@@ -353,7 +748,16 @@ void MicroBitDisplay::updateScrollText()
   */
 void MicroBitDisplay::updatePrintText()
 {
-    image.print(printingChar < printingText.length() ? printingText.charAt(printingChar) : ' ',0,0);
+    if (printingChar < printingText.length())
+    {
+        // Characters may span several bytes of UTF-8.
+        int position = printingChar;
+        image.printCharacter(MicroBitFont::nextCharacter(printingText.toCharArray(), printingText.length(), position), 0, 0);
+        printingChar = position;
+        return;
+    }
+
+    image.print(' ',0,0);
 
     if (printingChar > printingText.length())
     {
@@ -420,6 +824,21 @@ void MicroBitDisplay::updateAnimateImage()
     scrollingImagePosition += scrollingImageStride;
 }
 
+/**
+  * Internal timeline update method.
+  * Advances the timeline being played, and completes the animation once it is empty.
+  */
+void MicroBitDisplay::updateTimeline()
+{
+    if (!timeline->update(*this, system_timer_get_period()))
+    {
+        animationMode = ANIMATION_MODE_NONE;
+        timeline = NULL;
+
+        this->sendAnimationCompleteEvent();
+    }
+}
+
 /**
   * Resets the current given animation.
   */
@@ -487,6 +906,7 @@ int MicroBitDisplay::printCharAsync(char c, int delay)
     // If the display is free, it's our turn to display.
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
+        prepareImage();
         image.print(c, 0, 0);
 
         if (delay > 0)
@@ -530,6 +950,7 @@ int MicroBitDisplay::printAsync(ManagedString s, int delay)
 
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
+        prepareImage();
         printingChar = 0;
         printingText = s;
         animationDelay = delay;
@@ -571,7 +992,17 @@ int MicroBitDisplay::printAsync(MicroBitImage i, int x, int y, int alpha, int de
 
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
-        image.paste(i, x, y, alpha);
+        // An opaque image that exactly covers the display can simply be shown as it is.
+        // Otherwise, it's pasted into the display's own buffer.
+        if (x == 0 && y == 0 && !alpha && i.getWidth() == width && i.getHeight() == height)
+        {
+            replaceImage(i);
+        }
+        else
+        {
+            prepareImage();
+            image.paste(i, x, y, alpha);
+        }
 
         if(delay > 0)
         {
@@ -730,7 +1161,7 @@ int MicroBitDisplay::print(MicroBitImage i, int x, int y, int alpha, int delay)
   * @param delay The time to delay between characters, in milliseconds. Defaults
   *              to: MICROBIT_DEFAULT_SCROLL_SPEED.
   *
-  * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, or MICROBIT_INVALID_PARAMETER.
+  * @return MICROBIT_OK, MICROBIT_BUSY if the display is already in use, MICROBIT_INVALID_PARAMETER, or MICROBIT_NO_RESOURCES if the text could not be laid out.
   *
   * @code
   * display.scrollAsync("abc123",100);
@@ -745,9 +1176,15 @@ int MicroBitDisplay::scrollAsync(ManagedString s, int delay)
     // If the display is free, it's our turn to display.
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
-        scrollingPosition = width-1;
-        scrollingChar = 0;
-        scrollingText = s;
+        int result = scrollingStrip.layout(s, MICROBIT_DISPLAY_SCROLL_PROPORTIONAL, MICROBIT_DISPLAY_SPACING);
+
+        if (result != MICROBIT_OK)
+            return result;
+
+        prepareImage();
+
+        // Leave a short gap before the text starts to enter the display.
+        scrollingPosition = -(MICROBIT_DISPLAY_SPACING + 1);
 
         animationDelay = delay;
         animationTick = 0;
@@ -788,6 +1225,9 @@ int MicroBitDisplay::scrollAsync(MicroBitImage image, int delay, int stride)
     // If the display is free, it's our turn to display.
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
+        prepareImage();
+
+        // The image is shared rather than copied. If the caller modifies it later, they get a copy of their own.
         scrollingImagePosition = stride < 0 ? width : -image.getWidth();
         scrollingImageStride = stride;
         scrollingImage = image;
@@ -834,7 +1274,10 @@ int MicroBitDisplay::scroll(ManagedString s, int delay)
     if (animationMode == ANIMATION_MODE_NONE)
     {
         // Start the effect.
-        this->scrollAsync(s, delay);
+        int result = this->scrollAsync(s, delay);
+
+        if (result != MICROBIT_OK)
+            return result;
 
         // Wait for completion.
         fiberWait();
@@ -927,6 +1370,8 @@ int MicroBitDisplay::animateAsync(MicroBitImage image, int delay, int stride, in
     // If the display is free, we can display.
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
+        prepareImage();
+
         // Assume right to left functionality, to align with scrollString()
         stride = -stride;
 
@@ -1003,6 +1448,156 @@ int MicroBitDisplay::animate(MicroBitImage image, int delay, int stride, int sta
 }
 
 
+/**
+  * Plays a compressed animation on the display, decoding one frame at a time.
+  * Blocks the calling thread until the animation is complete.
+  *
+  * Frames are decoded by the calling fiber rather than in interrupt context, so animations can be
+  * streamed from a file, and only a single frame is ever held in RAM.
+  *
+  * @param animation The animation to play, from its first frame.
+  *
+  * @return MICROBIT_OK, MICROBIT_CANCELLED, or MICROBIT_INVALID_PARAMETER if the animation is not valid.
+  *
+  * @code
+  * MicroBitFile f("intro.anim", READ);
+  * MicroBitAnimation a(f);
+  * display.animate(a);
+  * @endcode
+  */
+int MicroBitDisplay::animate(MicroBitAnimation &animation)
+{
+    if (animation.rewind() != MICROBIT_OK)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // If there's an ongoing animation, wait for our turn to display.
+    this->waitForFreeDisplay();
+
+    // If someone called stopAnimation(), then we simply skip...
+    if (animationMode != ANIMATION_MODE_NONE)
+        return MICROBIT_CANCELLED;
+
+    prepareImage();
+    image.clear();
+
+    // Hold the display for the duration, so other effects queue behind us. There's nothing to do on each tick.
+    animationMode = ANIMATION_MODE_STREAM;
+
+    // The mode alone can't tell us that we still own the display, as another stream may have started
+    // after a call to stopAnimation(). So remember which stream is ours.
+    uint16_t generation = ++streamGeneration;
+    int result = MICROBIT_OK;
+
+    while (animationMode == ANIMATION_MODE_STREAM && streamGeneration == generation)
+    {
+        int delay = animation.nextFrame();
+
+        if (delay < 0)
+        {
+            if (delay != MICROBIT_NO_DATA)
+                result = delay;
+
+            break;
+        }
+
+        // Update the image in one step, so the display never picks up half a frame.
+        MicroBitImage frame = animation.getFrame();
+
+        // The image may have been copied while we slept, so take back a private buffer first.
+        // Doing so allocates memory, which can't be done with interrupts disabled.
+        image.detach();
+
+        __disable_irq();
+        image.paste(frame);
+        __enable_irq();
+
+        fiber_sleep(delay);
+    }
+
+    // If stopAnimation() was called while we slept, it has already signalled completion.
+    if (animationMode != ANIMATION_MODE_STREAM || streamGeneration != generation)
+        return MICROBIT_CANCELLED;
+
+    animationMode = ANIMATION_MODE_NONE;
+    this->sendAnimationCompleteEvent();
+
+    return result;
+}
+
+/**
+  * Plays the items queued on the given timeline, if the display is not in use.
+  * Returns immediately. Items can continue to be added to the timeline while it is playing,
+  * and the animation completes once the timeline is empty.
+  *
+  * @param timeline The timeline to play. It must remain valid until playback completes.
+  *
+  * @return MICROBIT_OK, or MICROBIT_BUSY if the display is already in use.
+  *
+  * @code
+  * MicroBitTimeline t;
+  * t.addScroll("hi");
+  * t.addFade(0, 255, 500);
+  * display.playAsync(t);
+  * @endcode
+  */
+int MicroBitDisplay::playAsync(MicroBitTimeline &timeline)
+{
+    // If the display is free, it's our turn to display.
+    if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
+    {
+        prepareImage();
+
+        // The timeline keeps its own time, so is updated on every tick.
+        this->timeline = &timeline;
+        animationDelay = 0;
+        animationTick = 0;
+        animationMode = ANIMATION_MODE_TIMELINE;
+    }
+    else
+    {
+        return MICROBIT_BUSY;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Plays the items queued on the given timeline.
+  * Blocks the calling thread until the timeline is empty.
+  *
+  * @param timeline The timeline to play.
+  *
+  * @return MICROBIT_OK, or MICROBIT_CANCELLED.
+  *
+  * @code
+  * MicroBitTimeline t;
+  * t.addFrame(MicroBitImage("255,0\n0,255\n"), 1000);
+  * display.play(t);
+  * @endcode
+  */
+int MicroBitDisplay::play(MicroBitTimeline &timeline)
+{
+    // If there's an ongoing animation, wait for our turn to display.
+    this->waitForFreeDisplay();
+
+    // If the display is free, it's our turn to display.
+    // If someone called stopAnimation(), then we simply skip...
+    if (animationMode == ANIMATION_MODE_NONE)
+    {
+        this->playAsync(timeline);
+        fiberWait();
+
+        // Playback has finished, so the images of the items played can be released.
+        timeline.release();
+    }
+    else
+    {
+        return MICROBIT_CANCELLED;
+    }
+
+    return MICROBIT_OK;
+}
+
 /**
   * Configures the brightness of the display.
   *
@@ -1021,6 +1616,8 @@ int MicroBitDisplay::setBrightness(int b)
         return MICROBIT_INVALID_PARAMETER;
 
     this->brightness = b;
+    levelsDirty = true;
+    frameDirty = true;
 
     return MICROBIT_OK;
 }
@@ -1051,9 +1648,46 @@ void MicroBitDisplay::setDisplayMode(DisplayMode mode)
         this->lightSensor = NULL;
     }
 
+    // The greyscale schedule is only compiled once greyscale has been asked for, to save RAM otherwise.
+    // Compile it from the current front buffer straight away, so the frame being strobed stays consistent.
+    if(mode == DISPLAY_MODE_GREYSCALE && greyscaleSteps == NULL)
+    {
+        GreyscaleStep *steps = new GreyscaleStep[matrixMap.rows * (matrixMap.columns + 1)];
+        uint8_t *levels = new uint8_t[256];
+
+        __disable_irq();
+        greyscaleSteps = steps;
+        levelMap = levels;
+        levelsDirty = true;
+        compileFrame();
+        __enable_irq();
+    }
+
     this->mode = mode;
 }
 
+/**
+  * Configures the curve used to translate pixel values into LED brightness in greyscale mode.
+  *
+  * The table is combined with the display brightness into a single lookup table whenever either changes,
+  * so it costs nothing as each frame is drawn.
+  *
+  * @param table 256 entries giving the level shown for each pixel value, or NULL for a linear response.
+  *              The table is not copied, and must remain valid while in use. microbitGammaTable gives
+  *              a perceptually even response.
+  *
+  * @code
+  * display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+  * display.setGammaTable(microbitGammaTable);
+  * @endcode
+  */
+void MicroBitDisplay::setGammaTable(const uint8_t *table)
+{
+    gammaTable = table;
+    levelsDirty = true;
+    frameDirty = true;
+}
+
 /**
   * Retrieves the mode of the display.
   *
@@ -1064,6 +1698,33 @@ int MicroBitDisplay::getDisplayMode()
     return this->mode;
 }
 
+/**
+  * Enables or disables adaptive refresh. When enabled, rows of the matrix with no LEDs lit are skipped,
+  * and their time shared between the rows that are lit, which appear brighter as a result. If nothing is lit
+  * at all, the matrix is not driven. Has no effect in DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE, which
+  * relies on a fixed strobe sequence.
+  *
+  * @param enable true to enable adaptive refresh, false to strobe every row in turn.
+  *
+  * @code
+  * display.setAdaptiveRefresh(true);
+  * @endcode
+  */
+void MicroBitDisplay::setAdaptiveRefresh(bool enable)
+{
+    adaptiveRefresh = enable;
+}
+
+/**
+  * Determines if adaptive refresh is enabled.
+  *
+  * @return true if rows with no LEDs lit are skipped, false otherwise.
+  */
+bool MicroBitDisplay::isAdaptiveRefresh()
+{
+    return adaptiveRefresh;
+}
+
 /**
   * Fetches the current brightness of this display.
   *
@@ -1090,6 +1751,7 @@ int MicroBitDisplay::getBrightness()
 void MicroBitDisplay::rotateTo(DisplayRotation rotation)
 {
     this->rotation = rotation;
+    compilePixelMap();
 }
 
 /**
@@ -1194,12 +1856,146 @@ MicroBitFont MicroBitDisplay::getFont()
   * Captures the bitmap currently being rendered on the display.
   *
   * @return a MicroBitImage containing the captured data.
+  *
+  * @note This allocates a new image. Use getSnapshot() to capture the display without allocating memory.
   */
 MicroBitImage MicroBitDisplay::screenShot()
 {
     return image.crop(0,0,MICROBIT_DISPLAY_WIDTH,MICROBIT_DISPLAY_HEIGHT);
 }
 
+/**
+  * Gets the number of bytes needed to hold a snapshot of the display from getSnapshot().
+  *
+  * @return The size of a snapshot, in bytes.
+  */
+int MicroBitDisplay::getSnapshotSize()
+{
+    return ((width + 7) >> 3) * height;
+}
+
+/**
+  * Copies the frame currently being shown into a caller provided buffer, packed at a bit per pixel.
+  *
+  * Each row of the display takes (width + 7) / 8 bytes, with the leftmost pixel of each in the least
+  * significant bit, as in MICROBIT_IMAGE_FORMAT_1BPP. A bit is set for any pixel that is not blank.
+  * The snapshot includes any sprites, and is kept up to date as each frame is compiled,
+  * so taking one needs no memory to be allocated and costs no more than a copy.
+  *
+  * @param buffer The buffer to receive the snapshot.
+  *
+  * @param length The size of the buffer, which must be at least getSnapshotSize() bytes.
+  *
+  * @return The number of bytes written, or MICROBIT_INVALID_PARAMETER.
+  *
+  * @code
+  * uint8_t frame[5];
+  * display.getSnapshot(frame, sizeof(frame));
+  * @endcode
+  *
+  * @note While the display is disabled, the frame is compiled on demand, so the snapshot still
+  *       follows changes to the image.
+  */
+int MicroBitDisplay::getSnapshot(uint8_t *buffer, int length)
+{
+    int size = getSnapshotSize();
+
+    if (buffer == NULL || length < size)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // The frame is compiled from interrupt context, so take a consistent copy.
+    __disable_irq();
+
+    // Frames are only compiled as the display is refreshed, so catch up with the image if it isn't.
+    if (!(status & MICROBIT_COMPONENT_RUNNING))
+        updateFrame();
+
+    memcpy(buffer, packedFrame, size);
+    __enable_irq();
+
+    return size;
+}
+
+/**
+  * Adds a sprite to the display. Sprites are composited over the display's image in order of
+  * depth, and are redrawn automatically whenever they are moved or otherwise changed.
+  *
+  * @param sprite The sprite to add. It must remain valid until removed from the display.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the sprite is already on the display,
+  *         or MICROBIT_NO_RESOURCES if there is insufficient memory to composite sprites.
+  *
+  * @code
+  * MicroBitSprite ball(MicroBitImage("255\n"), 2, 2);
+  * display.addSprite(ball);
+  * ball.moveBy(1, 0);
+  * @endcode
+  */
+int MicroBitDisplay::addSprite(MicroBitSprite &sprite)
+{
+    for (MicroBitSprite *s = sprites; s != NULL; s = s->next)
+        if (s == &sprite)
+            return MICROBIT_INVALID_PARAMETER;
+
+    if (backgroundBuffer == NULL)
+    {
+        backgroundBuffer = new uint8_t[width * height];
+
+        if (backgroundBuffer == NULL)
+            return MICROBIT_NO_RESOURCES;
+
+        // Force the first composition to take a complete copy of the image.
+        memset(backgroundBuffer, 0, width * height);
+        frameDirty = true;
+    }
+
+    // Insert the sprite above any others of the same depth.
+    __disable_irq();
+
+    MicroBitSprite **p = &sprites;
+
+    while (*p != NULL && (*p)->z <= sprite.z)
+        p = &(*p)->next;
+
+    sprite.next = *p;
+    sprite.flags |= MICROBIT_SPRITE_CHANGED;
+    *p = &sprite;
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Removes a sprite from the display.
+  *
+  * @param sprite The sprite to remove.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the sprite is not on the display.
+  */
+int MicroBitDisplay::removeSprite(MicroBitSprite &sprite)
+{
+    int result = MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+
+    for (MicroBitSprite **p = &sprites; *p != NULL; p = &(*p)->next)
+    {
+        if (*p == &sprite)
+        {
+            *p = sprite.next;
+            sprite.next = NULL;
+            frameDirty = true;
+            result = MICROBIT_OK;
+            break;
+        }
+    }
+
+    __enable_irq();
+
+    return result;
+}
+
 /**
   * Gives a representative figure of the light level in the current environment
   * where are micro:bit is situated.
@@ -1217,14 +2013,50 @@ MicroBitImage MicroBitDisplay::screenShot()
   * first time.
   */
 int MicroBitDisplay::readLightLevel()
+{
+    return getLightSensor().read();
+}
+
+/**
+  * Attaches a recorder, which keeps a timestamped copy of every write to the LED matrix.
+  * Used to check what the display shows, and how, without needing to see the LEDs.
+  *
+  * @param recorder The recorder to attach, or NULL to detach the current recorder.
+  *
+  * @code
+  * MicroBitDisplayRecorder recorder(256);
+  * display.setRecorder(&recorder);
+  * @endcode
+  */
+void MicroBitDisplay::setRecorder(MicroBitDisplayRecorder *recorder)
+{
+    this->recorder = recorder;
+}
+
+/**
+  * Retrieves the light sensor that uses the LEDs of the display, so that continuous sensing, smoothing
+  * and threshold events can be configured.
+  *
+  * Internally, it constructs an instance of a MicroBitLightSensor if not already configured
+  * and sets the display mode to DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE.
+  *
+  * @return the light sensor.
+  *
+  * @code
+  * display.getLightSensor().setContinuous(true);
+  * display.getLightSensor().setSmoothing(3);
+  * @endcode
+  */
+MicroBitLightSensor& MicroBitDisplay::getLightSensor()
 {
     if(mode != DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE)
-    {
         setDisplayMode(DISPLAY_MODE_BLACK_AND_WHITE_LIGHT_SENSE);
+
+    // The mode may have been selected directly, without a sensor being created.
+    if(this->lightSensor == NULL)
         this->lightSensor = new MicroBitLightSensor(matrixMap);
-    }
 
-    return this->lightSensor->read();
+    return *this->lightSensor;
 }
 
 /**
@@ -1233,4 +2065,12 @@ int MicroBitDisplay::readLightLevel()
 MicroBitDisplay::~MicroBitDisplay()
 {
     system_timer_remove_component(this);
+
+    delete[] frontBuffer;
+    delete[] packedFrame;
+    delete[] backgroundBuffer;
+    delete[] pixelMap;
+    delete[] rowData;
+    delete[] greyscaleSteps;
+    delete[] levelMap;
 }
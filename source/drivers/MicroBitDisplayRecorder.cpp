@@ -0,0 +1,215 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a MicroBitDisplayRecorder.
+  *
+  * Keeps a timestamped copy of the writes made to the LED matrix, and reconstructs perceived images from them.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitDisplayRecorder.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  *
+  * @param capacity The number of writes to keep. Once full, the oldest writes are discarded.
+  *
+  * @param map The matrix map of the display being recorded. Defaults to microbitMatrixMap.
+  */
+MicroBitDisplayRecorder::MicroBitDisplayRecorder(int capacity, const MatrixMap &map) : matrixMap(map)
+{
+    capacity = min(max(capacity, 0), 0xFFFF);
+
+    this->samples = capacity ? (MicroBitDisplaySample *)malloc(capacity * sizeof(MicroBitDisplaySample)) : NULL;
+    this->capacity = samples ? capacity : 0;
+    this->length = 0;
+    this->head = 0;
+}
+
+/**
+  * Records a write to the LED matrix. Called by MicroBitDisplay, from interrupt context.
+  *
+  * @param value The value written to the GPIO port.
+  */
+void MicroBitDisplayRecorder::record(uint32_t value)
+{
+    if (capacity == 0)
+        return;
+
+    samples[head].time = (uint32_t)system_timer_current_time_us();
+    samples[head].value = value;
+
+    head = (head + 1) % capacity;
+
+    if (length < capacity)
+        length++;
+}
+
+/**
+  * Discards all recorded writes.
+  */
+void MicroBitDisplayRecorder::clear()
+{
+    __disable_irq();
+    length = 0;
+    head = 0;
+    __enable_irq();
+}
+
+/**
+  * Determines the number of writes currently recorded.
+  */
+int MicroBitDisplayRecorder::getLength()
+{
+    return length;
+}
+
+/**
+  * Retrieves a recorded write.
+  *
+  * @param index The write to retrieve, where 0 is the oldest.
+  *
+  * @param sample The structure to fill in.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if the index is out of range.
+  */
+int MicroBitDisplayRecorder::getSample(int index, MicroBitDisplaySample &sample)
+{
+    int result = MICROBIT_INVALID_PARAMETER;
+
+    __disable_irq();
+
+    if (index >= 0 && index < length)
+    {
+        sample = samples[(head + capacity - length + index) % capacity];
+        result = MICROBIT_OK;
+    }
+
+    __enable_irq();
+
+    return result;
+}
+
+/**
+  * Reconstructs the image perceived over the given period, from the recorded writes.
+  * A pixel is at full brightness (255) if its LED was lit for the whole of its row's share of the period.
+  * The image is in the physical orientation of the matrix, regardless of any rotation of the display.
+  *
+  * @param start The start of the period, in microseconds since power on.
+  *
+  * @param end The end of the period, in microseconds since power on.
+  *
+  * @return the perceived image, or an empty image if the period is invalid.
+  */
+MicroBitImage MicroBitDisplayRecorder::getFrame(uint32_t start, uint32_t end)
+{
+    uint32_t period = end - start;
+
+    if (period == 0 || period > 0x7FFFFFFF)
+        return MicroBitImage();
+
+    int leds = matrixMap.rows * matrixMap.columns;
+    uint32_t *onTime = new uint32_t[leds];
+    memset(onTime, 0, leds * sizeof(uint32_t));
+
+    MicroBitDisplaySample sample;
+    MicroBitDisplaySample next;
+
+    // Each write holds until the following one. Times are compared relative to the start of the period,
+    // so that wrapping of the microsecond clock is handled.
+    for (int i = 0; getSample(i, sample) == MICROBIT_OK; i++)
+    {
+        int32_t from = (int32_t)(sample.time - start);
+        int32_t to = getSample(i + 1, next) == MICROBIT_OK ? (int32_t)(next.time - start) : (int32_t)period;
+
+        from = max(from, 0);
+        to = min(to, (int32_t)period);
+
+        if (to <= from)
+            continue;
+
+        // An LED is lit when its row is driven high and its column is pulled low.
+        for (int row = 0; row < matrixMap.rows; row++)
+        {
+            if (!(sample.value & (1 << (matrixMap.rowStart + row))))
+                continue;
+
+            for (int column = 0; column < matrixMap.columns; column++)
+                if (!(sample.value & (1 << (matrixMap.columnStart + column))))
+                    onTime[row * matrixMap.columns + column] += to - from;
+        }
+    }
+
+    // Unconnected positions of the map are recorded as (0,0), and are never seen lit. Keep the brightest
+    // level written to each pixel so that they cannot hide the LED really at (0,0).
+    MicroBitImage frame(matrixMap.width, matrixMap.height);
+
+    for (int row = 0; row < matrixMap.rows; row++)
+    {
+        for (int column = 0; column < matrixMap.columns; column++)
+        {
+            const MatrixPoint &p = matrixMap.map[column * matrixMap.rows + row];
+            uint64_t level = (uint64_t)onTime[row * matrixMap.columns + column] * matrixMap.rows * 255 / period;
+
+            if (level > 255)
+                level = 255;
+
+            if (p.x < matrixMap.width && p.y < matrixMap.height && level > (uint64_t)frame.getPixelValue(p.x, p.y))
+                frame.setPixelValue(p.x, p.y, level);
+        }
+    }
+
+    delete[] onTime;
+
+    return frame;
+}
+
+/**
+  * Reconstructs the image perceived over the whole period covered by the recorded writes.
+  *
+  * @return the perceived image, or an empty image if fewer than two writes have been recorded.
+  */
+MicroBitImage MicroBitDisplayRecorder::getFrame()
+{
+    MicroBitDisplaySample first;
+    MicroBitDisplaySample last;
+
+    if (getSample(0, first) != MICROBIT_OK || getSample(getLength() - 1, last) != MICROBIT_OK)
+        return MicroBitImage();
+
+    return getFrame(first.time, last.time);
+}
+
+/**
+  * Destructor.
+  */
+MicroBitDisplayRecorder::~MicroBitDisplayRecorder()
+{
+    free(samples);
+}
@@ -37,20 +37,124 @@ DEALINGS IN THE SOFTWARE.
   * After the startSensing method has been called, this method will be called
   * MICROBIT_LIGHT_SENSOR_AN_SET_TIME after.
   *
-  * It will then read from the currently selected channel using the AnalogIn
-  * that was configured in the startSensing method.
+  * It will then read from the currently selected channel (or every channel, if sensing
+  * continuously), and update the smoothed light level.
   */
 void MicroBitLightSensor::analogReady()
 {
-    this->results[chan] = this->sensePin->read_u16();
+    int first = sampleAll ? 0 : chan;
+    int last = sampleAll ? MICROBIT_LIGHT_SENSOR_CHAN_NUM - 1 : chan;
+
+    for (int i = first; i <= last; i++)
+        this->results[i] = sample(i);
 
     analogDisable();
 
-    DigitalOut((PinName)(matrixMap.columnStart + chan)).write(1);
+    for (int i = first; i <= last; i++)
+        DigitalOut((PinName)(matrixMap.columnStart + i)).write(1);
 
     chan++;
 
     chan = chan % MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+
+    update();
+}
+
+/**
+  * Takes a single ADC reading of the given channel. Configures the ADC directly,
+  * so no memory is allocated in interrupt context.
+  *
+  * @param chan the channel (column) to read.
+  *
+  * @return the raw 10 bit reading.
+  */
+int MicroBitLightSensor::sample(int chan)
+{
+    // On the nRF51, GPIO pins P0.01 to P0.06 are analog inputs 2 to 7.
+    int input = matrixMap.columnStart + chan + 1;
+
+    NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Enabled;
+
+    NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
+                      (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                      (ADC_CONFIG_REFSEL_VBG                       << ADC_CONFIG_REFSEL_Pos) |
+                      ((1 << input)                                << ADC_CONFIG_PSEL_Pos) |
+                      (ADC_CONFIG_EXTREFSEL_None                   << ADC_CONFIG_EXTREFSEL_Pos);
+
+    NRF_ADC->TASKS_START = 1;
+
+    while (NRF_ADC->BUSY & ADC_BUSY_BUSY_Msk);
+
+    return NRF_ADC->RESULT;
+}
+
+/**
+  * Converts the latest readings of all channels into a light level in the range 0 - 255.
+  */
+int MicroBitLightSensor::level()
+{
+    int sum = 0;
+
+    for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
+        sum += results[i];
+
+    int average = sum / MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+
+    average = min(average, MICROBIT_LIGHT_SENSOR_MAX_VALUE);
+
+    average = max(average, MICROBIT_LIGHT_SENSOR_MIN_VALUE);
+
+    int inverted = (MICROBIT_LIGHT_SENSOR_MAX_VALUE - average) + MICROBIT_LIGHT_SENSOR_MIN_VALUE;
+
+    int a = 0;
+
+    int b = 255;
+
+    int normalised = a + ((((inverted - MICROBIT_LIGHT_SENSOR_MIN_VALUE)) * (b - a))/ (MICROBIT_LIGHT_SENSOR_MAX_VALUE - MICROBIT_LIGHT_SENSOR_MIN_VALUE));
+
+    return normalised;
+}
+
+/**
+  * Feeds the latest readings through the smoothing filter into the history buffer,
+  * and raises any threshold events.
+  */
+void MicroBitLightSensor::update()
+{
+    // A single pole IIR filter, in 24.8 fixed point so small steps aren't lost at high smoothing.
+    // The first reading is taken as it is, rather than ramping up to it from wherever the filter started.
+    if (historyLength == 0)
+        filtered = level() << 8;
+    else
+        filtered += ((level() << 8) - filtered) >> smoothing;
+
+    int value = filtered >> 8;
+
+    history[historyHead] = value;
+    historyHead = (historyHead + 1) % MICROBIT_LIGHT_SENSOR_HISTORY;
+
+    if (historyLength < MICROBIT_LIGHT_SENSOR_HISTORY)
+        historyLength++;
+
+    // With only one threshold set, there's no other event to re-arm it, so that's done once the level has
+    // moved back past the threshold by a margin, to avoid a stream of events from a level sitting on it.
+    if (thresholdState == MICROBIT_LIGHT_SENSOR_EVT_DARK && brightThreshold < 0 && value > darkThreshold + MICROBIT_LIGHT_SENSOR_HYSTERESIS)
+        thresholdState = 0;
+
+    if (thresholdState == MICROBIT_LIGHT_SENSOR_EVT_BRIGHT && darkThreshold < 0 && value < brightThreshold - MICROBIT_LIGHT_SENSOR_HYSTERESIS)
+        thresholdState = 0;
+
+    if (darkThreshold >= 0 && value <= darkThreshold && thresholdState != MICROBIT_LIGHT_SENSOR_EVT_DARK)
+    {
+        thresholdState = MICROBIT_LIGHT_SENSOR_EVT_DARK;
+        MicroBitEvent(MICROBIT_ID_LIGHT_SENSOR, MICROBIT_LIGHT_SENSOR_EVT_DARK);
+    }
+
+    if (brightThreshold >= 0 && value >= brightThreshold && thresholdState != MICROBIT_LIGHT_SENSOR_EVT_BRIGHT)
+    {
+        thresholdState = MICROBIT_LIGHT_SENSOR_EVT_BRIGHT;
+        MicroBitEvent(MICROBIT_ID_LIGHT_SENSOR, MICROBIT_LIGHT_SENSOR_EVT_BRIGHT);
+    }
 }
 
 /**
@@ -90,14 +194,25 @@ MicroBitLightSensor::MicroBitLightSensor(const MatrixMap &map) :
     for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
         results[i] = 0;
 
+    this->continuous = false;
+    this->sampleAll = false;
+
+    // Until the first reading arrives, report the level that no readings give (255), as read() always has.
+    this->filtered = level() << 8;
+    this->smoothing = MICROBIT_LIGHT_SENSOR_SMOOTHING;
+    this->historyHead = 0;
+    this->historyLength = 0;
+    this->darkThreshold = -1;
+    this->brightThreshold = -1;
+    this->thresholdState = 0;
+
     if (EventModel::defaultEventBus)
         EventModel::defaultEventBus->listen(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, this, &MicroBitLightSensor::startSensing, MESSAGE_BUS_LISTENER_IMMEDIATE);
-
-    this->sensePin = NULL;
 }
 
 /**
-  * This method returns a summed average of the three sections of the display.
+  * This method returns the light level, smoothed as configured by setSmoothing(), from a summed
+  * average of the three sections of the display.
   *
   * A section is defined as:
   *  ___________________
@@ -119,26 +234,100 @@ MicroBitLightSensor::MicroBitLightSensor(const MatrixMap &map) :
   */
 int MicroBitLightSensor::read()
 {
-    int sum = 0;
+    return filtered >> 8;
+}
 
-    for(int i = 0; i < MICROBIT_LIGHT_SENSOR_CHAN_NUM; i++)
-        sum += results[i];
+/**
+  * Selects whether every section of the display is sampled each time the display pauses to sense light,
+  * rather than a single section each time. This doesn't sense any more often: the display still pauses
+  * for light sensing at the same rate. But as each pause then updates all three sections, the light level
+  * follows a change in about a third of the time, at the cost of a little more time spent in interrupt context.
+  *
+  * @param enable true to sample every section each time, false to sample one section at a time.
+  */
+void MicroBitLightSensor::setContinuous(bool enable)
+{
+    continuous = enable;
+}
 
-    int average = sum / MICROBIT_LIGHT_SENSOR_CHAN_NUM;
+/**
+  * Configures the smoothing applied to the light level. Each new reading moves the smoothed level
+  * 1 / 2^shift of the way towards it.
+  *
+  * @param shift the amount of smoothing, in the range 0 (none) to 7.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitLightSensor::setSmoothing(int shift)
+{
+    if (shift < 0 || shift > 7)
+        return MICROBIT_INVALID_PARAMETER;
 
-    average = min(average, MICROBIT_LIGHT_SENSOR_MAX_VALUE);
+    smoothing = shift;
 
-    average = max(average, MICROBIT_LIGHT_SENSOR_MIN_VALUE);
+    return MICROBIT_OK;
+}
 
-    int inverted = (MICROBIT_LIGHT_SENSOR_MAX_VALUE - average) + MICROBIT_LIGHT_SENSOR_MIN_VALUE;
+/**
+  * Configures threshold events. MICROBIT_LIGHT_SENSOR_EVT_DARK is raised when the smoothed light level
+  * falls to the dark threshold, and MICROBIT_LIGHT_SENSOR_EVT_BRIGHT when it rises to the bright threshold.
+  * Each is only raised again once the other has been, so the gap between them acts as hysteresis.
+  * With only one threshold set, its event is raised again once the level has moved back past it by
+  * MICROBIT_LIGHT_SENSOR_HYSTERESIS and returned.
+  *
+  * @param dark the dark threshold, in the range 0 - 255, or -1 to disable dark events.
+  *
+  * @param bright the bright threshold, in the range 0 - 255, or -1 to disable bright events.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER if a threshold is out of range or dark is not below bright.
+  *
+  * @code
+  * uBit.display.getLightSensor().setThresholds(40, 120);
+  * uBit.messageBus.listen(MICROBIT_ID_LIGHT_SENSOR, MICROBIT_LIGHT_SENSOR_EVT_DARK, onDark);
+  * @endcode
+  */
+int MicroBitLightSensor::setThresholds(int dark, int bright)
+{
+    if (dark < -1 || dark > 255 || bright < -1 || bright > 255 || (dark >= 0 && bright >= 0 && dark >= bright))
+        return MICROBIT_INVALID_PARAMETER;
 
-    int a = 0;
+    __disable_irq();
+    darkThreshold = dark;
+    brightThreshold = bright;
+    thresholdState = 0;
+    __enable_irq();
 
-    int b = 255;
+    return MICROBIT_OK;
+}
 
-    int normalised = a + ((((inverted - MICROBIT_LIGHT_SENSOR_MIN_VALUE)) * (b - a))/ (MICROBIT_LIGHT_SENSOR_MAX_VALUE - MICROBIT_LIGHT_SENSOR_MIN_VALUE));
+/**
+  * Copies the most recent smoothed light levels, oldest first.
+  *
+  * @param buffer the buffer to fill.
+  *
+  * @param length the size of the buffer. Up to MICROBIT_LIGHT_SENSOR_HISTORY levels are available.
+  *
+  * @return the number of levels copied, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitLightSensor::getHistory(uint8_t *buffer, int length)
+{
+    if (buffer == NULL || length < 0)
+        return MICROBIT_INVALID_PARAMETER;
 
-    return normalised;
+    __disable_irq();
+
+    int count = min(length, (int)historyLength);
+    int index = (historyHead + MICROBIT_LIGHT_SENSOR_HISTORY - count) % MICROBIT_LIGHT_SENSOR_HISTORY;
+
+    for (int i = 0; i < count; i++)
+    {
+        buffer[i] = history[index];
+        index = (index + 1) % MICROBIT_LIGHT_SENSOR_HISTORY;
+    }
+
+    __enable_irq();
+
+    return count;
 }
 
 /**
@@ -154,16 +343,20 @@ void MicroBitLightSensor::startSensing(MicroBitEvent)
     for(int rowCount = 0; rowCount < matrixMap.rows; rowCount++)
         DigitalOut((PinName)(matrixMap.rowStart + rowCount)).write(0);
 
-    PinName currentPin = (PinName)(matrixMap.columnStart + chan);
+    // Decide once which channels this slot covers, as setContinuous() may be called before it completes.
+    sampleAll = continuous;
 
-    DigitalOut(currentPin).write(1);
+    int first = sampleAll ? 0 : chan;
+    int last = sampleAll ? MICROBIT_LIGHT_SENSOR_CHAN_NUM - 1 : chan;
 
-    DigitalIn(currentPin, PullNone).~DigitalIn();
+    for (int i = first; i <= last; i++)
+    {
+        PinName currentPin = (PinName)(matrixMap.columnStart + i);
 
-    if(this->sensePin != NULL)
-        delete this->sensePin;
+        DigitalOut(currentPin).write(1);
 
-    this->sensePin = new AnalogIn(currentPin);
+        DigitalIn(currentPin, PullNone).~DigitalIn();
+    }
 
     analogTrigger.attach_us(this, &MicroBitLightSensor::analogReady, MICROBIT_LIGHT_SENSOR_AN_SET_TIME);
 }
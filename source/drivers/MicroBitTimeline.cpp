@@ -0,0 +1,337 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a MicroBitTimeline.
+  *
+  * A timeline is a queue of display effects, played back by the display from its periodic interrupt.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitTimeline.h"
+#include "MicroBitDisplay.h"
+#include "MicroBitTextStrip.h"
+#include "MicroBitFont.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  * Creates an empty timeline.
+  */
+MicroBitTimeline::MicroBitTimeline()
+{
+    head = 0;
+    tail = 0;
+    started = false;
+    elapsed = 0;
+    position = 0;
+    remaining = 0;
+}
+
+/**
+  * Releases the images held by slots that the display has finished with.
+  * Called from fiber context, so images are never freed by the display's interrupt.
+  */
+void MicroBitTimeline::release()
+{
+    // The display only ever moves tail towards head, so every slot from head up to the current tail
+    // is either unused or already played, and can no longer be read.
+    int end = tail;
+    int i = head;
+
+    do
+    {
+        items[i].image = MicroBitImage();
+        i = (i + 1) % MICROBIT_TIMELINE_LENGTH;
+    } while (i != end);
+}
+
+/**
+  * Adds a precomputed item to the end of the queue.
+  *
+  * @return MICROBIT_OK, or MICROBIT_NO_RESOURCES if the queue is full.
+  */
+int MicroBitTimeline::queue(uint8_t type, MicroBitImage image, int duration, int a, int b, int stride, int32_t rate)
+{
+    int next = (head + 1) % MICROBIT_TIMELINE_LENGTH;
+
+    if (next == tail)
+        return MICROBIT_NO_RESOURCES;
+
+    // Drop any images left over from items that have been played since we last looked.
+    release();
+
+    // The slot at head is never read by the display, so can be filled in without locking.
+    MicroBitTimelineItem &item = items[head];
+
+    item.image = image;
+    item.duration = duration;
+    item.a = a;
+    item.b = b;
+    item.stride = stride;
+    item.type = type;
+    item.rate = rate;
+
+    // Only publish the item once it is complete.
+    __disable_irq();
+    head = next;
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Queues an image to be shown on the display for a given time.
+  *
+  * @param image The image to show.
+  *
+  * @param duration The time to show the image for, in milliseconds.
+  *
+  * @param x The horizontal position of the image on the display. Defaults to 0.
+  *
+  * @param y The vertical position of the image on the display. Defaults to 0.
+  *
+  * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+  */
+int MicroBitTimeline::addFrame(MicroBitImage image, int duration, int x, int y)
+{
+    if (duration < 0 || duration > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return queue(MICROBIT_TIMELINE_FRAME, image, duration, x, y, 0, 0);
+}
+
+/**
+  * Queues an image to be scrolled across the display.
+  *
+  * @param image The image to scroll.
+  *
+  * @param delay The time between each step of the scroll, in milliseconds. Defaults to MICROBIT_DEFAULT_SCROLL_SPEED.
+  *
+  * @param stride The number of pixels moved by each step. Negative values scroll from right to left.
+  *               Defaults to MICROBIT_DEFAULT_SCROLL_STRIDE.
+  *
+  * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+  */
+int MicroBitTimeline::addScroll(MicroBitImage image, int delay, int stride)
+{
+    if (delay <= 0 || delay > 0xFFFF || stride == 0 || stride < -127 || stride > 127)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // The image starts just off one edge of the display, and moves until it has left the other.
+    int distance = MICROBIT_DISPLAY_WIDTH + image.getWidth();
+    int steps = (distance + abs(stride) - 1) / abs(stride) + 1;
+    int start = stride < 0 ? MICROBIT_DISPLAY_WIDTH : -image.getWidth();
+
+    return queue(MICROBIT_TIMELINE_SCROLL, image, delay, start, steps, stride, 0);
+}
+
+/**
+  * Queues text to be scrolled across the display, from right to left.
+  * The text is rendered into an image immediately, so nothing is decoded during playback.
+  *
+  * @param s The text to scroll.
+  *
+  * @param delay The time between each step of the scroll, in milliseconds. Defaults to MICROBIT_DEFAULT_SCROLL_SPEED.
+  *
+  * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full
+  *         or the text could not be rendered.
+  */
+int MicroBitTimeline::addScroll(ManagedString s, int delay)
+{
+    if (delay <= 0 || delay > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    if (s.length() == 0)
+        return MICROBIT_OK;
+
+    MicroBitTextStrip strip;
+    int result = strip.layout(s, MICROBIT_DISPLAY_SCROLL_PROPORTIONAL);
+
+    if (result != MICROBIT_OK)
+        return result;
+
+    // Text is either on or off, so hold it packed at a bit per pixel.
+    int height = MicroBitFont::getSystemFont().getHeight();
+    MicroBitImage text(strip.getLength(), height, MICROBIT_IMAGE_FORMAT_1BPP);
+
+    for (int x = 0; x < strip.getLength(); x++)
+    {
+        uint8_t column = strip.getColumn(x);
+
+        for (int y = 0; y < height; y++)
+            if (column & (1 << y))
+                text.setPixelValue(x, y, 255);
+    }
+
+    return addScroll(text, delay, -1);
+}
+
+/**
+  * Queues a linear change in the brightness of the display.
+  *
+  * @param from The brightness at the start of the fade, in the range 0 - 255.
+  *
+  * @param to The brightness at the end of the fade, in the range 0 - 255.
+  *
+  * @param duration The length of the fade, in milliseconds.
+  *
+  * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+  */
+int MicroBitTimeline::addFade(int from, int to, int duration)
+{
+    if (from < 0 || from > 255 || to < 0 || to > 255 || duration < 0 || duration > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int32_t rate = duration ? (to - from) * 65536 / duration : 0;
+
+    return queue(MICROBIT_TIMELINE_FADE, MicroBitImage(), duration, from, to, 0, rate);
+}
+
+/**
+  * Queues a pause, during which the display is left unchanged.
+  *
+  * @param duration The length of the pause, in milliseconds.
+  *
+  * @return MICROBIT_OK, MICROBIT_INVALID_PARAMETER or MICROBIT_NO_RESOURCES if the timeline is full.
+  */
+int MicroBitTimeline::addPause(int duration)
+{
+    if (duration < 0 || duration > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return queue(MICROBIT_TIMELINE_PAUSE, MicroBitImage(), duration, 0, 0, 0, 0);
+}
+
+/**
+  * Determines the number of items waiting to be played, including any item currently playing.
+  */
+int MicroBitTimeline::getLength()
+{
+    return (head + MICROBIT_TIMELINE_LENGTH - tail) % MICROBIT_TIMELINE_LENGTH;
+}
+
+/**
+  * Removes all items from the timeline. If the timeline is playing, it completes on the next tick.
+  */
+void MicroBitTimeline::clear()
+{
+    __disable_irq();
+    tail = head;
+    started = false;
+    __enable_irq();
+
+    // Nothing is queued now, so the display no longer refers to any of the items.
+    release();
+}
+
+/**
+  * Shows the first step of the given item on the display.
+  */
+void MicroBitTimeline::start(MicroBitDisplay &display, MicroBitTimelineItem &item)
+{
+    elapsed = 0;
+
+    switch (item.type)
+    {
+        case MICROBIT_TIMELINE_FRAME:
+            display.image.clear();
+            display.image.paste(item.image, item.a, item.b, 0);
+            break;
+
+        case MICROBIT_TIMELINE_SCROLL:
+            position = item.a;
+            remaining = item.b;
+            display.image.clear();
+            display.image.paste(item.image, position, 0, 0);
+            break;
+
+        case MICROBIT_TIMELINE_FADE:
+            display.setBrightness(item.a);
+            break;
+    }
+}
+
+/**
+  * Advances playback. Called by the display from interrupt context on each animation tick.
+  *
+  * @param display The display to update.
+  *
+  * @param period The time since the last call, in milliseconds.
+  *
+  * @return true if the timeline is still playing, false once all items have been played.
+  */
+bool MicroBitTimeline::update(MicroBitDisplay &display, int period)
+{
+    while (tail != head)
+    {
+        MicroBitTimelineItem &item = items[tail];
+
+        if (!started)
+        {
+            start(display, item);
+            started = true;
+            return true;
+        }
+
+        elapsed += period;
+
+        if (item.type == MICROBIT_TIMELINE_SCROLL)
+        {
+            if (elapsed < item.duration)
+                return true;
+
+            elapsed = 0;
+
+            if (--remaining > 0)
+            {
+                position += item.stride;
+                display.image.clear();
+                display.image.paste(item.image, position, 0, 0);
+                return true;
+            }
+        }
+        else
+        {
+            if (elapsed < item.duration)
+            {
+                if (item.type == MICROBIT_TIMELINE_FADE)
+                    display.setBrightness(item.a + ((elapsed * item.rate) >> 16));
+
+                return true;
+            }
+
+            if (item.type == MICROBIT_TIMELINE_FADE)
+                display.setBrightness(item.b);
+        }
+
+        // This item is complete, so move straight on to the next, to avoid a gap between them.
+        // The item's image is left in place, and released by the next fiber to queue an item or clear the timeline.
+        started = false;
+        tail = (tail + 1) % MICROBIT_TIMELINE_LENGTH;
+    }
+
+    return false;
+}
@@ -49,6 +49,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "ManagedString.h"
 #include "MicroBitCompat.h"
+#include "MicroBitArena.h"
 
 static const char empty[] __attribute__ ((aligned (4))) = "\xff\xff\0\0\0";
 
@@ -72,7 +73,7 @@ void ManagedString::initString(const char *str)
     // Initialise this ManagedString as a new string, using the data provided.
     // We assume the string is sane, and null terminated.
     int len = strlen(str);
-    ptr = (StringData *) malloc(4+len+1);
+    ptr = (StringData *) microbit_arena_malloc(4+len+1);
     ptr->init();
     ptr->len = len;
     memcpy(ptr->data, str, len+1);
@@ -192,7 +193,7 @@ ManagedString::ManagedString(const ManagedString &s1, const ManagedString &s2)
     int len = s1.length() + s2.length();
 
     // Create a new buffer for holding the new string data.
-    ptr = (StringData*) malloc(4+len+1);
+    ptr = (StringData*) microbit_arena_malloc(4+len+1);
     ptr->init();
     ptr->len = len;
 
@@ -222,7 +223,7 @@ ManagedString::ManagedString(PacketBuffer buffer)
     }
 
     // Allocate a new buffer ( just in case the data is not NULL terminated).
-    ptr = (StringData*) malloc(4+buffer.length()+1);
+    ptr = (StringData*) microbit_arena_malloc(4+buffer.length()+1);
     ptr->init();
 
     // Store the length of the new string
@@ -257,7 +258,7 @@ ManagedString::ManagedString(const char *str, const int16_t length)
 
 
     // Allocate a new buffer, and create a NULL terminated string.
-    ptr = (StringData*) malloc(4+length+1);
+    ptr = (StringData*) microbit_arena_malloc(4+length+1);
     ptr->init();
     // Store the length of the new string
     ptr->len = length;
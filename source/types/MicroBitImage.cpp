@@ -27,7 +27,7 @@ DEALINGS IN THE SOFTWARE.
   * Class definition for a MicroBitImage.
   *
   * An MicroBitImage is a simple bitmap representation of an image.
-  * n.b. This is a mutable, managed type.
+  * n.b. This is a mutable, managed type. Copies share the same bitmap until one of them is modified.
   */
 
 #include "MicroBitConfig.h"
@@ -36,6 +36,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitCompat.h"
 #include "ManagedString.h"
 #include "ErrorNo.h"
+#include "MicroBitArena.h"
 
 
 /**
@@ -44,6 +45,274 @@ DEALINGS IN THE SOFTWARE.
 static const uint16_t empty[] __attribute__ ((aligned (4))) = { 0xffff, 1, 1, 0, };
 MicroBitImage MicroBitImage::EmptyImage((ImageData*)(void*)empty);
 
+/**
+  * The number of bits used to store each pixel in each ImageFormat.
+  */
+static const uint8_t bitsPerPixel[] = { 8, 4, 1 };
+
+/**
+  * Reads a single pixel from a row of a bitmap, in the range 0..255.
+  */
+static inline uint8_t readPixel(const uint8_t *row, int x, int format)
+{
+    if (format == MICROBIT_IMAGE_FORMAT_1BPP)
+        return (row[x >> 3] & (1 << (x & 7))) ? 255 : 0;
+
+    if (format == MICROBIT_IMAGE_FORMAT_4BPP)
+        return ((row[x >> 1] >> ((x & 1) << 2)) & 0x0f) * 17;
+
+    return row[x];
+}
+
+/**
+  * Writes a single pixel, in the range 0..255, into a row of a bitmap.
+  * Any non-zero value remains visible once packed.
+  */
+static inline void writePixel(uint8_t *row, int x, int format, uint8_t value)
+{
+    if (format == MICROBIT_IMAGE_FORMAT_1BPP)
+    {
+        if (value)
+            row[x >> 3] |= (1 << (x & 7));
+        else
+            row[x >> 3] &= ~(1 << (x & 7));
+    }
+    else if (format == MICROBIT_IMAGE_FORMAT_4BPP)
+    {
+        int shift = (x & 1) << 2;
+        row[x >> 1] = (row[x >> 1] & ~(0x0f << shift)) | (((value + 16) / 17) << shift);
+    }
+    else
+    {
+        row[x] = value;
+    }
+}
+
+/**
+  * Reads up to eight bits from a packed row, starting at the given bit offset.
+  */
+static inline uint8_t readBits(const uint8_t *row, int bit, int n)
+{
+    const uint8_t *p = row + (bit >> 3);
+    uint16_t v = p[0];
+
+    if ((bit & 7) + n > 8)
+        v |= p[1] << 8;
+
+    return (v >> (bit & 7)) & ((1 << n) - 1);
+}
+
+/**
+  * Writes up to eight bits into a packed row, starting at the given bit offset.
+  * Only the bits set in the mask are changed.
+  */
+static inline void writeBits(uint8_t *row, int bit, int n, uint8_t value, uint8_t mask)
+{
+    uint8_t *p = row + (bit >> 3);
+    uint16_t m = mask << (bit & 7);
+    uint16_t v = (value & mask) << (bit & 7);
+
+    p[0] = (p[0] & ~m) | v;
+
+    if ((bit & 7) + n > 8)
+        p[1] = (p[1] & ~(m >> 8)) | (v >> 8);
+}
+
+/**
+  * Calculates a mask of the non-zero pixels in a group of up to eight packed bits.
+  */
+static inline uint8_t pixelMask(uint8_t v, int bpp)
+{
+    if (bpp == 4)
+        return ((v & 0x0f) ? 0x0f : 0) | ((v & 0xf0) ? 0xf0 : 0);
+
+    return v;
+}
+
+/**
+  * Copies a run of bits between two packed rows (which may be the same row), optionally
+  * leaving the destination untouched wherever the source pixel is zero.
+  *
+  * @return the number of pixels written.
+  */
+static int blitBits(uint8_t *dst, int dbit, const uint8_t *src, int sbit, int bits, int bpp, bool alpha)
+{
+    int written = 0;
+    bool backwards = (dst == src && dbit > sbit);
+
+    for (int i = 0; i < bits; i += 8)
+    {
+        // When moving bits up within the same row, work from the end so nothing is overwritten before it is read.
+        int offset = backwards ? max(bits - i - 8, 0) : i;
+        int n = min(bits - i, 8);
+        uint8_t v = readBits(src, sbit + offset, n);
+        uint8_t mask = alpha ? pixelMask(v, bpp) : (1 << n) - 1;
+
+        writeBits(dst, dbit + offset, n, v, mask);
+
+        for (uint8_t m = mask; m; m >>= bpp)
+            if (m & 0x01)
+                written++;
+    }
+
+    return written;
+}
+
+/**
+  * Copies a run of one byte per pixel data (which may overlap itself), leaving the destination untouched
+  * wherever the source pixel is zero. Runs of MICROBIT_IMAGE_BLIT_WORD_MIN pixels or more are handled
+  * four pixels at a time using word operations, without a branch per pixel.
+  *
+  * @return the number of pixels written.
+  */
+static int blitAlpha(uint8_t *dst, const uint8_t *src, int n)
+{
+    int written = 0;
+
+    // When moving pixels right within the same row, work from the end so nothing is overwritten before it is read.
+    if (dst > src && dst < src + n)
+    {
+        while (n-- > 0)
+        {
+            if (src[n])
+            {
+                dst[n] = src[n];
+                written++;
+            }
+        }
+
+        return written;
+    }
+
+    // Short runs, such as the rows of a glyph, don't repay the cost of aligning the destination.
+    if (n < MICROBIT_IMAGE_BLIT_WORD_MIN)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (src[i])
+            {
+                dst[i] = src[i];
+                written++;
+            }
+        }
+
+        return written;
+    }
+
+    // Cortex-M0 can't store words to unaligned addresses, so go byte by byte until the destination is aligned.
+    while ((uintptr_t)dst & 0x03)
+    {
+        if (*src)
+        {
+            *dst = *src;
+            written++;
+        }
+
+        dst++;
+        src++;
+        n--;
+    }
+
+    while (n >= 4)
+    {
+        uint32_t s;
+        memcpy(&s, src, 4);
+
+        // Set the top bit of every byte of the source that is non-zero.
+        uint32_t nz = (((s & 0x7f7f7f7f) + 0x7f7f7f7f) | s) & 0x80808080;
+
+        if (nz)
+        {
+            // Widen those bits into a mask of whole bytes, and merge.
+            uint32_t mask = (nz >> 7) * 0xff;
+            uint32_t *d = (uint32_t *)dst;
+
+            *d = (*d & ~mask) | (s & mask);
+            written += ((nz >> 7) * 0x01010101) >> 24;
+        }
+
+        dst += 4;
+        src += 4;
+        n -= 4;
+    }
+
+    while (n > 0)
+    {
+        if (*src)
+        {
+            *dst = *src;
+            written++;
+        }
+
+        dst++;
+        src++;
+        n--;
+    }
+
+    return written;
+}
+
+/**
+  * Clears a run of bits in a packed row.
+  */
+static void clearBits(uint8_t *row, int bit, int bits)
+{
+    for (int i = 0; i < bits; i += 8)
+    {
+        int n = min(bits - i, 8);
+        writeBits(row, bit + i, n, 0, (1 << n) - 1);
+    }
+}
+
+/**
+  * Fills a run of pixels in a row of a bitmap with a single value, in the range 0..255.
+  * Packed rows are written a whole byte at a time, apart from any partial bytes at either end.
+  */
+static void fillPixels(uint8_t *row, int x, int n, int format, uint8_t value)
+{
+    if (format == MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        memset(row + x, value, n);
+        return;
+    }
+
+    // Build a byte holding the packed value in every pixel position.
+    int bpp = bitsPerPixel[format];
+    uint8_t pattern = (format == MICROBIT_IMAGE_FORMAT_1BPP) ? (value ? 0xff : 0x00) : ((value + 16) / 17) * 0x11;
+
+    int bit = x * bpp;
+    int bits = n * bpp;
+
+    if (bit & 7)
+    {
+        int k = min(8 - (bit & 7), bits);
+        writeBits(row, bit, k, pattern, (1 << k) - 1);
+        bit += k;
+        bits -= k;
+    }
+
+    memset(row + (bit >> 3), pattern, bits >> 3);
+    bit += bits & ~7;
+    bits &= 7;
+
+    if (bits)
+        writeBits(row, bit, bits, pattern, (1 << bits) - 1);
+}
+
+/**
+  * Calculates the level a value is stored at once packed into the given format.
+  */
+static inline uint8_t packedLevel(uint8_t value, int format)
+{
+    if (format == MICROBIT_IMAGE_FORMAT_1BPP)
+        return value ? 255 : 0;
+
+    if (format == MICROBIT_IMAGE_FORMAT_4BPP)
+        return ((value + 16) / 17) * 17;
+
+    return value;
+}
+
 /**
   * Default Constructor.
   * Creates a new reference to the empty MicroBitImage bitmap
@@ -83,6 +352,25 @@ MicroBitImage::MicroBitImage(const int16_t x, const int16_t y)
     this->init(x,y,NULL);
 }
 
+/**
+  * Constructor.
+  * Create a blank bitmap representation of a given size, stored in the given pixel format.
+  *
+  * @param x the width of the image.
+  *
+  * @param y the height of the image.
+  *
+  * @param format the pixel format to store the image in.
+  *
+  * @code
+  * MicroBitImage i(100, 5, MICROBIT_IMAGE_FORMAT_1BPP); // a monochrome scroll buffer, in 65 bytes rather than 500.
+  * @endcode
+  */
+MicroBitImage::MicroBitImage(const int16_t x, const int16_t y, ImageFormat format)
+{
+    this->init(x,y,NULL,format);
+}
+
 /**
   * Copy Constructor.
   * Add ourselves as a reference to an existing MicroBitImage.
@@ -204,6 +492,8 @@ MicroBitImage::MicroBitImage(const char *s)
   * static const uint8_t heart[] __attribute__ ((aligned (4))) = { 0xff, 0xff, 10, 0, 5, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, }; // a cute heart
   * MicroBitImage i((ImageData*)(void*)heart);
   * @endcode
+  *
+  * @note MICROBIT_IMAGE_LITERAL() builds such a literal at compile time, and MICROBIT_IMAGE() wraps it in an image.
   */
 MicroBitImage::MicroBitImage(ImageData *p)
 {
@@ -275,31 +565,35 @@ void MicroBitImage::init_empty()
   *
   * @param y the height of the image
   *
-  * @param bitmap an array of integers that make up an image.
+  * @param bitmap an array of integers that make up an image, one byte per pixel.
+  *
+  * @param format the pixel format the image is stored in.
   */
-void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap)
+void MicroBitImage::init(const int16_t x, const int16_t y, const uint8_t *bitmap, ImageFormat format)
 {
     //sanity check size of image - you cannot have a negative sizes
-    if(x < 0 || y < 0)
+    if(x < 0 || y < 0 || y > 0x0fff || format > MICROBIT_IMAGE_FORMAT_1BPP)
     {
         init_empty();
         return;
     }
 
+    int stride = (x * bitsPerPixel[format] + 7) >> 3;
 
     // Create a copy of the array
-    ptr = (ImageData*)malloc(sizeof(ImageData) + x * y);
+    ptr = (ImageData*)microbit_arena_malloc(sizeof(ImageData) + stride * y);
     ptr->init();
     ptr->width = x;
     ptr->height = y;
+    ptr->format = format;
 
     // create a linear buffer to represent the image. We could use a jagged/2D array here, but experimentation
     // showed this had a negative effect on memory management (heap fragmentation etc).
+    // Packed formats rely on any unused bits at the end of each row being kept clear.
+    this->clear();
 
     if (bitmap)
         this->printImage(x,y,bitmap);
-    else
-        this->clear();
 }
 
 /**
@@ -356,7 +650,7 @@ bool MicroBitImage::operator== (const MicroBitImage& i)
     if (ptr == i.ptr)
         return true;
     else
-        return (ptr->width == i.ptr->width && ptr->height == i.ptr->height && (memcmp(getBitmap(), i.ptr->data, getSize())==0));
+        return (ptr->width == i.ptr->width && ptr->height == i.ptr->height && ptr->format == i.ptr->format && (memcmp(getBitmap(), i.ptr->data, getSize())==0));
 }
 
 
@@ -370,6 +664,7 @@ bool MicroBitImage::operator== (const MicroBitImage& i)
   */
 void MicroBitImage::clear()
 {
+    detach();
     memclr(getBitmap(), getSize());
 }
 
@@ -397,7 +692,8 @@ int MicroBitImage::setPixelValue(int16_t x , int16_t y, uint8_t value)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    this->getBitmap()[y*getWidth()+x] = value;
+    detach();
+    writePixel(this->getBitmap() + y*getStride(), x, ptr->format, value);
     return MICROBIT_OK;
 }
 
@@ -421,7 +717,7 @@ int MicroBitImage::getPixelValue(int16_t x , int16_t y)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    return this->getBitmap()[y*getWidth()+x];
+    return readPixel(this->getBitmap() + y*getStride(), x, ptr->format);
 }
 
 /**
@@ -454,6 +750,8 @@ int MicroBitImage::printImage(int16_t width, int16_t height, const uint8_t *bitm
     if (width <= 0 || height <= 0 || bitmap == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
+    detach();
+
     // Calculate sane start pointer.
     pixelsToCopyX = min(width,this->getWidth());
     pixelsToCopyY = min(height,this->getHeight());
@@ -464,9 +762,14 @@ int MicroBitImage::printImage(int16_t width, int16_t height, const uint8_t *bitm
     // Copy the image, stride by stride.
     for (int i=0; i<pixelsToCopyY; i++)
     {
-        memcpy(pOut, pIn, pixelsToCopyX);
+        if (ptr->format == MICROBIT_IMAGE_FORMAT_8BPP)
+            memcpy(pOut, pIn, pixelsToCopyX);
+        else
+            for (int j=0; j<pixelsToCopyX; j++)
+                writePixel(pOut, j, ptr->format, pIn[j]);
+
         pIn += width;
-        pOut += this->getWidth();
+        pOut += this->getStride();
     }
 
     return MICROBIT_OK;
@@ -496,57 +799,117 @@ int MicroBitImage::printImage(int16_t width, int16_t height, const uint8_t *bitm
 int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8_t alpha)
 {
     uint8_t *pIn, *pOut;
-    int cx, cy;
+    int cx, cy, sx, dx;
+    int inStride, outStride;
     int pxWritten = 0;
+    int srcFormat = image.ptr->format;
+    int dstFormat = ptr->format;
 
     // Sanity check.
     // We permit writes that overlap us, but ones that are clearly out of scope we can filter early.
     if (x >= getWidth() || y >= getHeight() || x+image.getWidth() <= 0 || y+image.getHeight() <= 0)
         return 0;
 
+    // n.b. if we're pasting into ourselves, the source follows us to our private copy.
+    detach();
+
     //Calculate the number of byte we need to copy in each dimension.
     cx = x < 0 ? min(image.getWidth() + x, getWidth()) : min(image.getWidth(), getWidth() - x);
     cy = y < 0 ? min(image.getHeight() + y, getHeight()) : min(image.getHeight(), getHeight() - y);
 
-    // Calculate sane start pointer.
+    // Calculate sane start pointers, to the first row to copy, and the first column within those rows.
+    sx = (x < 0) ? -x : 0;
+    dx = (x > 0) ? x : 0;
+
     pIn = image.ptr->data;
-    pIn += (x < 0) ? -x : 0;
-    pIn += (y < 0) ? -image.getWidth()*y : 0;
+    pIn += (y < 0) ? -image.getStride()*y : 0;
 
     pOut = getBitmap();
-    pOut += (x > 0) ? x : 0;
-    pOut += (y > 0) ? getWidth()*y : 0;
+    pOut += (y > 0) ? getStride()*y : 0;
+
+    inStride = image.getStride();
+    outStride = getStride();
+
+    // Whole rows of the same format with nothing transparent form one contiguous block.
+    // An image may be pasted into itself, so allow the copy to overlap.
+    if (srcFormat == dstFormat && !alpha && cx == getWidth() && cx == image.getWidth())
+    {
+        memmove(pOut, pIn, cy * outStride);
+        return cx * cy;
+    }
+
+    // When an image is pasted into itself further down, work from the bottom row up, so nothing is
+    // overwritten before it is read. Overlap along a row is left to the copy of each row.
+    if (this == &image && y > 0)
+    {
+        pIn += inStride * (cy - 1);
+        pOut += outStride * (cy - 1);
+        inStride = -inStride;
+        outStride = -outStride;
+    }
 
     // Copy the image, stride by stride
+    // If both images share a packed format, copy whole groups of bits at a time.
+    // If the formats differ, convert each pixel as we go.
     // If we want primitive transparecy, we do this byte by byte.
     // If we don't, use a more efficient block memory copy instead. Every little helps!
 
-    if (alpha)
+    if (srcFormat != dstFormat)
     {
         for (int i=0; i<cy; i++)
         {
             for (int j=0; j<cx; j++)
             {
-                // Copy this byte if appropriate.
-                if (*(pIn+j) != 0){
-                    *(pOut+j) = *(pIn+j);
+                uint8_t v = readPixel(pIn, sx+j, srcFormat);
+
+                if (v != 0 || !alpha)
+                {
+                    writePixel(pOut, dx+j, dstFormat, v);
                     pxWritten++;
                 }
             }
 
-            pIn += image.getWidth();
-            pOut += getWidth();
+            pIn += inStride;
+            pOut += outStride;
+        }
+    }
+    else if (srcFormat != MICROBIT_IMAGE_FORMAT_8BPP)
+    {
+        int bpp = bitsPerPixel[srcFormat];
+
+        for (int i=0; i<cy; i++)
+        {
+            pxWritten += blitBits(pOut, dx*bpp, pIn, sx*bpp, cx*bpp, bpp, alpha);
+
+            pIn += inStride;
+            pOut += outStride;
+        }
+    }
+    else if (alpha)
+    {
+        pIn += sx;
+        pOut += dx;
+
+        for (int i=0; i<cy; i++)
+        {
+            pxWritten += blitAlpha(pOut, pIn, cx);
+
+            pIn += inStride;
+            pOut += outStride;
         }
     }
     else
     {
+        pIn += sx;
+        pOut += dx;
+
         for (int i=0; i<cy; i++)
         {
-            memcpy(pOut, pIn, cx);
+            memmove(pOut, pIn, cx);
 
             pxWritten += cx;
-            pIn += image.getWidth();
-            pOut += getWidth();
+            pIn += inStride;
+            pOut += outStride;
         }
     }
 
@@ -571,40 +934,441 @@ int MicroBitImage::paste(const MicroBitImage &image, int16_t x, int16_t y, uint8
   */
 int MicroBitImage::print(char c, int16_t x, int16_t y)
 {
-    unsigned char v;
+    return printCharacter((uint8_t)c, x, y);
+}
+
+/**
+  * Prints the glyph for a character code of the system font at the given location.
+  *
+  * The glyph is centred in a cell as wide as the widest glyph of the font, and the rest of the cell is cleared.
+  *
+  * @param c The character code to display, such as one returned by MicroBitFont::nextCharacter().
+  *
+  * @param x The x co-ordinate of on the image to place the top left of the character cell. Defaults to 0.
+  *
+  * @param y The y co-ordinate of on the image to place the top left of the character cell. Defaults to 0.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.printCharacter(0xe9); // é, if the system font includes it
+  * @endcode
+  */
+int MicroBitImage::printCharacter(uint16_t c, int16_t x, int16_t y)
+{
+    uint8_t glyph[MICROBIT_FONT_MAX_WIDTH];
     int x1, y1;
 
     MicroBitFont font = MicroBitFont::getSystemFont();
+    int width = font.getColumns(c, glyph);
+    int cell = font.getWidth();
+    int height = font.getHeight();
 
     // Sanity check. Silently ignore anything out of bounds.
-    if (x >= getWidth() || y >= getHeight() || c < MICROBIT_FONT_ASCII_START || c > font.asciiEnd)
+    if (x >= getWidth() || y >= getHeight() || width < 0)
         return MICROBIT_INVALID_PARAMETER;
 
+    detach();
+
+    int offset = (cell - width) / 2;
+
     // Paste.
-    int offset = (c-MICROBIT_FONT_ASCII_START) * 5;
+    for (int col = 0; col < cell; col++)
+    {
+        // Update our X co-ord write position
+        x1 = x+col;
+
+        if (x1 < 0 || x1 >= getWidth())
+            continue;
+
+        uint8_t column = (col >= offset && col < offset + width) ? glyph[col - offset] : 0;
+
+        for (int row=0; row<height; row++)
+        {
+            // Update our Y co-ord write position
+            y1 = y+row;
+
+            if (y1 >= 0 && y1 < getHeight())
+                writePixel(this->getBitmap() + y1*getStride(), x1, ptr->format, (column & (1 << row)) ? 255 : 0);
+        }
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Fills a rectangular area of this image with a single value.
+  *
+  * The rectangle is clipped to the bounds of the image once, and each row is then filled as a single run.
+  *
+  * @param x The leftmost co-ordinate of the rectangle.
+  *
+  * @param y The uppermost co-ordinate of the rectangle.
+  *
+  * @param width The width of the rectangle.
+  *
+  * @param height The height of the rectangle.
+  *
+  * @param value The brightness level 0-255 to fill with.
+  *
+  * @return MICROBIT_OK on success (including when the rectangle lies wholly outside the image),
+  *         or MICROBIT_INVALID_PARAMETER if the width or height is negative.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.fillRect(1, 1, 3, 3, 255); // a 3x3 square in the middle of the image
+  * @endcode
+  */
+int MicroBitImage::fillRect(int16_t x, int16_t y, int16_t width, int16_t height, uint8_t value)
+{
+    if (width < 0 || height < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Clip the rectangle to the bounds of the image.
+    int x0 = max(x, 0);
+    int y0 = max(y, 0);
+    int x1 = min(x + width, getWidth());
+    int y1 = min(y + height, getHeight());
 
-    for (int row=0; row<MICROBIT_FONT_HEIGHT; row++)
+    if (x0 >= x1 || y0 >= y1)
+        return MICROBIT_OK;
+
+    detach();
+
+    int stride = getStride();
+    uint8_t *row = getBitmap() + y0 * stride;
+
+    for (int j = y0; j < y1; j++)
+    {
+        fillPixels(row, x0, x1 - x0, ptr->format, value);
+        row += stride;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Draws a horizontal line, clipped to the bounds of this image.
+  *
+  * @param x The leftmost co-ordinate of the line.
+  *
+  * @param y The co-ordinate of the row to draw on.
+  *
+  * @param length The number of pixels in the line.
+  *
+  * @param value The brightness level 0-255 to draw with.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the length is negative.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.drawHLine(0, 2, 5, 255);
+  * @endcode
+  */
+int MicroBitImage::drawHLine(int16_t x, int16_t y, int16_t length, uint8_t value)
+{
+    return fillRect(x, y, length, 1, value);
+}
+
+/**
+  * Draws a vertical line, clipped to the bounds of this image.
+  *
+  * @param x The co-ordinate of the column to draw on.
+  *
+  * @param y The uppermost co-ordinate of the line.
+  *
+  * @param length The number of pixels in the line.
+  *
+  * @param value The brightness level 0-255 to draw with.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the length is negative.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.drawVLine(2, 0, 5, 255);
+  * @endcode
+  */
+int MicroBitImage::drawVLine(int16_t x, int16_t y, int16_t length, uint8_t value)
+{
+    return fillRect(x, y, 1, length, value);
+}
+
+/**
+  * Draws a straight line between two points, inclusive, using Bresenham's algorithm.
+  *
+  * Horizontal and vertical lines are filled as runs. Other lines that lie wholly inside the image are
+  * drawn without checking the bounds of each pixel, and those wholly outside are rejected up front.
+  *
+  * @param x0 The x co-ordinate of the start of the line.
+  *
+  * @param y0 The y co-ordinate of the start of the line.
+  *
+  * @param x1 The x co-ordinate of the end of the line.
+  *
+  * @param y1 The y co-ordinate of the end of the line.
+  *
+  * @param value The brightness level 0-255 to draw with.
+  *
+  * @return MICROBIT_OK.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.drawLine(0, 0, 4, 4, 255); // a diagonal line across the image
+  * @endcode
+  */
+int MicroBitImage::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t value)
+{
+    if (y0 == y1)
+        return drawHLine(min(x0, x1), y0, abs(x1 - x0) + 1, value);
+
+    if (x0 == x1)
+        return drawVLine(x0, min(y0, y1), abs(y1 - y0) + 1, value);
+
+    int width = getWidth();
+    int height = getHeight();
+
+    // Reject lines whose bounding box misses the image entirely.
+    if (max(x0, x1) < 0 || min(x0, x1) >= width || max(y0, y1) < 0 || min(y0, y1) >= height)
+        return MICROBIT_OK;
+
+    bool inside = min(x0, x1) >= 0 && max(x0, x1) < width && min(y0, y1) >= 0 && max(y0, y1) < height;
+
+    detach();
+
+    int format = ptr->format;
+    int stride = getStride();
+    uint8_t *bitmap = getBitmap();
+
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    int x = x0;
+    int y = y0;
+
+    while (true)
     {
-        v = (char)*(font.characters + offset);
+        if (inside || (x >= 0 && x < width && y >= 0 && y < height))
+            writePixel(bitmap + y * stride, x, format, value);
 
-        offset++;
+        if (x == x1 && y == y1)
+            break;
 
-        // Update our Y co-ord write position
-        y1 = y+row;
+        int e2 = 2 * err;
 
-        for (int col = 0; col < MICROBIT_FONT_WIDTH; col++)
+        if (e2 >= dy)
         {
-            // Update our X co-ord write position
-            x1 = x+col;
+            err += dy;
+            x += sx;
+        }
 
-            if (x1 < getWidth() && y1 < getHeight())
-                this->getBitmap()[y1*getWidth()+x1] = (v & (0x10 >> col)) ? 255 : 0;
+        if (e2 <= dx)
+        {
+            err += dx;
+            y += sy;
         }
     }
 
     return MICROBIT_OK;
 }
 
+/**
+  * Draws a circle, using the midpoint circle algorithm.
+  *
+  * A filled circle is drawn as one clipped run per row. The outline of a circle that lies wholly inside the
+  * image is drawn without checking the bounds of each pixel, and one wholly outside is rejected up front.
+  *
+  * @param x The x co-ordinate of the centre of the circle.
+  *
+  * @param y The y co-ordinate of the centre of the circle.
+  *
+  * @param radius The radius of the circle, in pixels.
+  *
+  * @param value The brightness level 0-255 to draw with.
+  *
+  * @param fill true to fill the circle, false to draw only its outline. Defaults to false.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the radius is negative.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.drawCircle(2, 2, 2, 255);
+  * @endcode
+  */
+int MicroBitImage::drawCircle(int16_t x, int16_t y, int16_t radius, uint8_t value, bool fill)
+{
+    if (radius < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int width = getWidth();
+    int height = getHeight();
+
+    if (x + radius < 0 || x - radius >= width || y + radius < 0 || y - radius >= height)
+        return MICROBIT_OK;
+
+    bool inside = x - radius >= 0 && x + radius < width && y - radius >= 0 && y + radius < height;
+
+    detach();
+
+    int format = ptr->format;
+    int stride = getStride();
+    uint8_t *bitmap = getBitmap();
+
+    int dx = radius;
+    int dy = 0;
+    int err = 1 - radius;
+
+    while (dx >= dy)
+    {
+        if (fill)
+        {
+            fillRect(x - dx, y + dy, 2 * dx + 1, 1, value);
+            fillRect(x - dx, y - dy, 2 * dx + 1, 1, value);
+            fillRect(x - dy, y + dx, 2 * dy + 1, 1, value);
+            fillRect(x - dy, y - dx, 2 * dy + 1, 1, value);
+        }
+        else
+        {
+            // Plot the point in each of the eight octants.
+            const int16_t px[8] = { (int16_t)(x + dx), (int16_t)(x - dx), (int16_t)(x + dx), (int16_t)(x - dx), (int16_t)(x + dy), (int16_t)(x - dy), (int16_t)(x + dy), (int16_t)(x - dy) };
+            const int16_t py[8] = { (int16_t)(y + dy), (int16_t)(y + dy), (int16_t)(y - dy), (int16_t)(y - dy), (int16_t)(y + dx), (int16_t)(y + dx), (int16_t)(y - dx), (int16_t)(y - dx) };
+
+            for (int i = 0; i < 8; i++)
+                if (inside || (px[i] >= 0 && px[i] < width && py[i] >= 0 && py[i] < height))
+                    writePixel(bitmap + py[i] * stride, px[i], format, value);
+        }
+
+        dy++;
+
+        if (err < 0)
+        {
+            err += 2 * dy + 1;
+        }
+        else
+        {
+            dx--;
+            err += 2 * (dy - dx) + 1;
+        }
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Replaces the area of identical pixels connected horizontally or vertically to the given point with a new value.
+  *
+  * Each row of the area is found and filled as a single run, and only one point per run on the
+  * neighbouring rows is remembered, so the working memory needed is small.
+  *
+  * @param x The x co-ordinate of the point to fill from.
+  *
+  * @param y The y co-ordinate of the point to fill from.
+  *
+  * @param value The brightness level 0-255 to fill with.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the point lies outside the image,
+  *         or MICROBIT_NO_RESOURCES if there is insufficient memory to complete the fill.
+  *
+  * @code
+  * MicroBitImage i(5,5);
+  * i.drawCircle(2, 2, 2, 255);
+  * i.floodFill(2, 2, 128); // fill the inside of the circle
+  * @endcode
+  */
+int MicroBitImage::floodFill(int16_t x, int16_t y, uint8_t value)
+{
+    int width = getWidth();
+    int height = getHeight();
+
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int format = ptr->format;
+    int stride = getStride();
+    uint8_t target = readPixel(getBitmap() + y * stride, x, format);
+
+    // Nothing would change, and the fill would never see a pixel that differs from the target.
+    if (packedLevel(value, format) == target)
+        return MICROBIT_OK;
+
+    detach();
+
+    uint8_t *bitmap = getBitmap();
+    int capacity = 16;
+    int length = 0;
+    int16_t *stack = (int16_t *) malloc(capacity * 2 * sizeof(int16_t));
+
+    if (stack == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    stack[length++] = x;
+    stack[length++] = y;
+
+    while (length > 0)
+    {
+        int sy = stack[--length];
+        int sx = stack[--length];
+        uint8_t *row = bitmap + sy * stride;
+
+        if (readPixel(row, sx, format) != target)
+            continue;
+
+        // Find the extent of the run containing this point, and fill it.
+        int left = sx;
+        int right = sx;
+
+        while (left > 0 && readPixel(row, left - 1, format) == target)
+            left--;
+
+        while (right < width - 1 && readPixel(row, right + 1, format) == target)
+            right++;
+
+        fillPixels(row, left, right - left + 1, format, value);
+
+        // Remember one point from each run of target pixels above and below.
+        for (int ny = sy - 1; ny <= sy + 1; ny += 2)
+        {
+            if (ny < 0 || ny >= height)
+                continue;
+
+            uint8_t *next = bitmap + ny * stride;
+            bool inRun = false;
+
+            for (int nx = left; nx <= right; nx++)
+            {
+                bool match = readPixel(next, nx, format) == target;
+
+                if (match && !inRun)
+                {
+                    if (length + 2 > capacity * 2)
+                    {
+                        int16_t *grown = (int16_t *) realloc(stack, capacity * 4 * sizeof(int16_t));
+
+                        if (grown == NULL)
+                        {
+                            free(stack);
+                            return MICROBIT_NO_RESOURCES;
+                        }
+
+                        stack = grown;
+                        capacity *= 2;
+                    }
+
+                    stack[length++] = nx;
+                    stack[length++] = ny;
+                }
+
+                inRun = match;
+            }
+        }
+    }
+
+    free(stack);
+
+    return MICROBIT_OK;
+}
 
 /**
   * Shifts the pixels in this Image a given number of pixels to the left.
@@ -621,7 +1385,7 @@ int MicroBitImage::print(char c, int16_t x, int16_t y)
   */
 int MicroBitImage::shiftLeft(int16_t n)
 {
-    uint8_t *p = getBitmap();
+    uint8_t *p;
     int pixels = getWidth()-n;
 
     if (n <= 0 )
@@ -633,12 +1397,30 @@ int MicroBitImage::shiftLeft(int16_t n)
         return MICROBIT_OK;
     }
 
-    for (int y = 0; y < getHeight(); y++)
+    detach();
+    p = getBitmap();
+
+    // The copies may alias the image's fields, so read them once.
+    int format = ptr->format;
+    int bpp = bitsPerPixel[format];
+    int stride = getStride();
+    int height = getHeight();
+
+    for (int y = 0; y < height; y++)
     {
         // Copy, and blank fill the rightmost column.
-        memcpy(p, p+n, pixels);
-        memclr(p+pixels, n);
-        p += getWidth();
+        if (format == MICROBIT_IMAGE_FORMAT_8BPP)
+        {
+            memmove(p, p+n, pixels);
+            memclr(p+pixels, n);
+        }
+        else
+        {
+            blitBits(p, 0, p, n*bpp, pixels*bpp, bpp, false);
+            clearBits(p, pixels*bpp, n*bpp);
+        }
+
+        p += stride;
     }
 
     return MICROBIT_OK;
@@ -660,7 +1442,7 @@ int MicroBitImage::shiftLeft(int16_t n)
   */
 int MicroBitImage::shiftRight(int16_t n)
 {
-    uint8_t *p = getBitmap();
+    uint8_t *p;
     int pixels = getWidth()-n;
 
     if (n <= 0)
@@ -672,12 +1454,30 @@ int MicroBitImage::shiftRight(int16_t n)
         return MICROBIT_OK;
     }
 
-    for (int y = 0; y < getHeight(); y++)
+    detach();
+    p = getBitmap();
+
+    // The copies may alias the image's fields, so read them once.
+    int format = ptr->format;
+    int bpp = bitsPerPixel[format];
+    int stride = getStride();
+    int height = getHeight();
+
+    for (int y = 0; y < height; y++)
     {
         // Copy, and blank fill the leftmost column.
-        memmove(p+n, p, pixels);
-        memclr(p, n);
-        p += getWidth();
+        if (format == MICROBIT_IMAGE_FORMAT_8BPP)
+        {
+            memmove(p+n, p, pixels);
+            memclr(p, n);
+        }
+        else
+        {
+            blitBits(p, n*bpp, p, 0, pixels*bpp, bpp, false);
+            clearBits(p, 0, n*bpp);
+        }
+
+        p += stride;
     }
 
     return MICROBIT_OK;
@@ -699,7 +1499,8 @@ int MicroBitImage::shiftRight(int16_t n)
   */
 int MicroBitImage::shiftUp(int16_t n)
 {
-    uint8_t *pOut, *pIn;
+    uint8_t *p;
+    int rows = getHeight()-n;
 
     if (n <= 0 )
         return MICROBIT_INVALID_PARAMETER;
@@ -710,20 +1511,12 @@ int MicroBitImage::shiftUp(int16_t n)
         return MICROBIT_OK;
     }
 
-    pOut = getBitmap();
-    pIn = getBitmap()+getWidth()*n;
+    detach();
+    p = getBitmap();
 
-    for (int y = 0; y < getHeight(); y++)
-    {
-        // Copy, and blank fill the leftmost column.
-        if (y < getHeight()-n)
-            memcpy(pOut, pIn, getWidth());
-        else
-            memclr(pOut, getWidth());
-
-        pIn += getWidth();
-        pOut += getWidth();
-    }
+    // Move the remaining rows up in one block, and blank fill the bottom rows.
+    memmove(p, p+getStride()*n, getStride()*rows);
+    memclr(p+getStride()*rows, getStride()*n);
 
     return MICROBIT_OK;
 }
@@ -744,7 +1537,8 @@ int MicroBitImage::shiftUp(int16_t n)
   */
 int MicroBitImage::shiftDown(int16_t n)
 {
-    uint8_t *pOut, *pIn;
+    uint8_t *p;
+    int rows = getHeight()-n;
 
     if (n <= 0 )
         return MICROBIT_INVALID_PARAMETER;
@@ -755,20 +1549,12 @@ int MicroBitImage::shiftDown(int16_t n)
         return MICROBIT_OK;
     }
 
-    pOut = getBitmap() + getWidth()*(getHeight()-1);
-    pIn = pOut - getWidth()*n;
+    detach();
+    p = getBitmap();
 
-    for (int y = 0; y < getHeight(); y++)
-    {
-        // Copy, and blank fill the leftmost column.
-        if (y < getHeight()-n)
-            memcpy(pOut, pIn, getWidth());
-        else
-            memclr(pOut, getWidth());
-
-        pIn -= getWidth();
-        pOut -= getWidth();
-    }
+    // Move the remaining rows down in one block, and blank fill the top rows.
+    memmove(p+getStride()*n, p, getStride()*rows);
+    memclr(p, getStride()*n);
 
     return MICROBIT_OK;
 }
@@ -786,40 +1572,24 @@ int MicroBitImage::shiftDown(int16_t n)
 ManagedString MicroBitImage::toString()
 {
     //width including commans and \n * height
-    int stringSize = getSize() * 2;
+    int stringSize = getWidth() * getHeight() * 2;
 
     //plus one for string terminator
     char parseBuffer[stringSize + 1];
 
     parseBuffer[stringSize] = '\0';
 
-    uint8_t *bitmapPtr = getBitmap();
-
     int parseIndex = 0;
-    int widthCount = 0;
 
-    while (parseIndex < stringSize)
+    for (int y = 0; y < getHeight(); y++)
     {
-        if(*bitmapPtr)
-            parseBuffer[parseIndex] = '1';
-        else
-            parseBuffer[parseIndex] = '0';
+        uint8_t *row = getBitmap() + y * getStride();
 
-        parseIndex++;
-
-        if(widthCount == getWidth()-1)
+        for (int x = 0; x < getWidth(); x++)
         {
-            parseBuffer[parseIndex] = '\n';
-            widthCount = 0;
+            parseBuffer[parseIndex++] = readPixel(row, x, ptr->format) ? '1' : '0';
+            parseBuffer[parseIndex++] = (x == getWidth()-1) ? '\n' : ',';
         }
-        else
-        {
-            parseBuffer[parseIndex] = ',';
-            widthCount++;
-        }
-
-        parseIndex++;
-        bitmapPtr++;
     }
 
     return ManagedString(parseBuffer);
@@ -844,34 +1614,21 @@ ManagedString MicroBitImage::toString()
   */
 MicroBitImage MicroBitImage::crop(int startx, int starty, int cropWidth, int cropHeight)
 {
-    int newWidth = startx + cropWidth;
-    int newHeight = starty + cropHeight;
+    // Clip the region to the bounds of this image.
+    if (startx < 0 || starty < 0 || startx >= getWidth() || starty >= getHeight())
+        return EmptyImage;
 
-    if (newWidth >= getWidth() || newWidth <=0)
-        newWidth = getWidth();
+    if (cropWidth <= 0 || startx + cropWidth > getWidth())
+        cropWidth = getWidth() - startx;
 
-    if (newHeight >= getHeight() || newHeight <= 0)
-        newHeight = getHeight();
+    if (cropHeight <= 0 || starty + cropHeight > getHeight())
+        cropHeight = getHeight() - starty;
 
-    //allocate our storage.
-    uint8_t cropped[newWidth * newHeight];
-
-    //calculate the pointer to where we want to begin cropping
-    uint8_t *copyPointer = getBitmap() + (getWidth() * starty) + startx;
-
-    //get a reference to our storage
-    uint8_t *pastePointer = cropped;
-
-    //go through row by row and select our image.
-    for (int i = starty; i < newHeight; i++)
-    {
-        memcpy(pastePointer, copyPointer, newWidth);
-
-        copyPointer += getWidth();
-        pastePointer += newHeight;
-    }
+    // Copy the region into a new image of the same format.
+    MicroBitImage cropped(cropWidth, cropHeight, getFormat());
+    cropped.paste(*this, -startx, -starty);
 
-    return MicroBitImage(newWidth, newHeight, cropped);
+    return cropped;
 }
 
 /**
@@ -889,5 +1646,62 @@ bool MicroBitImage::isReadOnly()
   */
 MicroBitImage MicroBitImage::clone()
 {
-    return MicroBitImage(getWidth(), getHeight(), getBitmap());
+    MicroBitImage copy(getWidth(), getHeight(), getFormat());
+    memcpy(copy.getBitmap(), getBitmap(), getSize());
+
+    return copy;
+}
+
+/**
+  * Creates a copy of this image, stored in the given pixel format.
+  *
+  * @param format The pixel format to convert to.
+  *
+  * @return the converted image, or this image if it is already in the requested format.
+  *
+  * @code
+  * MicroBitImage i("0,255,0\n255,0,255\n");
+  * MicroBitImage packed = i.convert(MICROBIT_IMAGE_FORMAT_1BPP);
+  * @endcode
+  */
+MicroBitImage MicroBitImage::convert(ImageFormat format)
+{
+    if (format == getFormat())
+        return *this;
+
+    MicroBitImage converted(getWidth(), getHeight(), format);
+    converted.paste(*this);
+
+    return converted;
+}
+
+/**
+  * Ensures this image holds the only reference to its bitmap, and that the bitmap is in RAM,
+  * by taking a private copy if necessary.
+  *
+  * Images are copy on write, so every method that modifies an image does this automatically.
+  * It only needs to be called directly before writing through getBitmap().
+  *
+  * @code
+  * MicroBitImage i("0,1,0\n1,0,1\n");
+  * MicroBitImage i2(i);    // i and i2 share the same bitmap
+  * i2.detach();            // i2 now has a copy of its own
+  * i2.getBitmap()[0] = 255;
+  * @endcode
+  */
+void MicroBitImage::detach()
+{
+    // If we're the only reference to a bitmap in RAM, there's nothing to do.
+    if (!ptr->isReadOnly() && ptr->refCount == 3)
+        return;
+
+    ImageData *copy = (ImageData*)microbit_arena_malloc(sizeof(ImageData) + getSize());
+    copy->init();
+    copy->width = ptr->width;
+    copy->height = ptr->height;
+    copy->format = ptr->format;
+    memcpy(copy->data, ptr->data, getSize());
+
+    ptr->decr();
+    ptr = copy;
 }
@@ -0,0 +1,199 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a MicroBitSprite.
+  *
+  * A sprite is an image layer composited onto the display at a given position.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitSprite.h"
+#include "MicroBitCompat.h"
+
+/**
+  * Constructor.
+  *
+  * Creates a visible sprite, with pixels of value zero treated as transparent.
+  *
+  * @param image The image to draw.
+  *
+  * @param x The horizontal position of the sprite on the display. Defaults to 0.
+  *
+  * @param y The vertical position of the sprite on the display. Defaults to 0.
+  *
+  * @param z The depth of the sprite. Higher values are drawn on top. Defaults to 0.
+  *
+  * @code
+  * MicroBitSprite ship(MicroBitImage("0,255,0\n255,255,255\n"), 1, 3);
+  * uBit.display.addSprite(ship);
+  * @endcode
+  */
+MicroBitSprite::MicroBitSprite(MicroBitImage image, int x, int y, int z) : image(image)
+{
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    this->flags = MICROBIT_SPRITE_VISIBLE | MICROBIT_SPRITE_TRANSPARENT | MICROBIT_SPRITE_CHANGED;
+    this->next = NULL;
+}
+
+/**
+  * Changes the image drawn by this sprite.
+  *
+  * @param image The new image.
+  */
+void MicroBitSprite::setImage(MicroBitImage image)
+{
+    // The display may be drawing this sprite from interrupt context. Hold a reference to the old image,
+    // so that it is only released once we're outside the critical section.
+    MicroBitImage previous = this->image;
+
+    __disable_irq();
+    this->image = image;
+    flags |= MICROBIT_SPRITE_CHANGED;
+    __enable_irq();
+}
+
+/**
+  * Retrieves the image drawn by this sprite.
+  */
+MicroBitImage MicroBitSprite::getImage()
+{
+    return image;
+}
+
+/**
+  * Moves the sprite to the given position on the display.
+  *
+  * @param x The new horizontal position.
+  *
+  * @param y The new vertical position.
+  */
+void MicroBitSprite::moveTo(int x, int y)
+{
+    __disable_irq();
+    this->x = x;
+    this->y = y;
+    flags |= MICROBIT_SPRITE_CHANGED;
+    __enable_irq();
+}
+
+/**
+  * Moves the sprite relative to its current position.
+  *
+  * @param dx The number of pixels to move to the right (or left, if negative).
+  *
+  * @param dy The number of pixels to move down (or up, if negative).
+  */
+void MicroBitSprite::moveBy(int dx, int dy)
+{
+    moveTo(x + dx, y + dy);
+}
+
+/**
+  * Changes the depth of this sprite. Higher values are drawn on top.
+  *
+  * @param z The new depth.
+  */
+void MicroBitSprite::setDepth(int z)
+{
+    __disable_irq();
+    this->z = z;
+    flags |= MICROBIT_SPRITE_CHANGED;
+    __enable_irq();
+}
+
+/**
+  * Shows or hides this sprite.
+  *
+  * @param visible true to show the sprite, false to hide it.
+  */
+void MicroBitSprite::setVisible(bool visible)
+{
+    __disable_irq();
+
+    if (visible)
+        flags |= MICROBIT_SPRITE_VISIBLE;
+    else
+        flags &= ~MICROBIT_SPRITE_VISIBLE;
+
+    flags |= MICROBIT_SPRITE_CHANGED;
+    __enable_irq();
+}
+
+/**
+  * Determines if pixels of value zero in the image are transparent, or drawn as black.
+  *
+  * @param transparent true to treat zero pixels as transparent, false to draw them.
+  */
+void MicroBitSprite::setTransparent(bool transparent)
+{
+    __disable_irq();
+
+    if (transparent)
+        flags |= MICROBIT_SPRITE_TRANSPARENT;
+    else
+        flags &= ~MICROBIT_SPRITE_TRANSPARENT;
+
+    flags |= MICROBIT_SPRITE_CHANGED;
+    __enable_irq();
+}
+
+/**
+  * Draws this sprite into a byte per pixel buffer the size of the display.
+  *
+  * @param buffer The buffer to draw into.
+  *
+  * @param width The width of the buffer.
+  *
+  * @param height The height of the buffer.
+  */
+void MicroBitSprite::render(uint8_t *buffer, int width, int height)
+{
+    if (!(flags & MICROBIT_SPRITE_VISIBLE))
+        return;
+
+    bool transparent = (flags & MICROBIT_SPRITE_TRANSPARENT) != 0;
+
+    // Clip the sprite to the buffer.
+    int x0 = max(0, -x);
+    int y0 = max(0, -y);
+    int x1 = min(image.getWidth(), width - x);
+    int y1 = min(image.getHeight(), height - y);
+
+    for (int sy = y0; sy < y1; sy++)
+    {
+        uint8_t *out = buffer + (y + sy) * width + x;
+
+        for (int sx = x0; sx < x1; sx++)
+        {
+            int v = image.getPixelValue(sx, sy);
+
+            if (v || !transparent)
+                out[sx] = v;
+        }
+    }
+}
@@ -0,0 +1,173 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Class definition for a MicroBitTextStrip.
+  *
+  * A MicroBitTextStrip is a line of text rendered once, using the system font, into a packed strip
+  * of one byte per column.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitTextStrip.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+/**
+  * Constructor.
+  * Creates an empty strip.
+  */
+MicroBitTextStrip::MicroBitTextStrip()
+{
+    columns = NULL;
+    length = 0;
+}
+
+/**
+  * Renders the given text into this strip, replacing any previous content.
+  *
+  * @param s The text to render, which may be encoded as UTF-8.
+  *
+  * @param proportional If true, empty columns either side of each character are removed, and the font's
+  *                     kerning is applied. Defaults to false.
+  *
+  * @param spacing The number of blank columns placed after each character. Defaults to MICROBIT_TEXT_STRIP_SPACING.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the spacing is negative or the text too long,
+  *         or MICROBIT_NO_RESOURCES if the strip could not be allocated.
+  *
+  * @code
+  * MicroBitTextStrip strip;
+  * strip.layout("Hello", true);
+  * @endcode
+  */
+int MicroBitTextStrip::layout(ManagedString s, bool proportional, int spacing)
+{
+    MicroBitFont font = MicroBitFont::getSystemFont();
+    uint8_t glyph[MICROBIT_FONT_MAX_WIDTH];
+    const char *text = s.toCharArray();
+    int size = 0;
+
+    if (spacing < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    clear();
+
+    // The first pass measures the strip, so that exactly enough memory can be allocated for the second to fill.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int position = 0;
+        int end = 0;
+        int start = 0;
+        uint16_t previous = 0;
+        int i = 0;
+
+        while (i < s.length())
+        {
+            uint16_t c = MicroBitFont::nextCharacter(text, s.length(), i);
+            int first = 0;
+            int last = font.getColumns(c, glyph);
+
+            // Characters not in the font are shown as blank.
+            if (last < 0)
+            {
+                last = font.getWidth();
+                memset(glyph, 0, last);
+            }
+
+            if (proportional)
+            {
+                while (first < last && glyph[first] == 0)
+                    first++;
+
+                while (last > first && glyph[last-1] == 0)
+                    last--;
+
+                if (first == last)
+                {
+                    first = 0;
+                    last = MICROBIT_TEXT_STRIP_SPACE_WIDTH;
+                    memset(glyph, 0, last);
+                }
+
+                // Kerning may pull a character back over the one before, but never to or behind its first column.
+                if (previous)
+                    position = max(position + font.getKerning(previous, c), start + 1);
+            }
+
+            if (pass == 1)
+                for (int col = first; col < last; col++)
+                    columns[position + col - first] |= glyph[col];
+
+            start = position;
+            end = max(end, position + last - first);
+            position = end + spacing;
+            previous = c;
+        }
+
+        if (pass == 0)
+        {
+            size = position;
+
+            if (size > 0xffff)
+                return MICROBIT_INVALID_PARAMETER;
+
+            if (size == 0)
+                return MICROBIT_OK;
+
+            columns = (uint8_t *) malloc(size);
+
+            if (columns == NULL)
+                return MICROBIT_NO_RESOURCES;
+
+            // Kerned characters can overlap, so glyphs are merged into a blank strip.
+            memset(columns, 0, size);
+        }
+    }
+
+    length = size;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Releases the memory held by this strip, leaving it empty.
+  */
+void MicroBitTextStrip::clear()
+{
+    if (columns)
+        free(columns);
+
+    columns = NULL;
+    length = 0;
+}
+
+/**
+  * Destructor.
+  */
+MicroBitTextStrip::~MicroBitTextStrip()
+{
+    clear();
+}
@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "PacketBuffer.h"
 #include "ErrorNo.h"
+#include "MicroBitArena.h"
 
 // Create the EmptyPacket reference.
 PacketBuffer PacketBuffer::EmptyPacket = PacketBuffer(1);
@@ -110,7 +111,7 @@ void PacketBuffer::init(uint8_t *data, int length, int rssi)
     if (length < 0)
         length = 0;
 
-    ptr = (PacketData *) malloc(sizeof(PacketData) + length);
+    ptr = (PacketData *) microbit_arena_malloc(sizeof(PacketData) + length);
     ptr->init();
 
     ptr->length = length;
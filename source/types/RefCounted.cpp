@@ -30,6 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "RefCounted.h"
+#include "MicroBitArena.h"
 #include "MicroBitDisplay.h"
 
 /**
@@ -93,6 +94,6 @@ void RefCounted::decr()
 
     refCount -= 2;
     if (refCount == 1) {
-        free(this);
+        microbit_arena_free(this);
     }
 }
@@ -0,0 +1,886 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for MicroBitDisplay. The display runs against the simulated timers in host/mbed.h, with
+  * a MicroBitDisplayRecorder capturing every write to the LED matrix, so that what a viewer would have
+  * seen can be checked.
+  *
+  * Usage: display [test ...]
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitDisplay.h"
+#include "MicroBitDisplayRecorder.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitTimeline.h"
+#include "MicroBitSprite.h"
+#include "ErrorNo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+/**
+  * Finds the last write at or before the start of a period, which the LEDs hold as the period begins.
+  * The recorder must have been recording since before the period, or the state of the LEDs isn't known.
+  *
+  * @return the index of that write, or 0 if nothing has been written at all.
+  */
+static int seed(MicroBitDisplayRecorder &recorder, uint32_t start)
+{
+    MicroBitDisplaySample sample;
+    int first = 0;
+
+    if (recorder.getLength() == 0)
+        return 0;
+
+    recorder.getSample(0, sample);
+    check((int32_t)(sample.time - start) <= 0, "the recorder missed the state of the LEDs at the start of a measurement");
+
+    for (int i = 1; recorder.getSample(i, sample) == MICROBIT_OK && (int32_t)(sample.time - start) <= 0; i++)
+        first = i;
+
+    return first;
+}
+
+/**
+  * Measures how long each pixel was lit for over the given period, from the writes in a recorder.
+  * Unlike MicroBitDisplayRecorder::getFrame(), the result is exact, in microseconds.
+  */
+static void measure(MicroBitDisplayRecorder &recorder, uint32_t start, uint32_t end, uint32_t onTime[5][5])
+{
+    const MatrixMap &map = microbitMatrixMap;
+    uint32_t led[32] = { 0 };
+    MicroBitDisplaySample sample;
+    MicroBitDisplaySample next;
+
+    for (int i = seed(recorder, start); recorder.getSample(i, sample) == MICROBIT_OK; i++)
+    {
+        int32_t from = max((int32_t)(sample.time - start), 0);
+        int32_t to = min(recorder.getSample(i + 1, next) == MICROBIT_OK ? (int32_t)(next.time - start) : (int32_t)(end - start), (int32_t)(end - start));
+
+        for (int row = 0; row < map.rows && to > from; row++)
+            for (int column = 0; column < map.columns; column++)
+                if ((sample.value & (1 << (map.rowStart + row))) && !(sample.value & (1 << (map.columnStart + column))))
+                    led[column * map.rows + row] += to - from;
+    }
+
+    // Unconnected positions of the map alias (0,0), so keep the longest time seen for each pixel.
+    memset(onTime, 0, sizeof(uint32_t) * 25);
+
+    for (int i = 0; i < map.rows * map.columns; i++)
+        if (map.map[i].x < 5 && map.map[i].y < 5)
+            onTime[map.map[i].y][map.map[i].x] = max(onTime[map.map[i].y][map.map[i].x], led[i]);
+}
+
+// The on time of each bit plane of a greyscale level, as the display hardware expects them.
+static const int planeTimings[8] = { 1, 23, 70, 163, 351, 726, 1476, 2976 };
+
+// The bit planes that the original renderer busy waited through on every row, rather than use the timer.
+static const int legacyBusyPlanes = 3;
+
+/**
+  * The time a greyscale level should be lit for each refresh: the sum of the timings of its bit planes.
+  */
+static uint32_t idealOnTime(int level)
+{
+    uint32_t t = 0;
+
+    for (int b = 0; b < 8; b++)
+        if (level & (1 << b))
+            t += planeTimings[b];
+
+    return t;
+}
+
+/**
+  * Every non-zero greyscale value must light its LED for exactly the time its bit planes add up to, and each
+  * brighter value for longer. The dim levels are shown exactly, by busy waiting, so the time spent
+  * doing so is reported against what the bit plane renderer spent.
+  */
+static void greyscale()
+{
+    static const int values[] = { 1, 2, 3, 4, 8, 16, 32, 64, 128, 192, 255 };
+    const int count = sizeof(values) / sizeof(int);
+
+    MicroBitDisplay display;
+    MicroBitDisplayRecorder recorder(2048);
+    uint32_t onTime[5][5];
+
+    display.setRecorder(&recorder);
+    display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+
+    for (int i = 0; i < count; i++)
+        display.image.setPixelValue(i % 5, i / 5, values[i]);
+
+    // Let the new frame settle, then watch ten refreshes of the whole matrix. The recorder keeps the writes
+    // made as the frame settled, so the LEDs lit as the measurement begins are known.
+    recorder.clear();
+    host_advance(100000);
+
+    uint32_t start = host_us_ticker;
+    uint32_t busy = host_busy_us;
+    host_advance(10 * microbitMatrixMap.rows * system_timer_get_period() * 1000);
+    measure(recorder, start, host_us_ticker, onTime);
+    busy = host_busy_us - busy;
+
+    uint32_t previous = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t t = onTime[i / 5][i % 5] / 10;
+        uint32_t ideal = idealOnTime(values[i]);
+
+        printf("value %3d: lit for %4u us per refresh (ideal %4u us)\n", values[i], t, ideal);
+
+        check(t > previous, "a brighter greyscale value was not lit for longer");
+        check(t == ideal, "a greyscale value was not lit for exactly its on time");
+
+        previous = t;
+    }
+
+    check(onTime[4][4] == 0, "an unlit pixel was lit");
+
+    // Every row of every refresh busy waited through the first bit planes before.
+    uint32_t legacy = 0;
+
+    for (int b = 0; b < legacyBusyPlanes; b++)
+        legacy += planeTimings[b];
+
+    legacy *= microbitMatrixMap.rows;
+    busy /= 10;
+
+    printf("busy waiting in interrupt context: %u us per refresh, was %u us with bit planes (%u us saved)\n", busy, legacy, legacy - busy);
+
+    check(busy < legacy, "greyscale rendering busy waited for longer than the bit plane renderer");
+}
+
+/**
+  * With microbitGammaTable in use, the dimmest pixel values must still light their LEDs, and values
+  * mapped to different levels must be shown differently.
+  */
+static void gamma()
+{
+    static const int values[] = { 1, 24, 25, 128, 255 };
+    const int count = sizeof(values) / sizeof(int);
+
+    MicroBitDisplay display;
+    MicroBitDisplayRecorder recorder(2048);
+    uint32_t onTime[5][5];
+
+    display.setRecorder(&recorder);
+    display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+    display.setGammaTable(microbitGammaTable);
+
+    for (int i = 0; i < count; i++)
+        display.image.setPixelValue(i, 0, values[i]);
+
+    recorder.clear();
+    host_advance(100000);
+
+    uint32_t start = host_us_ticker;
+    host_advance(10 * microbitMatrixMap.rows * system_timer_get_period() * 1000);
+    measure(recorder, start, host_us_ticker, onTime);
+
+    for (int i = 0; i < count; i++)
+    {
+        printf("value %3d: level %3d, lit for %4u us per refresh\n", values[i], microbitGammaTable[values[i]], onTime[0][i] / 10);
+
+        check(onTime[0][i] > 0, "a non-zero pixel value was not lit through the gamma table");
+
+        if (i > 0 && microbitGammaTable[values[i]] == microbitGammaTable[values[i - 1]])
+            check(onTime[0][i] == onTime[0][i - 1], "pixel values with the same level were lit for different times");
+
+        if (i > 0 && microbitGammaTable[values[i]] > microbitGammaTable[values[i - 1]])
+            check(onTime[0][i] > onTime[0][i - 1], "a brighter level was not lit for longer");
+    }
+}
+
+/**
+  * A snapshot must show the current image, both while the display is running and while it is disabled.
+  */
+static void snapshot()
+{
+    MicroBitDisplay display;
+    uint8_t frame[5];
+
+    check(display.getSnapshotSize() == 5, "a 5x5 snapshot should take a byte per row");
+
+    display.image.setPixelValue(0, 0, 255);
+    display.image.setPixelValue(4, 2, 1);
+    host_advance(100000);
+
+    check(display.getSnapshot(frame, sizeof(frame)) == 5, "getSnapshot() failed");
+    check(frame[0] == 0x01 && frame[1] == 0 && frame[2] == 0x10 && frame[3] == 0 && frame[4] == 0, "snapshot of a running display is wrong");
+    check(display.getSnapshot(frame, 4) == MICROBIT_INVALID_PARAMETER, "getSnapshot() accepted a short buffer");
+
+    // Nothing refreshes a disabled display, but its snapshot must still follow the image.
+    display.disable();
+    display.image.setPixelValue(0, 0, 0);
+    display.image.setPixelValue(2, 4, 255);
+
+    check(display.getSnapshot(frame, sizeof(frame)) == 5, "getSnapshot() failed");
+    check(frame[0] == 0 && frame[2] == 0x10 && frame[4] == 0x04, "snapshot of a disabled display is stale");
+}
+
+/**
+  * A copy of the display image is a snapshot, which an animation must not change as it updates the display.
+  */
+static void copy()
+{
+    MicroBitDisplay display;
+
+    display.scrollAsync(ManagedString("HI"), 20);
+    host_advance(100000);
+
+    MicroBitImage copy = display.image;
+    uint8_t before[10 * 5];
+    memcpy(before, copy.getBitmap(), sizeof(before));
+
+    host_advance(100000);
+
+    check(memcmp(before, copy.getBitmap(), sizeof(before)) == 0, "an animation changed a copy of the display image");
+    check(memcmp(before, display.image.getBitmap(), sizeof(before)) != 0, "the display stopped animating once its image was copied");
+    check(display.image.getBitmap() != copy.getBitmap(), "the display image still shares its buffer with a copy");
+}
+
+static uint32_t spriteSeed = 1;
+
+static int spriteRandom(int n)
+{
+    spriteSeed = spriteSeed * 1103515245 + 12345;
+    return (spriteSeed >> 8) % n;
+}
+
+/**
+  * A random image with about a third of its pixels transparent.
+  */
+static MicroBitImage spriteImage(int width, int height)
+{
+    MicroBitImage image(width, height);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            image.setPixelValue(x, y, spriteRandom(3) ? 1 + spriteRandom(255) : 0);
+
+    return image;
+}
+
+/**
+  * The sprites on a display, in the order they are drawn, with everything needed to draw them naively.
+  */
+struct SpriteModel
+{
+    MicroBitSprite *sprite;
+    MicroBitImage image;
+    int x, y, z;
+    bool visible, transparent;
+};
+
+/**
+  * The composited frame must always match a naive one: the image, then each visible sprite, lowest first, and
+  * those of equal depth in the order they were added, clipped pixel by pixel to the display, with zero pixels
+  * skipped where transparent. The frame is read back exactly by showing it in greyscale, as every level has
+  * its own on time.
+  */
+static void sprites()
+{
+    const int period = microbitMatrixMap.rows * system_timer_get_period() * 1000;
+    const int count = 4;
+
+    MicroBitDisplay display;
+    MicroBitDisplayRecorder recorder(1024);
+    uint32_t onTime[5][5];
+    int level[5787];
+
+    memset(level, -1, sizeof(level));
+
+    for (int v = 0; v < 256; v++)
+        level[idealOnTime(v)] = v;
+
+    display.setRecorder(&recorder);
+    display.setDisplayMode(DISPLAY_MODE_GREYSCALE);
+
+    MicroBitSprite sprites[count] = { MicroBitSprite(MicroBitImage()), MicroBitSprite(MicroBitImage()), MicroBitSprite(MicroBitImage()), MicroBitSprite(MicroBitImage()) };
+    std::vector<SpriteModel> model;
+    uint8_t background[5][5] = { { 0 } };
+    int rounds = 0;
+
+    for (; rounds < 500; rounds++)
+    {
+        int i = spriteRandom(count);
+        SpriteModel *m = NULL;
+
+        for (size_t n = 0; n < model.size(); n++)
+            if (model[n].sprite == &sprites[i])
+                m = &model[n];
+
+        switch (m ? spriteRandom(7) : 0)
+        {
+            case 0:
+                if (m)
+                {
+                    check(display.removeSprite(sprites[i]) == MICROBIT_OK, "removeSprite() failed");
+                    check(display.removeSprite(sprites[i]) == MICROBIT_INVALID_PARAMETER, "a sprite was removed twice");
+                    model.erase(model.begin() + (m - &model[0]));
+                }
+                else
+                {
+                    SpriteModel added = { &sprites[i], spriteImage(1 + spriteRandom(7), 1 + spriteRandom(7)), spriteRandom(13) - 6, spriteRandom(13) - 6, spriteRandom(3), true, true };
+
+                    sprites[i] = MicroBitSprite(added.image, added.x, added.y, added.z);
+                    check(display.addSprite(sprites[i]) == MICROBIT_OK, "addSprite() failed");
+                    check(display.addSprite(sprites[i]) == MICROBIT_INVALID_PARAMETER, "a sprite was added twice");
+
+                    // A new sprite goes above any others of the same depth.
+                    size_t at = 0;
+
+                    while (at < model.size() && model[at].z <= added.z)
+                        at++;
+
+                    model.insert(model.begin() + at, added);
+                }
+                break;
+
+            case 1:
+                m->x = spriteRandom(13) - 6;
+                m->y = spriteRandom(13) - 6;
+                sprites[i].moveTo(m->x, m->y);
+                break;
+
+            case 2:
+                m->z = spriteRandom(3);
+                sprites[i].setDepth(m->z);
+                break;
+
+            case 3:
+                m->visible = !m->visible;
+                sprites[i].setVisible(m->visible);
+                break;
+
+            case 4:
+                m->transparent = !m->transparent;
+                sprites[i].setTransparent(m->transparent);
+                break;
+
+            case 5:
+                m->image = spriteImage(1 + spriteRandom(7), 1 + spriteRandom(7));
+                sprites[i].setImage(m->image);
+                break;
+
+            case 6:
+            {
+                int x = spriteRandom(5);
+                int y = spriteRandom(5);
+                background[y][x] = spriteRandom(2) ? spriteRandom(256) : 0;
+                display.image.setPixelValue(x, y, background[y][x]);
+                break;
+            }
+        }
+
+        // Sprites are kept in order of depth, and a change of depth keeps the order of those at the same depth.
+        std::stable_sort(model.begin(), model.end(), [](const SpriteModel &a, const SpriteModel &b) { return a.z < b.z; });
+
+        uint8_t expected[5][5];
+        memcpy(expected, background, sizeof(expected));
+
+        for (size_t n = 0; n < model.size(); n++)
+        {
+            if (!model[n].visible)
+                continue;
+
+            for (int sy = 0; sy < model[n].image.getHeight(); sy++)
+                for (int sx = 0; sx < model[n].image.getWidth(); sx++)
+                {
+                    int x = model[n].x + sx;
+                    int y = model[n].y + sy;
+                    int v = model[n].image.getPixelValue(sx, sy);
+
+                    if (x >= 0 && x < 5 && y >= 0 && y < 5 && (v || !model[n].transparent))
+                        expected[y][x] = v;
+                }
+        }
+
+        // Changes are picked up at the start of a refresh, so let one pass before measuring the next.
+        recorder.clear();
+        host_advance(2 * period);
+
+        uint32_t start = host_us_ticker;
+        host_advance(period);
+        measure(recorder, start, host_us_ticker, onTime);
+
+        for (int y = 0; y < 5; y++)
+            for (int x = 0; x < 5; x++)
+            {
+                int shown = onTime[y][x] < sizeof(level) / sizeof(int) ? level[onTime[y][x]] : -1;
+
+                if (shown != expected[y][x])
+                {
+                    printf("round %d: pixel %d,%d shows %d, expected %d\n", rounds, x, y, shown, expected[y][x]);
+                    check(false, "the composited frame differs from the naive composition");
+                }
+            }
+    }
+
+    for (size_t n = 0; n < model.size(); n++)
+        display.removeSprite(*model[n].sprite);
+
+    printf("%d changes to %d sprites composited as the naive frame\n", rounds, count);
+}
+
+/**
+  * Returns the number of references held to the given image data.
+  */
+static int references(ImageData *data)
+{
+    return data->refCount >> 1;
+}
+
+/**
+  * Once the display has played an item, the next fiber to touch the timeline must release its image.
+  */
+static void timeline()
+{
+    MicroBitDisplay display;
+    MicroBitTimeline timeline;
+
+    // Take the image's data so its references can be counted, leaving one held by image.
+    MicroBitImage image(2, 2);
+    ImageData *data = image.leakData();
+    image = MicroBitImage(data);
+    data->decr();
+
+    check(references(data) == 1, "the test image should start with a single reference");
+
+    check(timeline.addFrame(image, 50) == MICROBIT_OK, "addFrame() failed");
+    check(timeline.addScroll(image, 10) == MICROBIT_OK, "addScroll() failed");
+    check(references(data) == 3, "queued items should hold the image");
+
+    check(display.playAsync(timeline) == MICROBIT_OK, "playAsync() failed");
+    host_advance(500000);
+
+    check(timeline.getLength() == 0, "the timeline did not finish playing");
+    check(references(data) == 3, "the display released an image from its interrupt");
+
+    // Queuing anything more releases every item that has been played.
+    check(timeline.addPause(10) == MICROBIT_OK, "addPause() failed");
+    check(references(data) == 1, "played items still hold the image after another was queued");
+
+    check(timeline.addFrame(image, 50) == MICROBIT_OK, "addFrame() failed");
+    timeline.clear();
+    check(references(data) == 1, "cleared items still hold the image");
+}
+
+/**
+  * Returns the time taken by the given function, averaged over a number of runs, in nanoseconds.
+  */
+template <typename F> static double timeOf(F f, int runs)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < runs; i++)
+        f();
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+/**
+  * The lowest of several timings, to keep the noise of the host out of small differences.
+  */
+template <typename F> static double bestOf(F f, int runs)
+{
+    double best = timeOf(f, runs);
+
+    for (int i = 1; i < 5; i++)
+        best = min(best, timeOf(f, runs));
+
+    return best;
+}
+
+/**
+  * The work the display interrupt used to do for every row, before rows were compiled in advance:
+  * walk the matrix map, rotate each position, and look the pixel up in a double width bitmap.
+  */
+static uint32_t legacyRow(const MatrixMap &map, const uint8_t *bitmap, int rotation, int row)
+{
+    const int width = MICROBIT_DISPLAY_WIDTH;
+    const int height = MICROBIT_DISPLAY_HEIGHT;
+
+    uint32_t col_mask = ((1 << map.columns) - 1) << map.columnStart;
+    uint32_t row_data = 0x01 << (map.rowStart + row);
+    uint32_t col_data = 0;
+
+    for (int i = 0; i < map.columns; i++)
+    {
+        int index = (i * map.rows) + row;
+
+        int x = map.map[index].x;
+        int y = map.map[index].y;
+        int t = x;
+
+        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+        {
+                x = width - 1 - y;
+                y = t;
+        }
+
+        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
+        {
+                x = width - 1 - x;
+                y = height - 1 - y;
+        }
+
+        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+        {
+                x = y;
+                y = height - 1 - t;
+        }
+
+        if(bitmap[y*(width*2)+x])
+            col_data |= (1 << i);
+    }
+
+    return (~col_data << map.columnStart & col_mask) | row_data;
+}
+
+/**
+  * Compares the cost of a display interrupt with the per row work it did before rows were precompiled.
+  * The figures are host timings, so only their ratio means anything for the device.
+  */
+static void isr()
+{
+    const int ticks = 1000000;
+
+    MicroBitDisplay display;
+    uint8_t bitmap[MICROBIT_DISPLAY_HEIGHT * MICROBIT_DISPLAY_WIDTH * 2] = {};
+
+    for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; y++)
+        for (int x = 0; x < MICROBIT_DISPLAY_WIDTH; x++)
+            if ((x + y) & 1)
+            {
+                display.image.setPixelValue(x, y, 255);
+                bitmap[y * MICROBIT_DISPLAY_WIDTH * 2 + x] = 255;
+            }
+
+    display.rotateTo(MICROBIT_DISPLAY_ROTATION_90);
+    host_advance(100000);
+
+    volatile uint32_t sink = 0;
+    volatile int rotation = MICROBIT_DISPLAY_ROTATION_90;
+    int row = 0;
+
+    double before = timeOf([&]() {
+        sink = legacyRow(microbitMatrixMap, bitmap, rotation, row);
+        row = (row + 1) % microbitMatrixMap.rows;
+    }, ticks);
+
+    double after = timeOf([&]() { display.systemTick(); }, ticks);
+
+    // The whole of systemTick() is timed, so the comparison is if anything unfair to the compiled rows.
+    printf("per row: %.1f ns for the legacy column walk alone, %.1f ns for a whole systemTick()\n", before, after);
+
+    // Both must still drive the same LEDs.
+    MicroBitDisplayRecorder recorder(64);
+    display.setRecorder(&recorder);
+    recorder.clear();
+    host_advance(microbitMatrixMap.rows * system_timer_get_period() * 1000);
+
+    int rows = 0;
+
+    for (int i = 0; i < recorder.getLength(); i++)
+    {
+        MicroBitDisplaySample sample;
+        recorder.getSample(i, sample);
+
+        if (sample.value == 0)
+            continue;
+
+        bool found = false;
+
+        for (int r = 0; r < microbitMatrixMap.rows; r++)
+            if (sample.value == legacyRow(microbitMatrixMap, bitmap, MICROBIT_DISPLAY_ROTATION_90, r))
+                found = true;
+
+        check(found, "a compiled row differs from the row the legacy walk computes");
+        rows++;
+    }
+
+    check(rows >= microbitMatrixMap.rows, "the display did not refresh every row");
+}
+
+/**
+  * Measures how many times each row of the matrix was strobed, and for how long it was driven with at least one LED lit.
+  */
+static void measureRows(MicroBitDisplayRecorder &recorder, uint32_t start, uint32_t end, uint32_t *driven, int *strobes)
+{
+    const MatrixMap &map = microbitMatrixMap;
+    uint32_t columns = ((1 << map.columns) - 1) << map.columnStart;
+    MicroBitDisplaySample sample;
+    MicroBitDisplaySample next;
+
+    memset(driven, 0, sizeof(uint32_t) * map.rows);
+    memset(strobes, 0, sizeof(int) * map.rows);
+
+    for (int i = seed(recorder, start); recorder.getSample(i, sample) == MICROBIT_OK; i++)
+    {
+        int32_t from = max((int32_t)(sample.time - start), 0);
+        int32_t to = min(recorder.getSample(i + 1, next) == MICROBIT_OK ? (int32_t)(next.time - start) : (int32_t)(end - start), (int32_t)(end - start));
+
+        for (int row = 0; row < map.rows; row++)
+        {
+            if (!(sample.value & (1 << (map.rowStart + row))))
+                continue;
+
+            // Only writes made during the period count as strobes, though one made before it may still be held.
+            if ((int32_t)(sample.time - start) >= 0 && from < to)
+                strobes[row]++;
+
+            if ((~sample.value & columns) && to > from)
+                driven[row] += to - from;
+        }
+    }
+}
+
+/**
+  * With adaptive refresh, dark rows of the matrix must never be strobed, lit rows must share their time,
+  * and an empty frame must not drive the matrix at all.
+  */
+static void adaptive()
+{
+    const MatrixMap &map = microbitMatrixMap;
+    const int refreshes = 30;
+    const int runs = 100000;
+
+    uint32_t onTime[2][5][5];
+    uint32_t driven[2][8];
+    int strobes[2][8];
+    double cost[2];
+
+    // Light a single pixel, so that a single row of the matrix has anything to show.
+    bool lit[8] = { false };
+
+    for (int i = 0; i < map.rows * map.columns; i++)
+        if (map.map[i].x == 2 && map.map[i].y == 2)
+            lit[i % map.rows] = true;
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+        MicroBitDisplay display;
+        MicroBitDisplayRecorder recorder(4096);
+
+        display.setRecorder(&recorder);
+        display.setAdaptiveRefresh(mode == 1);
+        display.image.setPixelValue(2, 2, 255);
+
+        recorder.clear();
+        host_advance(100000);
+
+        uint32_t start = host_us_ticker;
+        host_advance(refreshes * map.rows * system_timer_get_period() * 1000);
+        measure(recorder, start, host_us_ticker, onTime[mode]);
+        measureRows(recorder, start, host_us_ticker, driven[mode], strobes[mode]);
+
+        display.setRecorder(NULL);
+        cost[mode] = bestOf([&]() { display.systemTick(); }, runs);
+
+        printf("%s refresh: pixel lit for %u us per refresh, %.1f ns per tick\n", mode ? "adaptive" : "fixed", onTime[mode][2][2] / refreshes, cost[mode]);
+
+        for (int row = 0; row < map.rows; row++)
+            printf("    row %d: %s, strobed %d times, duty cycle %.1f%%\n", row, lit[row] ? "lit" : "dark", strobes[mode][row],
+                100.0 * driven[mode][row] / (refreshes * map.rows * system_timer_get_period() * 1000));
+    }
+
+    for (int row = 0; row < map.rows; row++)
+    {
+        if (lit[row])
+            check(driven[1][row] >= (map.rows - 1) * driven[0][row], "a lit row was not given the time of the dark rows");
+        else
+            check(strobes[1][row] == 0, "a dark row was strobed with adaptive refresh");
+    }
+
+    check(onTime[1][2][2] >= (uint32_t)(map.rows - 1) * onTime[0][2][2], "adaptive refresh did not make a lit pixel brighter");
+
+    // Once the frame is empty, nothing should be driven at all.
+    MicroBitDisplay display;
+    MicroBitDisplayRecorder recorder(256);
+
+    display.setRecorder(&recorder);
+    display.setAdaptiveRefresh(true);
+    recorder.clear();
+    host_advance(100000);
+
+    uint32_t start = host_us_ticker;
+    host_advance(refreshes * map.rows * system_timer_get_period() * 1000);
+    measureRows(recorder, start, host_us_ticker, driven[0], strobes[0]);
+
+    for (int row = 0; row < map.rows; row++)
+        check(strobes[0][row] == 0, "a row was strobed for an empty frame");
+
+    display.setRecorder(NULL);
+    printf("empty frame: %.1f ns per tick\n", bestOf([&]() { display.systemTick(); }, runs));
+}
+
+/**
+  * Reconstructs the frame shown over a whole number of refreshes, from the first write recorded once any
+  * change to the display has taken effect.
+  */
+static MicroBitImage capture(MicroBitDisplayRecorder &recorder, int refreshes)
+{
+    const int period = microbitMatrixMap.rows * system_timer_get_period() * 1000;
+    MicroBitDisplaySample first;
+
+    // A change to the display is picked up at the start of the next refresh, so let the current one finish.
+    host_advance(period);
+    recorder.clear();
+    host_advance((refreshes + 1) * period);
+    recorder.getSample(0, first);
+
+    return recorder.getFrame(first.time, first.time + refreshes * period);
+}
+
+/**
+  * The recorder must reconstruct what was shown, in the physical orientation of the matrix, at any brightness,
+  * and across a wrap of the microsecond clock.
+  */
+static void recorder()
+{
+    static const int lit[][2] = { { 0, 0 }, { 1, 0 }, { 4, 1 }, { 2, 3 }, { 0, 4 }, { 3, 4 } };
+
+    MicroBitDisplay display;
+    MicroBitDisplayRecorder recorder(256);
+    MicroBitImage image(5, 5);
+
+    for (unsigned i = 0; i < sizeof(lit) / sizeof(lit[0]); i++)
+        image.setPixelValue(lit[i][0], lit[i][1], 255);
+
+    display.setRecorder(&recorder);
+    display.print(image);
+    host_advance(100000);
+
+    MicroBitImage frame = capture(recorder, 10);
+    printf("%s", frame.toString().toCharArray());
+
+    check(frame == image, "the recorded frame differs from the image shown");
+    check(frame.toString() == image.toString(), "the recorded frame exports as different text");
+
+    // Timestamps follow the strobe, one write per tick.
+    MicroBitDisplaySample a, b;
+
+    for (int i = 0; recorder.getSample(i + 1, b) == MICROBIT_OK; i++)
+    {
+        recorder.getSample(i, a);
+        check(b.time - a.time == (uint32_t)system_timer_get_period() * 1000, "recorded writes are not a tick apart");
+    }
+
+    // Frames are physical, so a rotated image appears rotated. At 90 degrees each LED at (x,y) shows pixel (4-y,x).
+    display.rotateTo(MICROBIT_DISPLAY_ROTATION_90);
+    frame = capture(recorder, 10);
+
+    for (int y = 0; y < 5; y++)
+        for (int x = 0; x < 5; x++)
+            check(frame.getPixelValue(x, y) == image.getPixelValue(4 - y, x), "the recorded frame of a rotated display is wrong");
+
+    display.rotateTo(MICROBIT_DISPLAY_ROTATION_0);
+
+    // Half brightness shows for a little under half of each row's time.
+    display.setBrightness(128);
+    frame = capture(recorder, 10);
+    printf("brightness 128 is recorded at level %d\n", frame.getPixelValue(0, 0));
+
+    check(abs(frame.getPixelValue(0, 0) - 128) <= 16, "a dimmed display was recorded at the wrong level");
+    check(frame.getPixelValue(1, 1) == 0, "an unlit pixel was recorded as lit when dimmed");
+
+    display.setBrightness(255);
+
+    // Run the clock up to just before it wraps, and record across the wrap.
+    host_advance(0xFFFFFFFF - host_us_ticker - 30000);
+    frame = capture(recorder, 10);
+
+    check(frame == image, "a frame recorded across a wrap of the clock differs from the image shown");
+
+    // Once full, only the most recent writes are kept, oldest first.
+    MicroBitDisplayRecorder small(8);
+    display.setRecorder(&small);
+    host_advance(100 * system_timer_get_period() * 1000);
+
+    check(small.getLength() == 8, "a full recorder holds the wrong number of writes");
+    check(small.getSample(7, b) == MICROBIT_OK && small.getSample(8, b) == MICROBIT_INVALID_PARAMETER, "getSample() range is wrong");
+
+    small.getSample(0, a);
+    small.getSample(7, b);
+    check(b.time - a.time == 7 * (uint32_t)system_timer_get_period() * 1000, "a full recorder did not keep the most recent writes");
+
+    display.setRecorder(NULL);
+}
+
+struct Test
+{
+    const char  *name;
+    void        (*run)();
+};
+
+static const Test tests[] = {
+    { "greyscale", greyscale },
+    { "gamma", gamma },
+    { "snapshot", snapshot },
+    { "copy", copy },
+    { "sprites", sprites },
+    { "timeline", timeline },
+    { "isr", isr },
+    { "adaptive", adaptive },
+    { "recorder", recorder },
+};
+
+int main(int argc, char **argv)
+{
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(Test); i++)
+    {
+        bool selected = argc < 2;
+
+        for (int a = 1; a < argc; a++)
+            if (strcmp(argv[a], tests[i].name) == 0)
+                selected = true;
+
+        if (selected)
+        {
+            printf("--- %s\n", tests[i].name);
+            tests[i].run();
+        }
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
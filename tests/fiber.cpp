@@ -0,0 +1,207 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for the fiber scheduler. The scheduler is built as it is, with the context switching routines
+  * of host/context.cpp, and runs on a stack in SRAM mapped at the address it has on the device. Whenever
+  * the scheduler is idle, simulated time moves on by a system tick, so sleeping fibers wake up.
+  *
+  * Usage: fiber [test ...]
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitFiber.h"
+#include "MicroBitArena.h"
+#include "MicroBitSystemTimer.h"
+#include "ErrorNo.h"
+#include <sys/mman.h>
+
+// The amount of SRAM to map below the top of the stack. Host library calls need far more stack than the device has.
+#define STACK_SIZE      0x10000
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+// The allocator isn't built on the host, so there's never anything to compact.
+int microbit_heap_compact()
+{
+    return 0;
+}
+
+/**
+  * Moves simulated time on by a system tick whenever the scheduler is idle.
+  */
+class Clock : public MicroBitComponent
+{
+    public:
+
+    void idleTick()
+    {
+        host_advance(SYSTEM_TICK_PERIOD_MS * 1000);
+    }
+};
+
+static MicroBitArena callerArena(64);
+static MicroBitArena handlerArena(64);
+
+// What a handler saw before and after it blocked, and the fiber it finished on.
+static MicroBitArena *before;
+static MicroBitArena *after;
+static Fiber *finished;
+
+static void handler()
+{
+    MicroBitArenaScope scope(handlerArena);
+
+    before = microbit_arena_current();
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS * 2);
+    after = microbit_arena_current();
+    finished = currentFiber;
+}
+
+static void handlerParam(void *arena)
+{
+    MicroBitArenaScope scope(*(MicroBitArena *)arena);
+
+    before = microbit_arena_current();
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS * 2);
+    after = microbit_arena_current();
+    finished = currentFiber;
+}
+
+/**
+  * Sleeps until the handler of the last invoke() has finished on the fiber it was forked to.
+  */
+static void join()
+{
+    for (int i = 0; finished == NULL; i++)
+    {
+        check(i < 10, "the forked handler never finished");
+        fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    }
+}
+
+/**
+  * A handler that blocks with an arena active is forked to a new fiber, which keeps allocating from that arena,
+  * while the fiber that called invoke() continues with the arena it had before.
+  */
+static void arena()
+{
+    Fiber *caller = currentFiber;
+
+    before = after = NULL;
+    finished = NULL;
+
+    check(invoke(handler) == MICROBIT_OK, "invoke() failed");
+    check(finished == NULL, "the handler didn't block");
+    check(before == &handlerArena, "the handler's arena wasn't active");
+    check(microbit_arena_current() == NULL, "the caller was left with the arena of the handler that blocked");
+
+    join();
+    check(finished != caller, "the handler finished on the caller's fiber");
+    check(after == &handlerArena, "the forked fiber lost the arena active when it blocked");
+    check(microbit_arena_current() == NULL, "the caller's arena changed while the forked fiber ran");
+
+    // The same, with a parameter, and with an arena already active in the caller.
+    MicroBitArenaScope scope(callerArena);
+
+    before = after = NULL;
+    finished = NULL;
+
+    check(invoke(handlerParam, &handlerArena) == MICROBIT_OK, "invoke() failed");
+    check(finished == NULL, "the handler didn't block");
+    check(before == &handlerArena, "the handler's arena wasn't active");
+    check(microbit_arena_current() == &callerArena, "the caller was left with the arena of the handler that blocked");
+
+    join();
+    check(finished != caller, "the handler finished on the caller's fiber");
+    check(after == &handlerArena, "the forked fiber lost the arena active when it blocked");
+    check(microbit_arena_current() == &callerArena, "the caller's arena changed while the forked fiber ran");
+}
+
+struct Test
+{
+    const char  *name;
+    void        (*run)();
+};
+
+static const Test tests[] = {
+    { "arena", arena },
+};
+
+static int testCount;
+static char **testNames;
+
+/**
+  * Starts the scheduler, and runs the selected tests on the fiber it creates.
+  */
+static void run()
+{
+    static EventModel bus;
+    static Clock clock;
+
+    scheduler_init(bus);
+    fiber_add_idle_component(&clock);
+
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(Test); i++)
+    {
+        bool selected = testCount < 2;
+
+        for (int a = 1; a < testCount; a++)
+            if (strcmp(testNames[a], tests[i].name) == 0)
+                selected = true;
+
+        if (selected)
+        {
+            printf("--- %s\n", tests[i].name);
+            tests[i].run();
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Map the top of SRAM, to hold the stack the scheduler runs on.
+    void *stack = mmap((void *)(CORTEX_M0_STACK_BASE - STACK_SIZE), STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    check(stack == (void *)(CORTEX_M0_STACK_BASE - STACK_SIZE), "SRAM could not be mapped");
+    check((uintptr_t)&run < 0x100000000ULL, "the test must be linked below 4GB");
+
+    testCount = argc;
+    testNames = argv;
+
+    host_run_on_stack(run, CORTEX_M0_STACK_BASE);
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,377 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for MicroBitFont, each checked against a naive reference: a plain UTF-8 decoder, a linear
+  * search of the kerning pairs, and glyphs decoded straight from the font data, bypassing the glyph cache.
+  *
+  * Usage: font [test ...]
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitFont.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+#include <vector>
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+static uint32_t seed = 1;
+
+static int random(int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/**
+  * Decodes one character the long way round: the sequence length from the lead byte, then every
+  * continuation byte, then the shortest form check. Anything else is a single byte, as it is.
+  */
+static uint16_t referenceNext(const uint8_t *s, int length, int &position)
+{
+    uint8_t b = s[position];
+    int extra = (b >= 0xc0 && b < 0xe0) ? 1 : (b >= 0xe0 && b < 0xf0) ? 2 : 0;
+    uint32_t c = extra == 1 ? (b & 0x1f) : (b & 0x0f);
+    bool valid = extra > 0 && position + extra < length;
+
+    for (int i = 1; valid && i <= extra; i++)
+    {
+        valid = s[position + i] >= 0x80 && s[position + i] < 0xc0;
+        c = c * 64 + (s[position + i] - 0x80);
+    }
+
+    if (valid && c >= (extra == 1 ? 0x80u : 0x800u))
+    {
+        position += extra + 1;
+        return c;
+    }
+
+    position++;
+    return b;
+}
+
+/**
+  * Decodes a whole string with both decoders, which must agree on every character and position.
+  */
+static void decode(const uint8_t *s, int length, const char *message)
+{
+    int position = 0;
+    int reference = 0;
+
+    while (reference < length)
+    {
+        uint16_t expected = referenceNext(s, length, reference);
+        uint16_t c = MicroBitFont::nextCharacter((const char *)s, length, position);
+
+        check(c == expected && position == reference, message);
+    }
+
+    check(MicroBitFont::nextCharacter((const char *)s, length, position) == 0 && position == length, "nextCharacter() read past the end of the string");
+}
+
+/**
+  * Characters of every UTF-8 length, cut short at every byte, must come out as the characters that
+  * fit followed by the stray bytes of the one that was cut, one at a time.
+  */
+static void utf8()
+{
+    // A, é, €, and a four byte emoji, which is beyond the font's character codes.
+    static const uint8_t text[] = { 'A', 0xc3, 0xa9, 0xe2, 0x82, 0xac, 0xf0, 0x9f, 0x98, 0x80, 'z' };
+    const int length = sizeof(text);
+
+    int position = 0;
+
+    check(MicroBitFont::nextCharacter((const char *)text, length, position) == 'A' && position == 1, "an ASCII character was not decoded");
+    check(MicroBitFont::nextCharacter((const char *)text, length, position) == 0xe9 && position == 3, "a two byte character was not decoded");
+    check(MicroBitFont::nextCharacter((const char *)text, length, position) == 0x20ac && position == 6, "a three byte character was not decoded");
+    check(MicroBitFont::nextCharacter((const char *)text, length, position) == 0xf0 && position == 7, "a four byte character was not passed through a byte at a time");
+
+    for (int cut = 0; cut <= length; cut++)
+        decode(text, cut, "nextCharacter() disagrees with the reference on a truncated string");
+
+    // A two byte character cut after its lead byte gives the lead byte alone.
+    position = 1;
+    check(MicroBitFont::nextCharacter((const char *)text, 2, position) == 0xc3 && position == 2, "a truncated sequence was not returned as a single byte");
+
+    // Overlong encodings of '/' would otherwise sneak past checks on the decoded text.
+    static const uint8_t overlong[] = { 0xc0, 0xaf, 0xe0, 0x80, 0xaf };
+    decode(overlong, sizeof(overlong), "nextCharacter() disagrees with the reference on an overlong encoding");
+
+    position = 0;
+    check(MicroBitFont::nextCharacter(NULL, 4, position) == 0 && position == 0, "nextCharacter() decoded a NULL string");
+
+    position = -1;
+    check(MicroBitFont::nextCharacter((const char *)text, length, position) == 0, "nextCharacter() decoded before the start of the string");
+
+    // Random bytes, biased towards lead and continuation bytes, so that most sequences are nearly valid.
+    uint8_t random_text[64];
+    int strings = 0;
+
+    for (; strings < 20000; strings++)
+    {
+        int n = random(sizeof(random_text) + 1);
+
+        for (int i = 0; i < n; i++)
+        {
+            switch (random(4))
+            {
+                case 0: random_text[i] = random(0x80); break;
+                case 1: random_text[i] = 0x80 + random(0x40); break;
+                case 2: random_text[i] = 0xc0 + random(0x40); break;
+                default: random_text[i] = random(256); break;
+            }
+        }
+
+        decode(random_text, n, "nextCharacter() disagrees with the reference on random bytes");
+    }
+
+    printf("%d random strings decoded as the reference does\n", strings);
+}
+
+/**
+  * A font built at runtime, with glyphs that can be recognised by their character code.
+  */
+struct TestFont
+{
+    std::vector<MicroBitFontRange> ranges;
+    std::vector<uint16_t> index;
+    std::vector<uint8_t> glyphs;
+    std::vector<MicroBitFontKerning> kerning;
+    MicroBitFontDefinition definition;
+
+    /**
+      * The glyph for a character, or a width of zero if the character has none.
+      */
+    static int glyph(uint16_t c, int variant, uint8_t *columns)
+    {
+        if (c % 11 == 5)
+            return 0;
+
+        int width = 1 + (c + variant) % MICROBIT_FONT_MAX_WIDTH;
+
+        for (int col = 0; col < width; col++)
+            columns[col] = (c * 7 + col * 13 + variant * 31) & 0x7f;
+
+        return width;
+    }
+
+    TestFont(int variant)
+    {
+        static const uint16_t firsts[] = { 0x41, 0xc0, 0x391, 0x20ac };
+        static const uint16_t counts[] = { 40, 32, 25, 1 };
+
+        for (int r = 0; r < 4; r++)
+        {
+            MicroBitFontRange range = { firsts[r], counts[r], (uint16_t)index.size() };
+            ranges.push_back(range);
+
+            for (int i = 0; i < counts[r]; i++)
+            {
+                uint8_t columns[MICROBIT_FONT_MAX_WIDTH];
+                uint8_t encoded[1 + MICROBIT_FONT_MAX_WIDTH];
+                int width = glyph(firsts[r] + i, variant, columns);
+
+                if (width == 0)
+                {
+                    index.push_back(MICROBIT_FONT_NO_GLYPH);
+                    continue;
+                }
+
+                int size = MicroBitFont::encodeGlyph(columns, width, 7, encoded);
+                check(size > 0, "encodeGlyph() failed");
+
+                index.push_back(glyphs.size());
+                glyphs.insert(glyphs.end(), encoded, encoded + size);
+            }
+        }
+
+        definition.height = 7;
+        definition.width = MICROBIT_FONT_MAX_WIDTH;
+        definition.rangeCount = ranges.size();
+        definition.ranges = ranges.data();
+        definition.index = index.data();
+        definition.glyphs = glyphs.data();
+        definition.kerningCount = 0;
+        definition.kerning = NULL;
+    }
+};
+
+/**
+  * Kerning must match a linear search of the pairs, for pairs in the table, either side of them, and at its ends.
+  */
+static void kerning()
+{
+    TestFont test(0);
+    MicroBitFont font(&test.definition);
+
+    check(font.getKerning('A', 'V') == 0, "a font without kerning kerned a pair");
+    check(MicroBitFont().getKerning('A', 'V') == 0, "the legacy font kerned a pair");
+
+    // Sorted pairs, some sharing a left character, with adjustments of both signs.
+    for (int left = 0x41; left < 0x41 + 40; left += 1 + random(3))
+        for (int right = 0x41; right < 0x41 + 40; right += 1 + random(8))
+        {
+            MicroBitFontKerning k = { (uint16_t)left, (uint16_t)right, (int8_t)(random(7) - 3) };
+            test.kerning.push_back(k);
+        }
+
+    test.definition.kerning = test.kerning.data();
+    test.definition.kerningCount = test.kerning.size();
+
+    int pairs = 0;
+
+    for (int left = 0x3f; left < 0x41 + 42; left++)
+        for (int right = 0x3f; right < 0x41 + 42; right++)
+        {
+            int expected = 0;
+
+            for (size_t i = 0; i < test.kerning.size(); i++)
+                if (test.kerning[i].left == left && test.kerning[i].right == right)
+                    expected = test.kerning[i].adjust;
+
+            check(font.getKerning(left, right) == expected, "getKerning() disagrees with a linear search of the pairs");
+            pairs++;
+        }
+
+    check(font.getKerning(0xffff, 0xffff) == 0 && font.getKerning(0, 0) == 0, "getKerning() matched a pair beyond the ends of the table");
+
+    printf("%d pairs looked up against %d kerning entries\n", pairs, (int)test.kerning.size());
+}
+
+/**
+  * Decodes the columns of a legacy 5x5 glyph straight from the font table.
+  */
+static int legacyGlyph(uint16_t c, uint8_t *columns)
+{
+    if (c < MICROBIT_FONT_ASCII_START || c > MICROBIT_FONT_ASCII_END)
+        return 0;
+
+    memset(columns, 0, MICROBIT_FONT_WIDTH);
+
+    for (int y = 0; y < MICROBIT_FONT_HEIGHT; y++)
+        for (int col = 0; col < MICROBIT_FONT_WIDTH; col++)
+            if (MicroBitFont::defaultFont[(c - MICROBIT_FONT_ASCII_START) * MICROBIT_FONT_HEIGHT + y] & (0x10 >> col))
+                columns[col] |= 1 << y;
+
+    return MICROBIT_FONT_WIDTH;
+}
+
+/**
+  * Glyphs of characters and fonts that share a slot of the glyph cache must never be returned for one another,
+  * including after a lookup of a character that has no glyph.
+  */
+static void cache()
+{
+    TestFont a(0);
+    TestFont b(1);
+    MicroBitFont fonts[3] = { MicroBitFont(&a.definition), MicroBitFont(&b.definition), MicroBitFont() };
+    int lookups = 0;
+    int missing = 0;
+
+    for (int i = 0; i < 50000; i++)
+    {
+        int f = random(3);
+
+        // Pick characters from a handful of cache slots, so that most lookups collide with the last.
+        uint16_t c;
+
+        if (f == 2)
+            c = MICROBIT_FONT_ASCII_START + random(3) + MICROBIT_FONT_GLYPH_CACHE_SIZE * random(10);
+        else
+            c = a.ranges[random(3)].first + random(3) + MICROBIT_FONT_GLYPH_CACHE_SIZE * random(4);
+
+        uint8_t expected[MICROBIT_FONT_MAX_WIDTH];
+        uint8_t columns[MICROBIT_FONT_MAX_WIDTH];
+        int width = f == 2 ? legacyGlyph(c, expected) : TestFont::glyph(c, f, expected);
+        bool inFont = false;
+
+        for (int r = 0; f < 2 && r < 4; r++)
+            inFont |= c >= a.ranges[r].first && c < a.ranges[r].first + a.ranges[r].count;
+
+        if (f < 2 && !inFont)
+            width = 0;
+
+        int result = fonts[f].getColumns(c, columns);
+
+        if (width == 0)
+        {
+            check(result == MICROBIT_INVALID_PARAMETER, "a character missing from a font was given a glyph");
+            missing++;
+        }
+        else
+        {
+            check(result == width && memcmp(columns, expected, width) == 0, "the glyph cache returned the wrong glyph");
+        }
+
+        lookups++;
+    }
+
+    check(missing > 0, "no missing characters were looked up");
+
+    printf("%d lookups through a %d entry cache, %d of characters with no glyph\n", lookups, MICROBIT_FONT_GLYPH_CACHE_SIZE, missing);
+}
+
+struct Test
+{
+    const char  *name;
+    void        (*run)();
+};
+
+static const Test tests[] = {
+    { "utf8", utf8 },
+    { "kerning", kerning },
+    { "cache", cache },
+};
+
+int main(int argc, char **argv)
+{
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(Test); i++)
+    {
+        bool selected = argc < 2;
+
+        for (int a = 1; a < argc; a++)
+            if (strcmp(argv[a], tests[i].name) == 0)
+                selected = true;
+
+        if (selected)
+        {
+            printf("--- %s\n", tests[i].name);
+            tests[i].run();
+        }
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host fragmentation stress test for idle time heap compaction.
+  *
+  * Relocatable blocks are interleaved with small ordinary blocks, which are then freed, leaving the free
+  * memory scattered in holes too small for a 1KB allocation. Repeated calls to microbit_heap_compact(), as
+  * made by idle(), must then gather the free memory into a single region large enough for the allocation,
+  * without moving a locked block or disturbing the contents of any block.
+  *
+  * When built with MICROBIT_HEAP_MAX_HANDLES set to 0, relocatable blocks must still be allocated (as ordinary
+  * blocks that are never moved), and compaction must do nothing.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHeapAllocator.h"
+#include "ErrorNo.h"
+
+void *microbit_host_malloc(size_t size);
+void microbit_host_free(void *mem);
+
+extern HeapDefinition heap[];
+extern uint8_t heap_count;
+
+// Referenced by the allocator to find the default heap, which the tests replace with their own.
+extern "C" { int __end__ = 0; }
+
+#define HEAP_SIZE       (4 * 1024)
+#define HANDLES         4
+#define HANDLE_SIZE     600
+#define SMALL_SIZE      300
+#define FILLER_SIZE     16
+#define FILLERS         64
+#define LARGE_SIZE      1024
+
+static uint32_t memory[HEAP_SIZE / 4];
+
+void microbit_panic(int code)
+{
+    printf("FAIL: microbit_panic(%d)\n", code);
+    exit(1);
+}
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+static void fill(MicroBitHeapHandle *h, uint8_t pattern)
+{
+    uint8_t *data = (uint8_t *) microbit_handle_lock(h);
+
+    for (int i = 0; i < HANDLE_SIZE; i++)
+        data[i] = (uint8_t)(pattern + i);
+
+    microbit_handle_unlock(h);
+}
+
+static bool holds_pattern(MicroBitHeapHandle *h, uint8_t pattern)
+{
+    uint8_t *data = (uint8_t *) microbit_handle_lock(h);
+    bool ok = true;
+
+    for (int i = 0; i < HANDLE_SIZE; i++)
+        if (data[i] != (uint8_t)(pattern + i))
+            ok = false;
+
+    microbit_handle_unlock(h);
+
+    return ok;
+}
+
+int main()
+{
+    MicroBitHeapHandle *handles[HANDLES];
+    void *small[HANDLES];
+    void *fillers[FILLERS] = { NULL };
+    MicroBitHeapStats stats;
+
+    if (microbit_create_heap((uintptr_t)memory, (uintptr_t)(memory + HEAP_SIZE / 4)) != MICROBIT_OK)
+        microbit_panic(0);
+
+    // An empty heap has nothing to move, and no relocatable blocks, so compaction must return at once.
+    check(microbit_heap_compact() == 0, "compaction moved something without any relocatable blocks");
+
+    // Lay out the heap as [handle 0][small][handle 1][small][handle 2][small][handle 3][small][fillers...].
+    for (int i = 0; i < HANDLES; i++)
+    {
+        handles[i] = microbit_handle_alloc(HANDLE_SIZE);
+        small[i] = microbit_host_malloc(SMALL_SIZE);
+
+        check(handles[i] != NULL && small[i] != NULL, "initial allocation failed");
+        fill(handles[i], i * 37);
+    }
+
+    for (int i = 0; i < FILLERS; i++)
+        if ((fillers[i] = microbit_host_malloc(FILLER_SIZE)) == NULL)
+            break;
+
+    check(microbit_host_malloc(FILLER_SIZE) == NULL, "heap was not filled");
+
+    // Free everything but the relocatable blocks, leaving holes between them.
+    for (int i = 0; i < HANDLES; i++)
+        microbit_host_free(small[i]);
+
+    for (int i = 0; i < FILLERS; i++)
+        microbit_host_free(fillers[i]);
+
+    microbit_heap_stats(stats);
+    printf("before: %u bytes free in %u regions, largest %u\n", stats.totalFree, stats.freeRegions, stats.largestFree);
+
+    check(stats.totalFree > LARGE_SIZE, "too little free memory for the test");
+    check(stats.largestFree < LARGE_SIZE, "free memory is not fragmented");
+    check(microbit_host_malloc(LARGE_SIZE) == NULL, "large allocation succeeded before compaction");
+
+    // The first block already lies at the start of the heap, and has nowhere to go, but hold it in place anyway.
+    uint8_t *locked = (uint8_t *) microbit_handle_lock(handles[0]);
+
+    int passes = 0;
+    int moved = 0;
+
+    for (int n; (n = microbit_heap_compact()) != 0; passes++)
+    {
+        moved += n;
+        check(microbit_heap_verify(), "microbit_heap_verify() failed during compaction");
+        check(passes < 100, "compaction never finished");
+    }
+
+    check(microbit_handle_lock(handles[0]) == locked, "locked block was moved");
+    microbit_handle_unlock(handles[0]);
+    microbit_handle_unlock(handles[0]);
+
+    for (int i = 0; i < HANDLES; i++)
+        check(holds_pattern(handles[i], i * 37), "relocatable block was corrupted");
+
+    microbit_heap_stats(stats);
+    printf("after %d passes, %d bytes moved: %u bytes free in %u regions, largest %u\n", passes, moved, stats.totalFree, stats.freeRegions, stats.largestFree);
+
+    void *large = microbit_host_malloc(LARGE_SIZE);
+
+#if MICROBIT_HEAP_MAX_HANDLES > 0
+    check(stats.freeRegions == 1, "free memory was not gathered into one region");
+    check(large != NULL, "large allocation failed after compaction");
+#else
+    check(passes == 0, "compaction moved something without a table of relocatable blocks");
+    check(large == NULL, "large allocation succeeded without compaction");
+#endif
+
+    microbit_host_free(large);
+
+    for (int i = 0; i < HANDLES; i++)
+        microbit_handle_free(handles[i]);
+
+    microbit_heap_stats(stats);
+    check(stats.usedBlocks == 0 && stats.totalFree == HEAP_SIZE, "memory leaked");
+
+    printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host fuzz test and benchmark for the micro:bit heap allocator.
+  *
+  * The fuzz test drives malloc, calloc, realloc and free with a random mix of sizes against a heap the
+  * size of the micro:bit's, filling every block with a known pattern. After each operation the heap must
+  * pass microbit_heap_verify(), and every live block must still hold its pattern.
+  *
+  * The benchmark replays allocation mixes typical of the runtime, and reports the time per operation and
+  * the fragmentation of the heap at the end of each. Neither is checked against a threshold, as host timings
+  * vary, but the results can be compared before and after a change to the allocator.
+  *
+  * Usage: heap_fuzz [iterations] [seed]
+  *
+  * The allocator's malloc family is renamed when building for the host (see host/heap.h), so that it doesn't
+  * replace the C library's own.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHeapAllocator.h"
+#include "ErrorNo.h"
+#include <time.h>
+
+void *microbit_host_malloc(size_t size);
+void *microbit_host_calloc(size_t num, size_t size);
+void *microbit_host_realloc(void *ptr, size_t size);
+void microbit_host_free(void *mem);
+
+extern HeapDefinition heap[];
+extern uint8_t heap_count;
+
+// Referenced by the allocator to find the default heap, which the tests replace with their own.
+extern "C" { int __end__ = 0; }
+
+#define HEAP_SIZE       (16 * 1024)
+#define SLOTS           64
+
+static uint32_t memory[HEAP_SIZE / 4];
+
+struct Slot
+{
+    uint8_t     *data;
+    size_t      size;
+    uint8_t     pattern;
+};
+
+static Slot slots[SLOTS];
+
+void microbit_panic(int code)
+{
+    printf("FAIL: microbit_panic(%d)\n", code);
+    exit(1);
+}
+
+static void check(bool condition, const char *message, int iteration)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s (iteration %d)\n", message, iteration);
+        exit(1);
+    }
+}
+
+static void reset_heap()
+{
+    heap_count = 0;
+
+    if (microbit_create_heap((uintptr_t)memory, (uintptr_t)(memory + HEAP_SIZE / 4)) != MICROBIT_OK)
+        microbit_panic(0);
+
+    memset(slots, 0, sizeof(slots));
+}
+
+static bool holds_pattern(Slot &s)
+{
+    for (size_t i = 0; i < s.size; i++)
+        if (s.data[i] != (uint8_t)(s.pattern + i))
+            return false;
+
+    return true;
+}
+
+static void fill(Slot &s, uint8_t pattern)
+{
+    s.pattern = pattern;
+
+    for (size_t i = 0; i < s.size; i++)
+        s.data[i] = (uint8_t)(pattern + i);
+}
+
+static size_t random_size()
+{
+    // Mostly small blocks, as from events and strings, with occasional large buffers.
+    int r = rand() % 100;
+
+    if (r < 70)
+        return 1 + rand() % 32;
+
+    if (r < 95)
+        return 33 + rand() % 256;
+
+    return 289 + rand() % 2048;
+}
+
+static void fuzz(int iterations)
+{
+    reset_heap();
+
+    for (int it = 0; it < iterations; it++)
+    {
+        Slot &s = slots[rand() % SLOTS];
+        int op = rand() % 4;
+
+        if (s.data == NULL)
+        {
+            s.size = random_size();
+
+            if (op == 0)
+            {
+                s.data = (uint8_t *) microbit_host_calloc(1, s.size);
+
+                if (s.data)
+                    for (size_t i = 0; i < s.size; i++)
+                        check(s.data[i] == 0, "calloc returned memory that isn't clear", it);
+            }
+            else
+            {
+                s.data = (uint8_t *) microbit_host_malloc(s.size);
+            }
+
+            if (s.data)
+            {
+                check(((uintptr_t)s.data & 3) == 0, "block is not word aligned", it);
+                check((uint8_t *)s.data >= (uint8_t *)memory && s.data + s.size <= (uint8_t *)(memory + HEAP_SIZE / 4), "block lies outside the heap", it);
+                fill(s, rand());
+            }
+        }
+        else if (op == 0)
+        {
+            // Grow or shrink, keeping the common prefix.
+            size_t size = random_size();
+            uint8_t *data = (uint8_t *) microbit_host_realloc(s.data, size);
+
+            if (data)
+            {
+                for (size_t i = 0; i < (size < s.size ? size : s.size); i++)
+                    check(data[i] == (uint8_t)(s.pattern + i), "realloc lost data", it);
+
+                s.data = data;
+                s.size = size;
+                fill(s, rand());
+            }
+        }
+        else
+        {
+            check(holds_pattern(s), "block was overwritten", it);
+            microbit_host_free(s.data);
+            s.data = NULL;
+        }
+
+        check(microbit_heap_verify(), "microbit_heap_verify() failed", it);
+
+        if (it % 1024 == 0)
+        {
+            MicroBitHeapStats stats;
+            size_t live = 0;
+
+            for (int i = 0; i < SLOTS; i++)
+                if (slots[i].data)
+                {
+                    check(holds_pattern(slots[i]), "block was overwritten", it);
+                    live++;
+                }
+
+            check(microbit_heap_stats(stats) == MICROBIT_OK, "microbit_heap_stats() found corruption", it);
+            check(stats.totalFree + stats.totalUsed == HEAP_SIZE, "heap statistics don't account for the whole heap", it);
+            check(stats.usedBlocks == live, "heap statistics don't match the live blocks", it);
+        }
+    }
+
+    for (int i = 0; i < SLOTS; i++)
+        microbit_host_free(slots[i].data);
+
+    MicroBitHeapStats stats;
+    microbit_heap_stats(stats);
+    check(stats.usedBlocks == 0 && stats.totalFree == HEAP_SIZE, "memory leaked", iterations);
+
+    printf("fuzz: %d operations, ok\n", iterations);
+}
+
+struct Mix
+{
+    const char  *name;
+    int         minSize;
+    int         maxSize;
+    int         live;       // The number of blocks held at any one time.
+};
+
+// Allocation patterns seen in the runtime.
+static const Mix mixes[] = {
+    { "events (16-32 bytes)",       16,     32,     48 },
+    { "strings (8-64 bytes)",       8,      64,     40 },
+    { "images (31-506 bytes)",      31,     506,    16 },
+    { "fiber stacks (512-2048)",    512,    2048,   4 },
+    { "mixed",                      8,      2048,   24 },
+};
+
+static double now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void benchmark(int iterations)
+{
+    printf("\n%-26s %12s %10s %14s\n", "mix", "ns/op", "failed", "fragmentation");
+
+    for (unsigned m = 0; m < sizeof(mixes) / sizeof(Mix); m++)
+    {
+        const Mix &mix = mixes[m];
+        void *live[64] = { NULL };
+        int failed = 0;
+
+        reset_heap();
+
+        double start = now_ns();
+
+        for (int it = 0; it < iterations; it++)
+        {
+            int i = rand() % mix.live;
+
+            if (live[i])
+            {
+                microbit_host_free(live[i]);
+                live[i] = NULL;
+            }
+            else
+            {
+                live[i] = microbit_host_malloc(mix.minSize + rand() % (mix.maxSize - mix.minSize + 1));
+
+                if (live[i] == NULL)
+                    failed++;
+            }
+        }
+
+        double elapsed = now_ns() - start;
+
+        // Fragmentation: the share of free memory that can't be had in a single allocation.
+        MicroBitHeapStats stats;
+        microbit_heap_stats(stats);
+        int fragmentation = stats.totalFree ? 100 - (100 * stats.largestFree) / stats.totalFree : 0;
+
+        printf("%-26s %12.1f %10d %13d%%\n", mix.name, elapsed / iterations, failed, fragmentation);
+
+        check(microbit_heap_verify(), "microbit_heap_verify() failed after benchmark", iterations);
+
+        for (int i = 0; i < mix.live; i++)
+            microbit_host_free(live[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : 1;
+
+    srand(seed);
+
+    fuzz(iterations);
+    benchmark(iterations);
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Stand ins for the context switching routines of source/asm/CortexContextSwitch.s.gcc on an x86-64 host,
+  * so that the fiber scheduler can be built and tested as it is.
+  *
+  * Each routine keeps the semantics of its Cortex-M0 counterpart: stacks are copied between the system stack
+  * and each fiber's stack buffer, and the stack pointer and return address are kept in the SP and LR fields
+  * of the TCB. A host register is 64 bits wide, so the callee saved registers rbx, rbp and r12-r15 are kept
+  * in place of R0-R11. R12 records the return address a context was saved at, which tells a saved context
+  * from one that the scheduler has set up to enter a new fiber with its parameters in R0-R2.
+  *
+  * The scheduler keeps addresses in 32 bit fields, so a test using these routines must be linked below 4GB
+  * (-no-pie), and must run on a stack within the 32 bit address space, e.g. SRAM mapped at the address it
+  * has on the device.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitFiber.h"
+
+#ifndef __x86_64__
+#error "The host context switching routines are written for x86-64"
+#endif
+
+asm(R"(
+    .text
+
+    # Stores the callee saved registers, stack pointer and return address of the caller in the TCB at rdi.
+    .macro save_registers
+    movq    %rbx, 0(%rdi)
+    movq    %rbp, 8(%rdi)
+    movq    %r12, 16(%rdi)
+    movq    %r13, 24(%rdi)
+    movq    %r14, 32(%rdi)
+    movq    %r15, 40(%rdi)
+    movq    (%rsp), %rax
+    movl    %eax, 48(%rdi)
+    movl    %eax, 56(%rdi)
+    leaq    8(%rsp), %rax
+    movl    %eax, 52(%rdi)
+    .endm
+
+    # Restores the callee saved registers from the TCB at the given register.
+    .macro restore_registers tcb
+    movq    0(\tcb), %rbx
+    movq    8(\tcb), %rbp
+    movq    16(\tcb), %r12
+    movq    24(\tcb), %r13
+    movq    32(\tcb), %r14
+    movq    40(\tcb), %r15
+    .endm
+
+    # rdi: the TCB of the fiber being scheduled out, or NULL.
+    # rsi: the TCB of the fiber being scheduled in.
+    # edx: the top of the stack buffer of the fiber being scheduled out, or 0.
+    # ecx: the top of the stack buffer of the fiber being scheduled in, or 0.
+    .globl  swap_context
+swap_context:
+    movq    %rsi, %r8
+    movl    %ecx, %r9d
+
+    testq   %rdi, %rdi
+    jz      1f
+    save_registers
+
+1:  # Copy the stack out, from the stack pointer to the stack base.
+    testl   %edx, %edx
+    jz      2f
+    movl    60(%rdi), %ecx
+    movl    52(%rdi), %esi
+    subl    %esi, %ecx
+    movl    %edx, %edi
+    subq    %rcx, %rdi
+    rep movsb
+
+2:  # Page in the new stack. Nothing is pushed from here on, so the copy may overwrite the old one.
+    movl    52(%r8), %eax
+    movq    %rax, %rsp
+    testl   %r9d, %r9d
+    jz      3f
+    movl    60(%r8), %ecx
+    subl    %eax, %ecx
+    movq    %rax, %rdi
+    movl    %r9d, %esi
+    subq    %rcx, %rsi
+    rep movsb
+
+3:  movl    56(%r8), %eax
+    cmpl    48(%r8), %eax
+    jne     4f
+    restore_registers %r8
+    jmp     *%rax
+
+4:  # A new fiber: enter it as if called with R0-R2 as its parameters.
+    movl    0(%r8), %edi
+    movl    4(%r8), %esi
+    movl    8(%r8), %edx
+    andq    $-16, %rsp
+    pushq   $0
+    jmp     *%rax
+
+    # rdi: the TCB of the fiber to snapshot.
+    # esi: the top of its stack buffer.
+    .globl  save_context
+save_context:
+    save_registers
+    movl    60(%rdi), %ecx
+    movl    52(%rdi), %eax
+    subl    %eax, %ecx
+    movl    %esi, %edi
+    subq    %rcx, %rdi
+    movq    %rax, %rsi
+    rep movsb
+    ret
+
+    # rdi: the TCB of the fiber to snapshot.
+    .globl  save_register_context
+save_register_context:
+    save_registers
+    ret
+
+    # rdi: the TCB of the fiber to restore.
+    .globl  restore_register_context
+restore_register_context:
+    movl    52(%rdi), %eax
+    movq    %rax, %rsp
+    restore_registers %rdi
+    movl    56(%rdi), %eax
+    jmp     *%rax
+
+    # Returns the stack pointer of the caller.
+    .globl  __get_MSP
+__get_MSP:
+    leaq    8(%rsp), %rax
+    ret
+
+    # rdi: a function to call.
+    # esi: the top of the stack to call it on.
+    .globl  host_run_on_stack
+host_run_on_stack:
+    pushq   %rbx
+    movq    %rsp, %rbx
+    movl    %esi, %eax
+    movq    %rax, %rsp
+    call    *%rdi
+    movq    %rbx, %rsp
+    popq    %rbx
+    ret
+)");
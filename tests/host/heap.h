@@ -0,0 +1,48 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Included ahead of the heap allocator when it is built for a host test. The allocator defines malloc and
+  * friends, so they are renamed here to keep them from replacing the host C library's own. The C library
+  * headers are included first, so that its declarations keep their real names.
+  */
+
+#ifndef MICROBIT_HOST_HEAP_H
+#define MICROBIT_HOST_HEAP_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <cstdlib>
+
+// Running out of memory is expected under test, so report it with NULL rather than a panic.
+#define MICROBIT_PANIC_HEAP_FULL    0
+
+#define malloc      microbit_host_malloc
+#define free        microbit_host_free
+#define calloc      microbit_host_calloc
+#define realloc     microbit_host_realloc
+
+#endif
@@ -0,0 +1,167 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Stand ins for the parts of the runtime that can't run on a host: the fiber scheduler, the file system,
+  * and the simulated hardware timers declared in host/mbed.h. Linked into every host test but the heap tests,
+  * which build the allocator on its own. A test that builds the scheduler itself, along with host/context.cpp,
+  * defines HOST_SCHEDULER to leave out its stand ins.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitFiber.h"
+#include "MicroBitFile.h"
+#include "ErrorNo.h"
+
+volatile uint32_t host_us_ticker = 0;
+uint32_t host_busy_us = 0;
+
+int host_pins[32];
+
+// Unless a test builds the scheduler itself, there's no scheduler, so the test is the only fiber.
+#ifndef HOST_SCHEDULER
+Fiber *currentFiber = NULL;
+#endif
+
+static Timeout *timers = NULL;
+
+Timeout::Timeout() : due(0), period(0)
+{
+    next = timers;
+    timers = this;
+}
+
+Timeout::~Timeout()
+{
+    for (Timeout **t = &timers; *t; t = &(*t)->next)
+    {
+        if (*t == this)
+        {
+            *t = next;
+            break;
+        }
+    }
+}
+
+void Timeout::attach(std::function<void()> f, int us)
+{
+    callback = f;
+    due = host_us_ticker + us;
+    period = 0;
+}
+
+void Ticker::attach(std::function<void()> f, int us)
+{
+    callback = f;
+    due = host_us_ticker + us;
+    period = us;
+}
+
+/**
+  * Simulates the passage of time, firing any timers that fall due in the order that they fall due.
+  * A timer that fell due while a callback was busy waiting fires late, as it would on the device.
+  *
+  * @param us The number of microseconds to advance host_us_ticker by.
+  */
+void host_advance(uint32_t us)
+{
+    uint32_t end = host_us_ticker + us;
+
+    while (true)
+    {
+        Timeout *first = NULL;
+
+        // Find the timer due soonest, using signed offsets so that the ticker may wrap around.
+        for (Timeout *t = timers; t; t = t->next)
+            if (t->callback && (int32_t)(t->due - end) <= 0 && (first == NULL || (int32_t)(t->due - first->due) < 0))
+                first = t;
+
+        if (first == NULL)
+            break;
+
+        std::function<void()> f = first->callback;
+
+        // Time never runs backwards, even for a timer that's late.
+        if ((int32_t)(first->due - host_us_ticker) > 0)
+            host_us_ticker = first->due;
+
+        if (first->period)
+            first->due += first->period;
+        else
+            first->callback = nullptr;
+
+        f();
+    }
+
+    if ((int32_t)(end - host_us_ticker) > 0)
+        host_us_ticker = end;
+}
+
+void wait_us(int us)
+{
+    host_us_ticker += us;
+    host_busy_us += us;
+}
+
+void microbit_panic(int code)
+{
+    printf("FAIL: microbit_panic(%d)\n", code);
+    exit(1);
+}
+
+#ifndef HOST_SCHEDULER
+void fiber_sleep(unsigned long t)
+{
+    host_advance(t * 1000);
+}
+
+int fiber_wait_for_event(uint16_t id, uint16_t value)
+{
+    (void) id;
+    (void) value;
+
+    return MICROBIT_OK;
+}
+#endif
+
+int MicroBitFile::setPosition(int position)
+{
+    (void) position;
+
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+int MicroBitFile::getPosition()
+{
+    return MICROBIT_NOT_SUPPORTED;
+}
+
+int MicroBitFile::read(char *buffer, int size)
+{
+    (void) buffer;
+    (void) size;
+
+    return MICROBIT_NOT_SUPPORTED;
+}
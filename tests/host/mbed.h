@@ -0,0 +1,190 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A minimal stand in for the mbed headers, so that parts of the runtime can be built and tested
+  * on a Linux host. Interrupt control does nothing, as host tests are single threaded, and
+  * peripherals are reduced to the few declarations that the runtime headers refer to.
+  */
+
+#ifndef MICROBIT_HOST_MBED_H
+#define MICROBIT_HOST_MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <functional>
+#include "us_ticker_api.h"
+
+#define __disable_irq()         do {} while(0)
+#define __enable_irq()          do {} while(0)
+#define __get_PRIMASK()         0
+#define __set_PRIMASK(x)        ((void)(x))
+#define __get_IPSR()            0
+#define __WFI()                 do {} while(0)
+#define __WFE()                 do {} while(0)
+#define __SEV()                 do {} while(0)
+
+struct _reent;
+
+typedef int PinName;
+enum PinMode { PullUp, PullDown, PullNone };
+enum { Port0 };
+
+enum
+{
+    p0, p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15,
+    p16, p17, p18, p19, p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30,
+    P0_0 = 0, P0_1, P0_2, P0_3, P0_4, P0_5, P0_6, P0_7, P0_8, P0_9, P0_10, P0_11, P0_12, P0_13, P0_14, P0_15,
+    P0_16, P0_17, P0_18, P0_19, P0_20, P0_21, P0_22, P0_23, P0_24, P0_25, P0_26, P0_27, P0_28, P0_29, P0_30,
+    NC = -1,
+    LED_ROW1 = 13, LED_ROW2, LED_ROW3,
+    USBTX = 24, USBRX = 25, I2C_SDA0 = 30, I2C_SCL0 = 0, BUTTON_A = 17, BUTTON_B = 26
+};
+
+struct PortOut
+{
+    uint32_t value;
+    PortOut(int, int) : value(0) {}
+    PortOut& operator= (uint32_t v) { value = v; return *this; }
+    operator int() { return value; }
+};
+
+struct PortIn
+{
+    PortIn(int, int) {}
+    void mode(PinMode) {}
+};
+
+// The level of each GPIO pin, as read through DigitalIn. Tests set these to simulate inputs.
+extern int host_pins[32];
+
+struct DigitalIn
+{
+    int pin;
+    DigitalIn(int name, PinMode) : pin(name) {}
+    operator int() { return host_pins[pin]; }
+};
+
+struct DigitalOut
+{
+    DigitalOut(int) {}
+    void write(int) {}
+};
+
+// A one shot timer. Timers don't run by themselves: host_advance() moves host_us_ticker forwards,
+// firing every timer that falls due along the way, in order.
+class Timeout
+{
+    public:
+
+    std::function<void()> callback;
+    uint32_t due;                   // The value of host_us_ticker at which the timer fires.
+    uint32_t period;                // The interval between repeats, or zero for a one shot timer.
+    Timeout *next;                  // All timers are kept on a list, so host_advance() can find them.
+
+    Timeout();
+    ~Timeout();
+
+    template<typename T>
+    void attach_us(T *object, void (T::*method)(), int us) { attach(std::bind(method, object), us); }
+    void attach_us(void (*function)(), int us) { attach(function, us); }
+    void detach() { callback = nullptr; }
+
+    protected:
+
+    virtual void attach(std::function<void()> f, int us);
+};
+
+// A periodic timer, fired by host_advance() once per period.
+class Ticker : public Timeout
+{
+    protected:
+
+    virtual void attach(std::function<void()> f, int us);
+};
+
+/**
+  * Simulates the passage of time, firing any timers that fall due in the order that they fall due.
+  *
+  * @param us The number of microseconds to advance host_us_ticker by.
+  */
+void host_advance(uint32_t us);
+
+// The total time spent in wait_us(), so tests can measure busy waiting.
+extern uint32_t host_busy_us;
+
+/**
+  * Reads the stack pointer, which the fiber scheduler uses to size its stack buffers.
+  * Defined along with the context switching routines in host/context.cpp, so only tests that link it may call it.
+  */
+extern "C" uint32_t __get_MSP(void);
+
+/**
+  * Calls a function on another stack, as the fiber scheduler can only run on a stack in the 32 bit address space.
+  * Defined in host/context.cpp.
+  *
+  * @param fn The function to call.
+  *
+  * @param stack The top of the stack to call it on.
+  */
+extern "C" void host_run_on_stack(void (*fn)(), uint32_t stack);
+
+// The ADC registers used by the light sensor. A test sets RESULT to the next conversion to return.
+struct NRF_ADC_Type
+{
+    volatile uint32_t ENABLE, CONFIG, TASKS_START, BUSY, RESULT;
+};
+
+inline NRF_ADC_Type *host_nrf_adc() { static NRF_ADC_Type adc; return &adc; }
+
+#define NRF_ADC                                         (host_nrf_adc())
+#define ADC_ENABLE_ENABLE_Enabled                       1
+#define ADC_ENABLE_ENABLE_Disabled                      0
+#define ADC_CONFIG_RES_8bit                             0
+#define ADC_CONFIG_RES_10bit                            2
+#define ADC_CONFIG_RES_Pos                              0
+#define ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling 2
+#define ADC_CONFIG_INPSEL_SupplyTwoThirdsPrescaling     5
+#define ADC_CONFIG_INPSEL_Pos                           2
+#define ADC_CONFIG_REFSEL_VBG                           0
+#define ADC_CONFIG_REFSEL_Pos                           5
+#define ADC_CONFIG_PSEL_Disabled                        0
+#define ADC_CONFIG_PSEL_Pos                             8
+#define ADC_CONFIG_EXTREFSEL_None                       0
+#define ADC_CONFIG_EXTREFSEL_Pos                        16
+#define ADC_BUSY_BUSY_Msk                               1
+
+/**
+  * Busy waits, as a driver would in interrupt context. The ticker moves on by the time spent,
+  * which is also added to host_busy_us, but no timers fire until host_advance() is next called.
+  */
+void wait_us(int us);
+
+static inline void wait_ms(int) {}
+
+#endif
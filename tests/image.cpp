@@ -0,0 +1,856 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for MicroBitImage.
+  *
+  * Usage: image [test ...]
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitImage.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+#include <chrono>
+#include <vector>
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+/**
+  * Returns the time taken by the given function, averaged over a number of runs, in nanoseconds.
+  */
+template <typename F> static double timeOf(F f, int runs)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < runs; i++)
+        f();
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+MICROBIT_IMAGE_LITERAL(heart, 5, 5, 0,255,0,255,0, 255,255,255,255,255, 255,255,255,255,255, 0,255,255,255,0, 0,0,255,0,0);
+MICROBIT_IMAGE_LITERAL(square, 5, 5, 255,255,255,255,255, 255,0,0,0,255, 255,0,0,0,255, 255,0,0,0,255, 255,255,255,255,255);
+MICROBIT_IMAGE_LITERAL(cross, 5, 5, 255,0,0,0,255, 0,255,0,255,0, 0,0,255,0,0, 0,255,0,255,0, 255,0,0,0,255);
+MICROBIT_IMAGE_LITERAL(diamond, 5, 5, 0,0,255,0,0, 0,255,0,255,0, 255,0,0,0,255, 0,255,0,255,0, 0,0,255,0,0);
+MICROBIT_IMAGE_LITERAL(dim, 5, 5, 0,0,0,0,0, 0,16,16,16,0, 0,16,64,16,0, 0,16,16,16,0, 0,0,0,0,0);
+MICROBIT_IMAGE_LITERAL_FORMAT(tick, 5, 5, MICROBIT_IMAGE_FORMAT_1BPP, 0x00, 0x10, 0x08, 0x05, 0x02);
+
+static const uint8_t *literals[] = { heart, square, cross, diamond, dim };
+
+static const char *strings[] = {
+    "0,255,0,255,0\n255,255,255,255,255\n255,255,255,255,255\n0,255,255,255,0\n0,0,255,0,0\n",
+    "255,255,255,255,255\n255,0,0,0,255\n255,0,0,0,255\n255,0,0,0,255\n255,255,255,255,255\n",
+    "255,0,0,0,255\n0,255,0,255,0\n0,0,255,0,0\n0,255,0,255,0\n255,0,0,0,255\n",
+    "0,0,255,0,0\n0,255,0,255,0\n255,0,0,0,255\n0,255,0,255,0\n0,0,255,0,0\n",
+    "0,0,0,0,0\n0,16,16,16,0\n0,16,64,16,0\n0,16,16,16,0\n0,0,0,0,0\n",
+};
+
+/**
+  * A literal must be used in place, and hold the same pixels as the equivalent parsed image.
+  */
+static void literals_in_flash()
+{
+    for (int i = 0; i < 5; i++)
+    {
+        MicroBitImage literal = MICROBIT_IMAGE(literals[i]);
+        MicroBitImage parsed(strings[i]);
+
+        check(literal.isReadOnly(), "a literal should be read only");
+        check(literal.getBitmap() == literals[i] + sizeof(ImageData), "a literal was copied rather than used in place");
+        check(literal == parsed, "a literal differs from the image it was written from");
+    }
+
+    MicroBitImage t = MICROBIT_IMAGE(tick);
+    check(t.getFormat() == MICROBIT_IMAGE_FORMAT_1BPP && t.getWidth() == 5 && t.getHeight() == 5, "a packed literal has the wrong shape");
+    check(t.getPixelValue(4, 1) == 255 && t.getPixelValue(3, 2) == 255 && t.getPixelValue(0, 3) == 255 && t.getPixelValue(1, 4) == 255, "a packed literal has the wrong pixels");
+    check(t.getPixelValue(0, 0) == 0 && t.getPixelValue(4, 4) == 0, "a packed literal has extra pixels");
+
+    // Writing to a literal must take a private copy, and leave the flash alone.
+    MicroBitImage h = MICROBIT_IMAGE(heart);
+    h.setPixelValue(0, 0, 255);
+    check(!h.isReadOnly() && h.getPixelValue(0, 0) == 255, "a written literal was not copied");
+    check(MICROBIT_IMAGE(heart).getPixelValue(0, 0) == 0, "writing to an image changed its literal");
+}
+
+/**
+  * Compares the cost of creating the images of an app with 50 image literals, from compiled literals and from text.
+  */
+static void startup()
+{
+    int sum = 0;
+
+    double literal = timeOf([&]() {
+        for (int i = 0; i < 50; i++)
+            sum += MICROBIT_IMAGE(literals[i % 5]).getWidth();
+    }, 10000);
+
+    double parsed = timeOf([&]() {
+        for (int i = 0; i < 50; i++)
+            sum += MicroBitImage(strings[i % 5]).getWidth();
+    }, 10000);
+
+    check(sum == 2 * 10000 * 50 * 5, "the benchmark created the wrong images");
+
+    // Literals allocate nothing, whereas every parsed image holds its own copy of the data on the heap.
+    printf("50 images: %.0f ns from literals, %.0f ns parsed from text, which allocates %d bytes\n",
+        literal, parsed, (int)(50 * (sizeof(ImageData) + 25)));
+}
+
+/**
+  * A plain model of an image, one value per pixel, that every operation is checked against.
+  * Values are held at the level their format stores them at, so packed images can be compared exactly.
+  */
+struct Reference
+{
+    int width;
+    int height;
+    int format;
+    std::vector<uint8_t> pixels;
+
+    Reference(int width, int height, int format) : width(width), height(height), format(format), pixels(width * height, 0) {}
+
+    static uint8_t level(uint8_t value, int format)
+    {
+        if (format == MICROBIT_IMAGE_FORMAT_1BPP)
+            return value ? 255 : 0;
+
+        if (format == MICROBIT_IMAGE_FORMAT_4BPP)
+            return ((value + 16) / 17) * 17;
+
+        return value;
+    }
+
+    uint8_t get(int x, int y) const
+    {
+        return pixels[y * width + x];
+    }
+
+    void set(int x, int y, uint8_t value)
+    {
+        pixels[y * width + x] = level(value, format);
+    }
+
+    int paste(const Reference &image, int x, int y, bool alpha)
+    {
+        Reference source = image;
+        int written = 0;
+
+        for (int sy = 0; sy < source.height; sy++)
+            for (int sx = 0; sx < source.width; sx++)
+            {
+                int dx = x + sx;
+                int dy = y + sy;
+                uint8_t v = source.get(sx, sy);
+
+                if (dx >= 0 && dx < width && dy >= 0 && dy < height && (v || !alpha))
+                {
+                    set(dx, dy, v);
+                    written++;
+                }
+            }
+
+        return written;
+    }
+
+    void shift(int dx, int dy)
+    {
+        Reference source = *this;
+
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+            {
+                int sx = x - dx;
+                int sy = y - dy;
+                pixels[y * width + x] = (sx >= 0 && sx < width && sy >= 0 && sy < height) ? source.get(sx, sy) : 0;
+            }
+    }
+};
+
+static uint32_t seed = 1;
+
+static int random(int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/**
+  * Picks a pixel value, favouring the values at the edges of each format's levels.
+  */
+static uint8_t randomValue()
+{
+    static const uint8_t edges[] = { 0, 0, 0, 1, 8, 9, 16, 17, 18, 127, 128, 129, 254, 255 };
+
+    return random(2) ? edges[random(sizeof(edges))] : random(256);
+}
+
+static void fill(MicroBitImage &image, Reference &reference)
+{
+    for (int y = 0; y < reference.height; y++)
+        for (int x = 0; x < reference.width; x++)
+        {
+            uint8_t v = random(3) ? 0 : randomValue();
+            image.setPixelValue(x, y, v);
+            reference.set(x, y, v);
+        }
+}
+
+static void compare(MicroBitImage &image, const Reference &reference, const char *message)
+{
+    check(image.getWidth() == reference.width && image.getHeight() == reference.height, message);
+
+    for (int y = 0; y < reference.height; y++)
+        for (int x = 0; x < reference.width; x++)
+            if (image.getPixelValue(x, y) != reference.get(x, y))
+            {
+                printf("pixel %d,%d of a %dx%d image in format %d is %d, expected %d\n", x, y,
+                    reference.width, reference.height, reference.format, image.getPixelValue(x, y), reference.get(x, y));
+                check(false, message);
+            }
+}
+
+/**
+  * Packed images must hold the same pixels as the model through pastes between every pair of formats,
+  * shifts and crops, at widths that do and don't fill their last byte.
+  */
+static void formats()
+{
+    static const int widths[] = { 1, 3, 5, 7, 8, 9, 13, 17, 100 };
+    static const int heights[] = { 1, 5, 7 };
+
+    MicroBitImage scroll8(100, 5, MICROBIT_IMAGE_FORMAT_8BPP);
+    MicroBitImage scroll4(100, 5, MICROBIT_IMAGE_FORMAT_4BPP);
+    MicroBitImage scroll1(100, 5, MICROBIT_IMAGE_FORMAT_1BPP);
+
+    printf("a 100x5 scroll buffer takes %d bytes at 8bpp, %d at 4bpp and %d at 1bpp\n", scroll8.getSize(), scroll4.getSize(), scroll1.getSize());
+    check(scroll8.getSize() == 500 && scroll4.getSize() == 250 && scroll1.getSize() == 65, "a packed scroll buffer is the wrong size");
+
+    for (int round = 0; round < 3000; round++)
+    {
+        int format = random(3);
+        int width = widths[random(sizeof(widths) / sizeof(int))];
+        int height = heights[random(sizeof(heights) / sizeof(int))];
+
+        MicroBitImage image(width, height, (ImageFormat) format);
+        Reference reference(width, height, format);
+
+        check(image.getFormat() == format, "an image was created in the wrong format");
+        compare(image, reference, "a new image is not blank");
+
+        fill(image, reference);
+        compare(image, reference, "setPixelValue() stored the wrong level");
+
+        for (int op = 0; op < 8; op++)
+        {
+            switch (random(7))
+            {
+                case 0:
+                {
+                    // Paste from an image of any format, at any overlapping position.
+                    int sformat = random(3);
+                    int swidth = widths[random(sizeof(widths) / sizeof(int))];
+                    int sheight = heights[random(sizeof(heights) / sizeof(int))];
+
+                    MicroBitImage source(swidth, sheight, (ImageFormat) sformat);
+                    Reference sreference(swidth, sheight, sformat);
+                    fill(source, sreference);
+
+                    int x = random(width + swidth) - swidth;
+                    int y = random(height + sheight) - sheight;
+                    bool alpha = random(2);
+
+                    int expected = reference.paste(sreference, x, y, alpha);
+                    int written = image.paste(source, x, y, alpha);
+
+                    check(written == expected, "paste() reported the wrong number of pixels written");
+                    compare(image, reference, "paste() between formats gave the wrong pixels");
+                    break;
+                }
+
+                case 1:
+                {
+                    // Paste an image into itself, overlapping it in any direction.
+                    int x = random(2 * width - 1) - (width - 1);
+                    int y = random(2 * height - 1) - (height - 1);
+                    bool alpha = random(2);
+
+                    reference.paste(reference, x, y, alpha);
+                    image.paste(image, x, y, alpha);
+                    compare(image, reference, "paste() of an image into itself gave the wrong pixels");
+                    break;
+                }
+
+                case 2:
+                {
+                    int n = 1 + random(width + 1);
+                    image.shiftLeft(n);
+                    reference.shift(-n, 0);
+                    compare(image, reference, "shiftLeft() gave the wrong pixels");
+                    break;
+                }
+
+                case 3:
+                {
+                    int n = 1 + random(width + 1);
+                    image.shiftRight(n);
+                    reference.shift(n, 0);
+                    compare(image, reference, "shiftRight() gave the wrong pixels");
+                    break;
+                }
+
+                case 4:
+                {
+                    int n = 1 + random(height + 1);
+                    image.shiftUp(n);
+                    reference.shift(0, -n);
+                    compare(image, reference, "shiftUp() gave the wrong pixels");
+                    break;
+                }
+
+                case 5:
+                {
+                    int n = 1 + random(height + 1);
+                    image.shiftDown(n);
+                    reference.shift(0, n);
+                    compare(image, reference, "shiftDown() gave the wrong pixels");
+                    break;
+                }
+
+                case 6:
+                {
+                    // Crops keep the format of the image they are taken from.
+                    int x = random(width);
+                    int y = random(height);
+                    int w = 1 + random(width - x);
+                    int h = 1 + random(height - y);
+
+                    MicroBitImage cropped = image.crop(x, y, w, h);
+                    Reference creference(w, h, format);
+                    creference.paste(reference, -x, -y, false);
+
+                    check(cropped.getFormat() == format, "crop() changed the format");
+                    compare(cropped, creference, "crop() gave the wrong pixels");
+                    break;
+                }
+            }
+        }
+
+        // Converting to any format and back must only lose what the narrower format can't hold.
+        int to = random(3);
+        MicroBitImage converted = image.convert((ImageFormat) to);
+        Reference creference(width, height, to);
+        creference.paste(reference, 0, 0, false);
+
+        check(converted.getFormat() == to, "convert() gave the wrong format");
+        compare(converted, creference, "convert() gave the wrong pixels");
+    }
+}
+
+/**
+  * The byte per pixel alpha keyed paste must match the model at every alignment of source and destination,
+  * for values on either side of each boundary the word operations test for.
+  */
+static void kernels()
+{
+    static const uint8_t edges[] = { 0, 1, 0x7f, 0x80, 0x81, 0xfe, 0xff };
+
+    for (int swidth = 1; swidth <= 37; swidth++)
+    {
+        MicroBitImage source(swidth, 3);
+        Reference sreference(swidth, 3, MICROBIT_IMAGE_FORMAT_8BPP);
+
+        for (int y = 0; y < 3; y++)
+            for (int x = 0; x < swidth; x++)
+            {
+                uint8_t v = edges[random(sizeof(edges))];
+                source.setPixelValue(x, y, v);
+                sreference.set(x, y, v);
+            }
+
+        for (int x = -swidth; x <= 40; x++)
+        {
+            MicroBitImage image(40, 4);
+            Reference reference(40, 4, MICROBIT_IMAGE_FORMAT_8BPP);
+            fill(image, reference);
+
+            int y = random(4) - 1;
+            bool alpha = random(4) != 0;
+
+            int expected = reference.paste(sreference, x, y, alpha);
+            int written = image.paste(source, x, y, alpha);
+
+            check(written == expected, "paste() reported the wrong number of pixels written");
+            compare(image, reference, "paste() of a byte per pixel image gave the wrong pixels");
+        }
+    }
+
+    // A paste of an image into itself may overlap it in any direction, in every format.
+    for (int round = 0; round < 3000; round++)
+    {
+        int format = random(3);
+        int width = 1 + random(40);
+        int height = 1 + random(6);
+        MicroBitImage image(width, height, (ImageFormat) format);
+        Reference reference(width, height, format);
+        fill(image, reference);
+
+        int x = random(2 * width + 1) - width;
+        int y = random(2 * height + 1) - height;
+        bool alpha = random(2);
+
+        int expected = reference.paste(reference, x, y, alpha);
+        int written = image.paste(image, x, y, alpha);
+
+        check(written == expected, "paste() of an image into itself reported the wrong number of pixels written");
+        compare(image, reference, "paste() of an image into itself gave the wrong pixels");
+    }
+
+    // Shifting one pixel at a time must walk every pixel through every alignment.
+    MicroBitImage image(37, 5);
+    Reference reference(37, 5, MICROBIT_IMAGE_FORMAT_8BPP);
+    fill(image, reference);
+
+    for (int i = 0; i < 37; i++)
+    {
+        MicroBitImage left = image;
+        Reference lreference = reference;
+
+        left.shiftLeft(i + 1);
+        lreference.shift(-(i + 1), 0);
+        compare(left, lreference, "shiftLeft() of a byte per pixel image gave the wrong pixels");
+
+        MicroBitImage right = image;
+        Reference rreference = reference;
+
+        right.shiftRight(i + 1);
+        rreference.shift(i + 1, 0);
+        compare(right, rreference, "shiftRight() of a byte per pixel image gave the wrong pixels");
+    }
+}
+
+/**
+  * The byte per pixel alpha keyed paste as it was before the word operations: a branch per pixel.
+  * It takes the same steps into the image as paste() does, so that only the copying differs, and like paste()
+  * it is never inlined into or specialised for the benchmark, which would fold the constants it is called with.
+  */
+__attribute__((noipa)) static int legacyPasteAlpha(MicroBitImage &out, MicroBitImage &in, int x, int y)
+{
+    int width = out.getWidth();
+    int height = out.getHeight();
+    int swidth = in.getWidth();
+    int sheight = in.getHeight();
+
+    if (x >= width || y >= height || x + swidth <= 0 || y + sheight <= 0)
+        return 0;
+
+    out.detach();
+
+    int cx = x < 0 ? min(swidth + x, width) : min(swidth, width - x);
+    int cy = y < 0 ? min(sheight + y, height) : min(sheight, height - y);
+    int written = 0;
+
+    const uint8_t *pIn = in.getBitmap() + ((x < 0) ? -x : 0) + ((y < 0) ? -swidth * y : 0);
+    uint8_t *pOut = out.getBitmap() + ((x > 0) ? x : 0) + ((y > 0) ? width * y : 0);
+
+    for (int i = 0; i < cy; i++)
+    {
+        for (int j = 0; j < cx; j++)
+        {
+            if (pIn[j] != 0)
+            {
+                pOut[j] = pIn[j];
+                written++;
+            }
+        }
+
+        pIn += swidth;
+        pOut += width;
+    }
+
+    return written;
+}
+
+/**
+  * The byte per pixel shifts as they were before the whole bitmap was moved at once: a copy per row.
+  */
+__attribute__((noipa)) static void legacyShiftLeft(MicroBitImage &image, int n)
+{
+    int width = image.getWidth();
+
+    image.detach();
+    uint8_t *p = image.getBitmap();
+
+    for (int y = 0; y < image.getHeight(); y++)
+    {
+        memmove(p, p + n, width - n);
+        memset(p + width - n, 0, n);
+        p += width;
+    }
+}
+
+__attribute__((noipa)) static void legacyShiftUp(MicroBitImage &image, int n)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+
+    image.detach();
+    uint8_t *pOut = image.getBitmap();
+    uint8_t *pIn = pOut + width * n;
+
+    for (int y = 0; y < height; y++)
+    {
+        if (y < height - n)
+            memcpy(pOut, pIn, width);
+        else
+            memset(pOut, 0, width);
+
+        pIn += width;
+        pOut += width;
+    }
+}
+
+/**
+  * Times the blits of typical scroll and animation workloads against the per pixel code they replaced.
+  * The figures are host timings, so only their ratios mean anything for the device.
+  */
+static void blit()
+{
+    const int runs = 200000;
+
+    MicroBitImage glyph(5, 5), screen(5, 5), strip(100, 5), canvas(100, 5);
+    Reference r5(5, 5, MICROBIT_IMAGE_FORMAT_8BPP), r100(100, 5, MICROBIT_IMAGE_FORMAT_8BPP);
+
+    fill(glyph, r5);
+    fill(strip, r100);
+
+    volatile int sink = 0;
+    int step = 0;
+
+    struct Result
+    {
+        const char *name;
+        double before;
+        double after;
+    };
+
+    Result results[] = {
+        { "5x5 glyph, alpha",
+            timeOf([&]() { sink = legacyPasteAlpha(screen, glyph, 0, 0); }, runs),
+            timeOf([&]() { sink = screen.paste(glyph, 0, 0, 255); }, runs) },
+        { "100x5 strip scrolled into 5x5, alpha",
+            timeOf([&]() { sink = legacyPasteAlpha(screen, strip, -(step++ % 100), 0); }, runs),
+            timeOf([&]() { sink = screen.paste(strip, -(step++ % 100), 0, 255); }, runs) },
+        { "100x5 strip onto 100x5, alpha",
+            timeOf([&]() { sink = legacyPasteAlpha(canvas, strip, 1, 0); }, runs),
+            timeOf([&]() { sink = canvas.paste(strip, 1, 0, 255); }, runs) },
+        { "100x5 shiftLeft(1)",
+            timeOf([&]() { legacyShiftLeft(canvas, 1); }, runs),
+            timeOf([&]() { canvas.shiftLeft(1); }, runs) },
+        { "100x5 shiftUp(1)",
+            timeOf([&]() { legacyShiftUp(canvas, 1); }, runs),
+            timeOf([&]() { canvas.shiftUp(1); }, runs) },
+    };
+
+    for (unsigned i = 0; i < sizeof(results) / sizeof(Result); i++)
+        printf("%-40s %7.1f ns per pixel loop, %7.1f ns now\n", results[i].name, results[i].before, results[i].after);
+
+    (void) sink;
+}
+
+/**
+  * Sets a pixel of the reference, if it lies within it. The naive drawing below clips every pixel this way.
+  */
+static void plot(Reference &reference, int x, int y, uint8_t value)
+{
+    if (x >= 0 && x < reference.width && y >= 0 && y < reference.height)
+        reference.set(x, y, value);
+}
+
+/**
+  * Every point of Bresenham's line, including both ends, without any of the image's special cases.
+  */
+static void referenceLine(Reference &reference, int x0, int y0, int x1, int y1, uint8_t value)
+{
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+
+    while (true)
+    {
+        plot(reference, x0, y0, value);
+
+        if (x0 == x1 && y0 == y1)
+            break;
+
+        int e2 = 2 * err;
+
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+/**
+  * The points of a midpoint circle. Filled circles fill each row between the outermost points of the outline on it.
+  */
+static void referenceCircle(Reference &reference, int cx, int cy, int radius, uint8_t value, bool fill)
+{
+    std::vector<int> left(2 * radius + 1, cx);
+    std::vector<int> right(2 * radius + 1, cx);
+    int dx = radius;
+    int dy = 0;
+    int err = 1 - radius;
+
+    while (dx >= dy)
+    {
+        const int px[8] = { cx + dx, cx - dx, cx + dx, cx - dx, cx + dy, cx - dy, cx + dy, cx - dy };
+        const int py[8] = { cy + dy, cy + dy, cy - dy, cy - dy, cy + dx, cy + dx, cy - dx, cy - dx };
+
+        for (int i = 0; i < 8; i++)
+        {
+            if (!fill)
+                plot(reference, px[i], py[i], value);
+
+            left[py[i] - cy + radius] = min(left[py[i] - cy + radius], px[i]);
+            right[py[i] - cy + radius] = max(right[py[i] - cy + radius], px[i]);
+        }
+
+        dy++;
+
+        if (err < 0)
+        {
+            err += 2 * dy + 1;
+        }
+        else
+        {
+            dx--;
+            err += 2 * (dy - dx) + 1;
+        }
+    }
+
+    if (fill)
+        for (int row = 0; row <= 2 * radius; row++)
+            for (int x = left[row]; x <= right[row]; x++)
+                plot(reference, x, cy - radius + row, value);
+}
+
+/**
+  * Fills the pixels connected to a point, one at a time, from a queue.
+  */
+static void referenceFlood(Reference &reference, int x, int y, uint8_t value)
+{
+    uint8_t target = reference.get(x, y);
+
+    if (Reference::level(value, reference.format) == target)
+        return;
+
+    std::vector<int> queue(1, y * reference.width + x);
+    reference.set(x, y, value);
+
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        int px = queue[i] % reference.width;
+        int py = queue[i] / reference.width;
+        const int nx[4] = { px - 1, px + 1, px, px };
+        const int ny[4] = { py, py, py - 1, py + 1 };
+
+        for (int n = 0; n < 4; n++)
+            if (nx[n] >= 0 && nx[n] < reference.width && ny[n] >= 0 && ny[n] < reference.height && reference.get(nx[n], ny[n]) == target)
+            {
+                reference.set(nx[n], ny[n], value);
+                queue.push_back(ny[n] * reference.width + nx[n]);
+            }
+    }
+}
+
+/**
+  * A co-ordinate for a shape of the given size, either within an image of the given size, or anywhere
+  * from well off one edge to well off the other, so that the shape is clipped.
+  */
+static int coordinate(int size, int shape, bool clipped)
+{
+    return clipped ? random(size + 2 * shape + 8) - shape - 4 : random(max(size - shape, 1));
+}
+
+/**
+  * The drawing primitives must match naive, pixel by pixel versions of the same shapes, clipped and unclipped,
+  * in every format. Flood fills are checked on images of a few values, so they have regions to fill.
+  */
+static void drawing()
+{
+    static const ImageFormat formats[] = { MICROBIT_IMAGE_FORMAT_8BPP, MICROBIT_IMAGE_FORMAT_4BPP, MICROBIT_IMAGE_FORMAT_1BPP };
+    static const uint8_t regions[] = { 0, 0, 128, 255 };
+    int shapes = 0;
+
+    for (int f = 0; f < 3; f++)
+    {
+        for (int round = 0; round < 2000; round++)
+        {
+            int width = 1 + random(40);
+            int height = 1 + random(20);
+            bool clipped = random(2);
+
+            MicroBitImage image(width, height, formats[f]);
+            Reference reference(width, height, formats[f]);
+            uint8_t value = randomValue();
+
+            fill(image, reference);
+
+            switch (random(4))
+            {
+                case 0:
+                {
+                    int w = random(width + 4);
+                    int h = random(height + 4);
+                    int x = coordinate(width, w, clipped);
+                    int y = coordinate(height, h, clipped);
+
+                    check(image.fillRect(x, y, w, h, value) == MICROBIT_OK, "fillRect() failed");
+
+                    for (int j = y; j < y + h; j++)
+                        for (int i = x; i < x + w; i++)
+                            plot(reference, i, j, value);
+
+                    compare(image, reference, "fillRect() differs from the naive fill");
+                    break;
+                }
+
+                case 1:
+                {
+                    int x0 = coordinate(width, 0, clipped);
+                    int y0 = coordinate(height, 0, clipped);
+                    int x1 = random(4) ? coordinate(width, 0, clipped) : x0;
+                    int y1 = random(4) ? coordinate(height, 0, clipped) : y0;
+
+                    check(image.drawLine(x0, y0, x1, y1, value) == MICROBIT_OK, "drawLine() failed");
+                    referenceLine(reference, x0, y0, x1, y1, value);
+
+                    compare(image, reference, "drawLine() differs from the naive line");
+                    break;
+                }
+
+                case 2:
+                {
+                    int radius = random(min(width, height) / 2 + (clipped ? 8 : 1));
+                    int x = coordinate(width, 2 * radius, clipped) + radius;
+                    int y = coordinate(height, 2 * radius, clipped) + radius;
+                    bool solid = random(2);
+
+                    check(image.drawCircle(x, y, radius, value, solid) == MICROBIT_OK, "drawCircle() failed");
+                    referenceCircle(reference, x, y, radius, value, solid);
+
+                    compare(image, reference, solid ? "a filled drawCircle() differs from the naive circle" : "drawCircle() differs from the naive circle");
+                    break;
+                }
+
+                case 3:
+                {
+                    for (int y = 0; y < height; y++)
+                        for (int x = 0; x < width; x++)
+                        {
+                            uint8_t v = regions[random(sizeof(regions))];
+                            image.setPixelValue(x, y, v);
+                            reference.set(x, y, v);
+                        }
+
+                    int x = random(width);
+                    int y = random(height);
+
+                    check(image.floodFill(x, y, value) == MICROBIT_OK, "floodFill() failed");
+                    check(image.floodFill(clipped ? -1 : width, y, value) == MICROBIT_INVALID_PARAMETER, "floodFill() accepted a point outside the image");
+                    referenceFlood(reference, x, y, value);
+
+                    compare(image, reference, "floodFill() differs from the naive fill");
+                    break;
+                }
+            }
+
+            shapes++;
+        }
+    }
+
+    MicroBitImage image(5, 5);
+
+    check(image.fillRect(0, 0, -1, 1, 255) == MICROBIT_INVALID_PARAMETER, "fillRect() accepted a negative width");
+    check(image.drawCircle(2, 2, -1, 255) == MICROBIT_INVALID_PARAMETER, "drawCircle() accepted a negative radius");
+
+    printf("%d shapes matched the naive drawing\n", shapes);
+}
+
+struct Test
+{
+    const char  *name;
+    void        (*run)();
+};
+
+static const Test tests[] = {
+    { "literals", literals_in_flash },
+    { "startup", startup },
+    { "formats", formats },
+    { "kernels", kernels },
+    { "blit", blit },
+    { "drawing", drawing },
+};
+
+int main(int argc, char **argv)
+{
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(Test); i++)
+    {
+        bool selected = argc < 2;
+
+        for (int a = 1; a < argc; a++)
+            if (strcmp(argv[a], tests[i].name) == 0)
+                selected = true;
+
+        if (selected)
+        {
+            printf("--- %s\n", tests[i].name);
+            tests[i].run();
+        }
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
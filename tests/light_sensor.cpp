@@ -0,0 +1,229 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for MicroBitLightSensor. Sensing slots are started by hand, as the display would, and the
+  * simulated ADC in host/mbed.h returns whatever reading a test sets.
+  *
+  * Usage: light_sensor [test ...]
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitLightSensor.h"
+#include "MicroBitDisplay.h"
+#include "EventModel.h"
+#include "ErrorNo.h"
+
+// The ADC reading used throughout, and the light level it gives when every channel reads it.
+#define READING     200
+#define LEVEL       133
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+/**
+  * Runs a single sensing slot to completion.
+  */
+static void sense(MicroBitLightSensor &sensor, int reading = READING)
+{
+    NRF_ADC->RESULT = reading;
+
+    sensor.startSensing(MicroBitEvent(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, CREATE_ONLY));
+    host_advance(MICROBIT_LIGHT_SENSOR_AN_SET_TIME);
+}
+
+/**
+  * Before any reading, the sensor reports full brightness. The first reading is then taken as it is,
+  * however much smoothing is configured.
+  */
+static void initial()
+{
+    MicroBitLightSensor sensor(microbitMatrixMap);
+
+    check(sensor.read() == 255, "the light level before any reading has changed");
+
+    sensor.setContinuous(true);
+    sensor.setSmoothing(4);
+    sense(sensor);
+
+    printf("first reading gives %d\n", sensor.read());
+    check(sensor.read() == LEVEL, "the first reading was smoothed towards from zero");
+
+    // Later readings are smoothed as usual.
+    sense(sensor, 0);
+
+    check(sensor.read() > LEVEL && sensor.read() < 255, "a later reading was not smoothed");
+}
+
+/**
+  * A sensing slot samples the channels chosen as it started, even if setContinuous() is called part way through.
+  */
+static void latching()
+{
+    // Sampling one channel leaves the others at zero, which reads as full brightness.
+    MicroBitLightSensor single(microbitMatrixMap);
+
+    single.setSmoothing(0);
+    single.startSensing(MicroBitEvent(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, CREATE_ONLY));
+    single.setContinuous(true);
+    NRF_ADC->RESULT = READING;
+    host_advance(MICROBIT_LIGHT_SENSOR_AN_SET_TIME);
+
+    check(single.read() == 255, "a slot begun on one channel sampled every channel");
+
+    MicroBitLightSensor all(microbitMatrixMap);
+
+    all.setSmoothing(0);
+    all.setContinuous(true);
+    all.startSensing(MicroBitEvent(MICROBIT_ID_DISPLAY, MICROBIT_DISPLAY_EVT_LIGHT_SENSE, CREATE_ONLY));
+    all.setContinuous(false);
+    NRF_ADC->RESULT = READING;
+    host_advance(MICROBIT_LIGHT_SENSOR_AN_SET_TIME);
+
+    check(all.read() == LEVEL, "a slot begun on every channel sampled only one");
+}
+
+/**
+  * An EventModel that counts the light sensor's threshold events, in place of the message bus.
+  */
+class ThresholdEvents : public EventModel
+{
+    public:
+
+    int dark;
+    int bright;
+
+    ThresholdEvents() : dark(0), bright(0)
+    {
+        EventModel::defaultEventBus = this;
+    }
+
+    ~ThresholdEvents()
+    {
+        EventModel::defaultEventBus = NULL;
+    }
+
+    virtual int send(MicroBitEvent evt)
+    {
+        if (evt.source == MICROBIT_ID_LIGHT_SENSOR && evt.value == MICROBIT_LIGHT_SENSOR_EVT_DARK)
+            dark++;
+
+        if (evt.source == MICROBIT_ID_LIGHT_SENSOR && evt.value == MICROBIT_LIGHT_SENSOR_EVT_BRIGHT)
+            bright++;
+
+        return MICROBIT_OK;
+    }
+};
+
+/**
+  * A threshold event is raised once as the level reaches it. With one threshold set, it is raised again only
+  * after the level has moved back past it by more than the hysteresis. With both set, each waits for the other.
+  * A lower reading is a brighter level, by roughly one level per reading.
+  */
+static void thresholds()
+{
+    ThresholdEvents events;
+    MicroBitLightSensor sensor(microbitMatrixMap);
+
+    sensor.setContinuous(true);
+    sensor.setSmoothing(0);
+
+    sensor.setThresholds(LEVEL, -1);
+    sense(sensor);
+    sense(sensor);
+    check(events.dark == 1, "a dark threshold was not raised exactly once as it was reached");
+
+    // Just above the threshold, then back to it.
+    sense(sensor, READING - MICROBIT_LIGHT_SENSOR_HYSTERESIS / 2);
+    sense(sensor);
+    check(events.dark == 1, "a dark threshold was raised again by a level within the hysteresis");
+
+    // Well above the threshold, then back to it.
+    sense(sensor, READING - 3 * MICROBIT_LIGHT_SENSOR_HYSTERESIS);
+    check(sensor.read() > LEVEL + MICROBIT_LIGHT_SENSOR_HYSTERESIS, "the test reading is not beyond the hysteresis");
+    sense(sensor);
+    check(events.dark == 2, "a dark threshold alone was not raised again once the level crossed back over it");
+
+    sensor.setThresholds(-1, LEVEL);
+    sense(sensor);
+    sense(sensor, READING + MICROBIT_LIGHT_SENSOR_HYSTERESIS / 2);
+    sense(sensor);
+    check(events.bright == 1, "a bright threshold was not raised exactly once as it was reached");
+
+    sense(sensor, READING + 3 * MICROBIT_LIGHT_SENSOR_HYSTERESIS);
+    sense(sensor);
+    check(events.bright == 2, "a bright threshold alone was not raised again once the level crossed back over it");
+
+    // With both thresholds, a dark event waits for a bright one, however far the level rises in between.
+    sensor.setThresholds(LEVEL, LEVEL + 6 * MICROBIT_LIGHT_SENSOR_HYSTERESIS);
+    sense(sensor);
+    sense(sensor, READING - 3 * MICROBIT_LIGHT_SENSOR_HYSTERESIS);
+    sense(sensor);
+    check(events.dark == 3 && events.bright == 2, "a dark threshold was raised again without a bright one between");
+
+    sense(sensor, READING - 8 * MICROBIT_LIGHT_SENSOR_HYSTERESIS);
+    sense(sensor);
+    check(events.dark == 4 && events.bright == 3, "a pair of thresholds did not alternate");
+}
+
+struct Test
+{
+    const char  *name;
+    void        (*run)();
+};
+
+static const Test tests[] = {
+    { "initial", initial },
+    { "latching", latching },
+    { "thresholds", thresholds },
+};
+
+int main(int argc, char **argv)
+{
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(Test); i++)
+    {
+        bool selected = argc < 2;
+
+        for (int a = 1; a < argc; a++)
+            if (strcmp(argv[a], tests[i].name) == 0)
+                selected = true;
+
+        if (selected)
+        {
+            printf("--- %s\n", tests[i].name);
+            tests[i].run();
+        }
+    }
+
+    printf("ok\n");
+
+    return 0;
+}
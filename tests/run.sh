@@ -0,0 +1,140 @@
+#!/bin/sh
+#
+# Builds and runs the host tests, which exercise parts of the runtime on a Linux host
+# against the stand in headers in tests/host.
+#
+# Usage: tests/run.sh [test ...]
+#
+# With no arguments every test is run. The script exits with a non-zero status if any test fails.
+#
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=${BUILD:-$ROOT/tests/build}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-O2 -g"}
+
+FLAGS="-std=gnu++11 -Wall -Wextra -Wno-unused-function $CXXFLAGS -I$ROOT/tests/host -I$ROOT/inc/core -I$ROOT/inc/types -I$ROOT/inc/drivers -I$ROOT/inc/platform"
+
+# The allocator defines malloc and friends, which would otherwise replace the host C library's own.
+HEAP="-include $ROOT/tests/host/heap.h"
+
+# The scheduler keeps code and data addresses in 32 bit fields, which only compiles with -fpermissive on a 64 bit host.
+# The fiber test links below 4GB, where that is safe.
+SCHEDULER="-fpermissive -w"
+
+mkdir -p "$BUILD"
+
+# build <test> <sources...>
+# Any DEFINES set by the caller are passed to every source, e.g. to override MicroBitConfig.h,
+# and any LDFLAGS to the link.
+build()
+{
+    name=$1
+    shift
+
+    objects=""
+
+    for source in "$@"
+    do
+        extra=""
+
+        case $source in
+            *MicroBitHeapAllocator.cpp) extra=$HEAP ;;
+            *MicroBitFiber.cpp) extra=$SCHEDULER ;;
+        esac
+
+        object="$BUILD/$name-$(basename "$source" .cpp).o"
+        $CXX $FLAGS $DEFINES $extra -c "$ROOT/$source" -o "$object"
+        objects="$objects $object"
+    done
+
+    $CXX $FLAGS $LDFLAGS $objects -o "$BUILD/$name"
+}
+
+heap_fuzz()
+{
+    build heap_fuzz tests/heap_fuzz.cpp source/core/MicroBitHeapAllocator.cpp
+    "$BUILD/heap_fuzz"
+}
+
+heap_fragmentation()
+{
+    build heap_fragmentation tests/heap_fragmentation.cpp source/core/MicroBitHeapAllocator.cpp
+    "$BUILD/heap_fragmentation"
+
+    # Without a table of relocatable blocks, handles must still work, but never move.
+    DEFINES="-DMICROBIT_HEAP_MAX_HANDLES=0" build heap_fragmentation_no_handles tests/heap_fragmentation.cpp source/core/MicroBitHeapAllocator.cpp
+    "$BUILD/heap_fragmentation_no_handles"
+}
+
+# The parts of the runtime that the display depends on, and the stand ins for those that can't run on a host.
+DISPLAY="source/drivers/MicroBitDisplay.cpp source/drivers/MicroBitDisplayRecorder.cpp source/drivers/MicroBitAnimation.cpp
+    source/drivers/MicroBitTimeline.cpp source/drivers/MicroBitLightSensor.cpp source/types/MicroBitImage.cpp
+    source/types/MicroBitTextStrip.cpp source/types/MicroBitSprite.cpp source/types/ManagedString.cpp
+    source/types/RefCounted.cpp source/types/MicroBitEvent.cpp source/types/PacketBuffer.cpp source/core/MicroBitFont.cpp
+    source/core/MicroBitSystemTimer.cpp source/core/MicroBitArena.cpp source/core/MicroBitListener.cpp
+    source/core/MicroBitUtil.cpp source/core/MicroBitCompat.cpp tests/host/host.cpp"
+
+display()
+{
+    build display tests/display.cpp $DISPLAY
+    "$BUILD/display"
+}
+
+system_timer()
+{
+    build system_timer tests/system_timer.cpp source/core/MicroBitSystemTimer.cpp source/drivers/MicroBitButton.cpp \
+        source/types/MicroBitEvent.cpp tests/host/host.cpp
+    "$BUILD/system_timer"
+
+    # Buttons sampled less often than every tick must still be debounced over the same time.
+    DEFINES="-DMICROBIT_BUTTON_SAMPLE_PERIOD=12" build system_timer_sampled tests/system_timer.cpp \
+        source/core/MicroBitSystemTimer.cpp source/drivers/MicroBitButton.cpp source/types/MicroBitEvent.cpp tests/host/host.cpp
+    "$BUILD/system_timer_sampled" buttons
+}
+
+image()
+{
+    build image tests/image.cpp source/types/MicroBitImage.cpp source/types/RefCounted.cpp source/types/ManagedString.cpp \
+        source/types/PacketBuffer.cpp source/core/MicroBitArena.cpp source/core/MicroBitFont.cpp source/core/MicroBitCompat.cpp \
+        tests/host/host.cpp
+    "$BUILD/image"
+}
+
+fiber()
+{
+    DEFINES="-DHOST_SCHEDULER" LDFLAGS="-no-pie" build fiber tests/fiber.cpp source/core/MicroBitFiber.cpp \
+        source/core/MicroBitArena.cpp source/core/MicroBitSystemTimer.cpp source/core/MicroBitListener.cpp \
+        source/types/MicroBitEvent.cpp tests/host/context.cpp tests/host/host.cpp
+    "$BUILD/fiber"
+}
+
+font()
+{
+    build font tests/font.cpp source/core/MicroBitFont.cpp source/core/MicroBitCompat.cpp tests/host/host.cpp
+    "$BUILD/font"
+
+    # Without the glyph cache, every lookup decodes the font directly.
+    DEFINES="-DMICROBIT_FONT_GLYPH_CACHE_SIZE=0" build font_uncached tests/font.cpp source/core/MicroBitFont.cpp \
+        source/core/MicroBitCompat.cpp tests/host/host.cpp
+    "$BUILD/font_uncached" cache
+}
+
+light_sensor()
+{
+    build light_sensor tests/light_sensor.cpp source/drivers/MicroBitLightSensor.cpp source/types/MicroBitEvent.cpp \
+        source/core/MicroBitListener.cpp source/core/MicroBitSystemTimer.cpp tests/host/host.cpp
+    "$BUILD/light_sensor"
+}
+
+TESTS=${*:-"heap_fuzz heap_fragmentation display image font system_timer light_sensor fiber"}
+
+for t in $TESTS
+do
+    echo "=== $t"
+    $t
+done
+
+echo "=== all tests passed"
@@ -0,0 +1,539 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for the system timer, and the components it drives. The timer is driven by the simulated
+  * mbed Ticker in host/mbed.h, so each test controls exactly how much time passes.
+  *
+  * Usage: system_timer [test ...]
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitButton.h"
+#include "MicroBitEvent.h"
+#include "EventModel.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+#include <chrono>
+
+static void check(bool condition, const char *message)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", message);
+        exit(1);
+    }
+}
+
+/**
+  * A component that counts its callbacks, and can remove a component (possibly itself) from the system timer
+  * when it is next called.
+  */
+class Counter : public MicroBitComponent
+{
+    public:
+
+    int calls;
+    MicroBitComponent *victim;
+
+    Counter() : calls(0), victim(NULL) {}
+
+    virtual void systemTick()
+    {
+        calls++;
+
+        if (victim)
+        {
+            system_timer_remove_component(victim);
+            victim = NULL;
+        }
+    }
+};
+
+static void tick()
+{
+    host_advance(system_timer_get_period() * 1000);
+}
+
+/**
+  * Components removed from within a system tick must not cause any other component to miss that tick.
+  */
+static void removal()
+{
+    Counter a, b, c, d;
+
+    system_timer_add_component(&a);
+    system_timer_add_component(&b);
+    system_timer_add_component(&c);
+    system_timer_add_component(&d);
+
+    // b removes itself, then c removes a, which has already been called this tick.
+    b.victim = &b;
+    c.victim = &a;
+    tick();
+
+    check(a.calls == 1 && b.calls == 1 && c.calls == 1 && d.calls == 1, "a component missed the tick in which another was removed");
+
+    tick();
+
+    check(a.calls == 1 && b.calls == 1, "a removed component was still called");
+    check(c.calls == 2 && d.calls == 2, "a remaining component missed a tick after the removals");
+
+    // c removes d, which is yet to be called this tick.
+    c.victim = &d;
+    tick();
+
+    check(c.calls == 3 && d.calls == 2, "a component removed earlier in the tick was still called");
+    check(system_timer_remove_component(&d) == MICROBIT_INVALID_PARAMETER, "a removed component was still registered");
+    check(system_timer_remove_component(&c) == MICROBIT_OK, "a remaining component was no longer registered");
+}
+
+/**
+  * Components registered with a period are called once per period.
+  */
+static void periods()
+{
+    Counter fast, slow;
+
+    system_timer_add_component(&fast);
+    system_timer_add_component(&slow, 4 * system_timer_get_period());
+
+    for (int i = 0; i < 40; i++)
+        tick();
+
+    check(fast.calls == 40, "a component without a period was not called every tick");
+    check(slow.calls == 10, "a component with a period was not called once per period");
+
+    system_timer_remove_component(&fast);
+    system_timer_remove_component(&slow);
+}
+
+/**
+  * Measures how long the button takes to see its pin change to the given level.
+  */
+static int debounce(MicroBitButton &button, int level)
+{
+    host_pins[MICROBIT_PIN_BUTTON_A] = level;
+
+    for (int t = 0; t < 1000; t++)
+    {
+        host_advance(1000);
+
+        if (button.isPressed() == !level)
+            return t + 1;
+    }
+
+    return -1;
+}
+
+/**
+  * Buttons must be debounced over the same number of system ticks however often they are sampled, and whatever
+  * the tick period is at runtime. By default they are sampled every tick; run.sh also builds this test with
+  * MICROBIT_BUTTON_SAMPLE_PERIOD set, to sample them less often.
+  */
+static void buttons()
+{
+    static const int periods[] = { SYSTEM_TICK_PERIOD_MS, 1, 4 };
+
+    host_pins[MICROBIT_PIN_BUTTON_A] = 1;
+
+    MicroBitButton button(MICROBIT_PIN_BUTTON_A, MICROBIT_ID_BUTTON_A);
+    Counter sampled, reference;
+
+    // A component asking for the same period as the button is called as often as the button.
+    system_timer_add_component(&sampled, MICROBIT_BUTTON_SAMPLE_PERIOD);
+    system_timer_add_component(&reference);
+
+    for (unsigned i = 0; i < sizeof(periods) / sizeof(int); i++)
+    {
+        int tick = periods[i];
+
+        system_timer_set_period(tick);
+        host_advance(100000);
+        check(!button.isPressed(), "an idle button reads as pressed");
+
+        int samples = sampled.calls;
+        int ticks = reference.calls;
+        int press = debounce(button, 0);
+        int release = debounce(button, 1);
+
+        samples = sampled.calls - samples;
+        ticks = reference.calls - ticks;
+
+        // The longest time between samples, which is as much as sampling can add or remove.
+        int interval = max(MICROBIT_BUTTON_SAMPLE_PERIOD / tick, 1) * tick;
+
+        printf("%d ms ticks: press seen after %d ms, release after %d ms, in %d samples over %d ticks\n", tick, press, release, samples, ticks);
+
+        if (MICROBIT_BUTTON_SAMPLE_PERIOD == 0)
+            check(samples == ticks, "the button was not sampled on every tick by default");
+
+        // Sampled on every tick, a press is seen after 9 ticks, and a release straight after it in 8.
+        check(abs(press - 9 * tick) <= interval, "button press was not debounced over the usual number of ticks");
+        check(abs(release - 8 * tick) <= interval, "button release was not debounced over the usual number of ticks");
+    }
+
+    system_timer_set_period(SYSTEM_TICK_PERIOD_MS);
+    system_timer_remove_component(&sampled);
+    system_timer_remove_component(&reference);
+}
+
+/**
+  * Simulates a day of irregularly spaced reads of the clock, across many wraps of the 32 bit ticker.
+  * Every read must match the time that has really passed, to the microsecond.
+  */
+static void drift()
+{
+    const uint64_t day = 24ULL * 60 * 60 * 1000000;
+
+    update_time();
+
+    uint64_t start = system_timer_current_time_us();
+    uint64_t elapsed = 0;
+    uint64_t last = start;
+    uint32_t ticker = host_us_ticker;
+    uint32_t seed = 1;
+    int wraps = 0;
+    long reads = 0;
+
+    while (elapsed < day)
+    {
+        // Steps of up to 100ms, so that reads land at every point between system ticks.
+        seed = seed * 1103515245 + 12345;
+        uint32_t step = 1 + (seed >> 8) % 100000;
+
+        host_advance(step);
+        elapsed += step;
+
+        if (host_us_ticker < ticker)
+            wraps++;
+
+        ticker = host_us_ticker;
+
+        uint64_t now = system_timer_current_time_us();
+        reads++;
+
+        check(now >= last, "the clock went backwards");
+        check(now - start == elapsed, "the clock drifted from the time that has passed");
+
+        last = now;
+    }
+
+    check(wraps >= 20, "the simulated day did not wrap the ticker");
+    check(system_timer_current_time() == (start + elapsed) / 1000, "the millisecond clock disagrees with the microsecond clock");
+
+    // The read path is inline, and must stay cheap enough for the scheduler to use freely.
+    volatile uint64_t sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < 1000000; i++)
+        sink = system_timer_current_time_us();
+
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / 1000000;
+    (void) sink;
+
+    printf("%ld reads over 24 hours and %d ticker wraps, with no drift; %.1f ns per read\n", reads, wraps, ns);
+}
+
+/**
+  * The times at which a software timer fired, in milliseconds since the start of a test.
+  */
+struct Log
+{
+    uint64_t start;
+    int count;
+    uint32_t time[64];
+};
+
+static void record(void *arg)
+{
+    Log *log = (Log *)arg;
+
+    if (log->count < 64)
+        log->time[log->count] = (uint32_t)(system_timer_current_time() - log->start);
+
+    log->count++;
+}
+
+/**
+  * Starts a log, and runs the system timer every millisecond so that timers fire exactly on time.
+  */
+static void begin(Log &log)
+{
+    system_timer_set_period(1);
+    update_time();
+
+    log.start = system_timer_current_time();
+    log.count = 0;
+}
+
+/**
+  * An EventModel that keeps the last event raised, in place of the message bus.
+  */
+class EventLog : public EventModel
+{
+    public:
+
+    int count;
+    MicroBitEvent last;
+
+    EventLog() : count(0)
+    {
+        EventModel::defaultEventBus = this;
+    }
+
+    ~EventLog()
+    {
+        EventModel::defaultEventBus = NULL;
+    }
+
+    virtual int send(MicroBitEvent evt)
+    {
+        last = evt;
+        count++;
+        return MICROBIT_OK;
+    }
+};
+
+/**
+  * One shot timers fire once, when their period has elapsed, whether they call a function or raise an event.
+  */
+static void schedule()
+{
+    Log log;
+    EventLog events;
+
+    begin(log);
+
+    check(system_timer_callback_after(50, NULL, NULL) == MICROBIT_INVALID_PARAMETER, "a timer was scheduled without a function");
+    check(system_timer_callback_every(0, record, &log) == MICROBIT_INVALID_PARAMETER, "a repeating timer was scheduled without a period");
+    check(system_timer_event_every(0, 9000, 1) == MICROBIT_INVALID_PARAMETER, "a repeating event was scheduled without a period");
+
+    check(system_timer_callback_after(50, record, &log) == MICROBIT_OK, "system_timer_callback_after() failed");
+    check(system_timer_event_after(30, 9000, 1) == MICROBIT_OK, "system_timer_event_after() failed");
+
+    host_advance(29000);
+    check(log.count == 0 && events.count == 0, "a timer fired early");
+
+    host_advance(1000);
+    check(events.count == 1 && events.last.source == 9000 && events.last.value == 1, "an event timer did not raise its event on time");
+
+    host_advance(20000);
+    check(log.count == 1 && log.time[0] == 50, "a callback timer did not fire on time");
+
+    host_advance(100000);
+    check(log.count == 1 && events.count == 1, "a one shot timer fired again");
+
+    system_timer_set_period(SYSTEM_TICK_PERIOD_MS);
+}
+
+/**
+  * Cancelling removes exactly the timers matching the function and parameter, or the event.
+  */
+static void cancel()
+{
+    Log a, b;
+    EventLog events;
+
+    begin(a);
+    b.start = a.start;
+    b.count = 0;
+
+    system_timer_callback_after(10, record, &a);
+    system_timer_callback_every(10, record, &a);
+    system_timer_callback_after(10, record, &b);
+    system_timer_event_after(10, 9000, 1);
+    system_timer_event_after(10, 9000, 2);
+
+    check(system_timer_cancel_callback(record, &a) == MICROBIT_OK, "system_timer_cancel_callback() failed");
+    check(system_timer_cancel_callback(record, &a) == MICROBIT_INVALID_PARAMETER, "a cancelled timer could be cancelled again");
+    check(system_timer_cancel_event(9000, 1) == MICROBIT_OK, "system_timer_cancel_event() failed");
+    check(system_timer_cancel_event(9000, 3) == MICROBIT_INVALID_PARAMETER, "a timer that was never scheduled could be cancelled");
+
+    host_advance(100000);
+
+    check(a.count == 0, "a cancelled timer fired");
+    check(b.count == 1, "cancelling one parameter cancelled a timer with another");
+    check(events.count == 1 && events.last.value == 2, "cancelling one event cancelled another");
+
+    system_timer_set_period(SYSTEM_TICK_PERIOD_MS);
+}
+
+/**
+  * Repeating timers fire at whole multiples of their period without drifting. If the system falls behind,
+  * the periods missed are skipped, rather than caught up in a burst.
+  */
+static void repeat()
+{
+    Log log;
+
+    begin(log);
+
+    system_timer_callback_every(10, record, &log);
+    host_advance(100000);
+
+    check(log.count == 10, "a repeating timer did not fire once per period");
+
+    for (int i = 0; i < log.count; i++)
+        check(log.time[i] == (uint32_t)(i + 1) * 10, "a repeating timer drifted");
+
+    // Hold up the system timer for five and a half periods from just after the next call.
+    log.count = 0;
+    system_timer_callback_after(1, [](void *) { wait_us(55000); }, NULL);
+    host_advance(100000);
+
+    printf("after a 55 ms stall, a 10 ms timer fired at");
+
+    for (int i = 0; i < log.count; i++)
+        printf(" %u", log.time[i]);
+
+    printf(" ms\n");
+
+    for (int i = 1; i < log.count; i++)
+    {
+        check(log.time[i] % 10 == 0, "a repeating timer lost its phase after a stall");
+        check(log.time[i] > log.time[i - 1], "a repeating timer caught up in a burst after a stall");
+    }
+
+    check(log.count >= 4, "a repeating timer stopped after a stall");
+    check(system_timer_cancel_callback(record, &log) == MICROBIT_OK, "a repeating timer was not still scheduled");
+
+    system_timer_set_period(SYSTEM_TICK_PERIOD_MS);
+}
+
+static Log *ordered;
+static int ordering_ids[8];
+
+static void order(void *arg)
+{
+    ordering_ids[ordered->count++] = (int)(intptr_t)arg;
+}
+
+/**
+  * Timers fire in order of deadline, and those with equal deadlines in the order they were scheduled.
+  * A handler may cancel other timers, including those due in the same tick.
+  */
+static void ordering()
+{
+    Log log;
+    ordered = &log;
+
+    begin(log);
+
+    system_timer_callback_after(30, order, (void *)1);
+    system_timer_callback_after(10, order, (void *)2);
+    system_timer_callback_after(20, order, (void *)3);
+    system_timer_callback_after(20, [](void *) { system_timer_cancel_callback(order, (void *)5); }, NULL);
+    system_timer_callback_after(10, order, (void *)4);
+    system_timer_callback_after(20, order, (void *)5);
+
+    // Stall so that every timer is due in the same tick.
+    system_timer_callback_after(1, [](void *) { wait_us(40000); }, NULL);
+    host_advance(100000);
+
+    check(log.count == 4, "the wrong number of timers fired");
+    check(ordering_ids[0] == 2 && ordering_ids[1] == 4 && ordering_ids[2] == 3 && ordering_ids[3] == 1, "timers fired out of order");
+
+    system_timer_set_period(SYSTEM_TICK_PERIOD_MS);
+}
+
+/**
+  * Deadlines are held in milliseconds modulo 2^32, so timers must still fire correctly, and in order,
+  * as the millisecond clock wraps around after 49 days.
+  */
+static void wraparound()
+{
+    Log log, before;
+
+    begin(log);
+
+    // Move the clock on to 25 ms before the next wrap of its low 32 bits.
+    uint64_t now = system_timer_current_time();
+    uint64_t wrap = ((now >> 32) + 1) << 32;
+    system_timer_base_us += (wrap - 25 - now) * 1000;
+
+    log.start = system_timer_current_time();
+    before.start = log.start;
+    before.count = 0;
+
+    system_timer_callback_every(20, record, &log);
+    system_timer_callback_after(10, record, &before);
+
+    host_advance(19000);
+    check(before.count == 1 && before.time[0] == 10 && log.count == 0, "a timer due before the clock wraps fired at the wrong time");
+
+    host_advance(81000);
+    check(log.count == 5, "a repeating timer did not keep firing as the clock wrapped");
+
+    for (int i = 0; i < log.count; i++)
+        check(log.time[i] == (uint32_t)(i + 1) * 20, "a repeating timer fired at the wrong time as the clock wrapped");
+
+    check(system_timer_current_time() > wrap, "the clock did not wrap");
+
+    system_timer_cancel_callback(record, &log);
+    system_timer_set_period(SYSTEM_TICK_PERIOD_MS);
+}
+
+struct Test
+{
+    const char  *name;
+    void        (*run)();
+};
+
+static const Test tests[] = {
+    { "removal", removal },
+    { "periods", periods },
+    { "buttons", buttons },
+    { "drift", drift },
+    { "schedule", schedule },
+    { "cancel", cancel },
+    { "repeat", repeat },
+    { "ordering", ordering },
+    { "wraparound", wraparound },
+};
+
+int main(int argc, char **argv)
+{
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(Test); i++)
+    {
+        bool selected = argc < 2;
+
+        for (int a = 1; a < argc; a++)
+            if (strcmp(argv[a], tests[i].name) == 0)
+                selected = true;
+
+        if (selected)
+        {
+            printf("--- %s\n", tests[i].name);
+            tests[i].run();
+        }
+    }
+
+    printf("ok\n");
+
+    return 0;
+}